@@ -10,17 +10,58 @@
 #include <Magma\Utils\Globals.hpp>
 #include <Magma\Window\GLFWWindow.hpp>
 #include <Magma\Graphics\RenderDevice.hpp>
+#include <Magma\Graphics\NullRenderDevice.hpp>
+#include <Magma\Graphics\SpriteBatch.hpp>
 #include <Magma\Systems\Scene\Scene.hpp>
 
 #include <Magma\Systems\Resources\TextResource.hpp>
 
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
 
 #include <filesystem>
 
 
 using namespace Magma;
 
+// Measures the CPU cost of batching sprites, drawn on a null device so that only the batcher is timed
+void SpriteBenchmark(int quadCount, int textureCount, int frameCount)
+{
+	NullRenderDevice device;
+	VertexShader* vertexShader = device.CreateVertexShader("sprite");
+	PixelShader* pixelShader = device.CreatePixelShader("sprite");
+	Pipeline* pipeline = device.CreatePipeline(vertexShader, pixelShader);
+
+	std::vector<Texture2D*> textures(textureCount);
+	for (auto& texture : textures)
+		texture = device.CreateTexture2D(16, 16);
+
+	SpriteBatch batch(&device, pipeline);
+	// Let the pipeline become ready, draws are skipped until then
+	device.EndFrame();
+	const auto start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frameCount; ++frame)
+	{
+		batch.Begin();
+		for (int i = 0; i < quadCount; ++i)
+			batch.Draw(textures[(i * 7) % textureCount], static_cast<float>(i % 640), static_cast<float>(i % 480), 16.0f, 16.0f);
+		batch.End();
+		device.EndFrame();
+	}
+	const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::cout << "Sprite batch: " << quadCount << " quads, " << textureCount << " textures, " << frameCount << " frames" << std::endl;
+	std::cout << "  " << static_cast<double>(quadCount) * frameCount / milliseconds << " quads/ms, "
+			  << batch.GetDrawCount() << " draws per frame, " << device.GetStats().triangles / frameCount << " triangles per frame" << std::endl;
+
+	for (auto texture : textures)
+		device.DestroyTexture2D(texture);
+	device.DestroyPipeline(pipeline);
+	device.DestroyPixelShader(pixelShader);
+	device.DestroyVertexShader(vertexShader);
+}
+
 void MagmaInit(const Locator& loc)
 {
 	Terminal::AddCommand("exit", [&loc](const std::vector<std::string>& arguments) { loc.core->Terminate(); });
@@ -36,6 +77,18 @@ void MagmaInit(const Locator& loc)
 		}
 		else MAGMA_WARNING("Failed to execute command \"send\", invalid number of arguments, 1/2 expected (message type, data type {default empty})");
 	});
+	Terminal::AddCommand("spritebench", [](const std::vector<std::string>& arguments)
+	{
+		if (arguments.size() > 3)
+		{
+			MAGMA_WARNING("Failed to execute command \"spritebench\", invalid number of arguments, 0-3 expected (quads {default 100000}, textures {default 8}, frames {default 100})");
+			return;
+		}
+		const int quads = arguments.size() > 0 ? std::max(std::atoi(arguments[0].c_str()), 1) : 100000;
+		const int textures = arguments.size() > 1 ? std::max(std::atoi(arguments[1].c_str()), 1) : 8;
+		const int frames = arguments.size() > 2 ? std::max(std::atoi(arguments[2].c_str()), 1) : 100;
+		SpriteBenchmark(quads, textures, frames);
+	});
 
 	{
 		std::ifstream ifs("keybinds.xml");
@@ -57,6 +110,7 @@ void MagmaInit(const Locator& loc)
 
 void MagmaTerminate(const Locator& loc)
 {
+	Terminal::RemoveCommand("spritebench");
 	Terminal::RemoveCommand("send");
 	Terminal::RemoveCommand("exit");
 }
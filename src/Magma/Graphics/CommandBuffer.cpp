@@ -0,0 +1,437 @@
+#include "CommandBuffer.hpp"
+#include "..\Utils\Utils.hpp"
+
+#include <cstring>
+
+enum class Magma::CommandBuffer::Command : unsigned int
+{
+	SetPipeline = 0,
+	SetParamInt,
+	SetParamFloat,
+	SetParamMat4,
+	SetParamIntArray,
+	SetParamFloatArray,
+	SetParamMat4Array,
+	SetVertexArray,
+	SetIndexBuffer,
+	SetTexture2D,
+	SetSampler,
+	SetRasterState,
+	SetDepthStencilState,
+	SetBlendState,
+	SetPipelineState,
+	SetRenderTarget,
+	ResolveRenderTarget,
+	SetViewport,
+	Clear,
+	DrawTriangles,
+	DrawTrianglesIndexed32,
+	DrawTrianglesIndexed,
+	DrawTrianglesInstanced,
+	DrawTrianglesIndexedInstanced,
+	DrawTrianglesIndirect,
+	DrawTrianglesIndexedIndirect,
+	BeginScope,
+	EndScope,
+};
+
+namespace
+{
+	// Every command starts with this header; size includes the header and is always a multiple of CommandAlignment
+	struct CommandHeader
+	{
+		unsigned int command;
+		unsigned int size;
+	};
+
+	const size_t CommandAlignment = 8;
+
+	// Command payloads, all POD
+	struct PointerPayload { void* object; };
+	struct ParamIntPayload { Magma::PipelineParam* param; int value; };
+	struct ParamFloatPayload { Magma::PipelineParam* param; float value; };
+	// Followed by count values
+	struct ParamArrayPayload { Magma::PipelineParam* param; int count; };
+	struct SetTexture2DPayload { Magma::Texture2D* texture2D; unsigned int slot; };
+	struct SetSamplerPayload { Magma::Sampler* sampler; unsigned int slot; };
+	struct ViewportPayload { int x, y, width, height; };
+	struct ClearPayload { float red, green, blue, alpha, depth; int stencil; };
+	struct DrawTrianglesPayload { int offset; int count; };
+	struct DrawTrianglesIndexedPayload { long long offset; int count; };
+	struct DrawTrianglesInstancedPayload { int offset; int count; int instanceCount; };
+	struct DrawTrianglesIndexedInstancedPayload { long long offset; int count; int instanceCount; };
+	struct DrawIndirectPayload { Magma::IndirectBuffer* indirectBuffer; long long offset; int drawCount; };
+}
+
+Magma::CommandBuffer::CommandBuffer(size_t reserve)
+{
+	m_data.reserve(reserve);
+}
+
+void Magma::CommandBuffer::Reset()
+{
+	m_data.clear();
+	m_commandCount = 0;
+}
+
+void * Magma::CommandBuffer::Push(Command command, size_t payloadSize)
+{
+	size_t size = sizeof(CommandHeader) + payloadSize;
+	size = (size + CommandAlignment - 1) & ~(CommandAlignment - 1);
+
+	size_t offset = m_data.size();
+	m_data.resize(offset + size);
+
+	CommandHeader* header = reinterpret_cast<CommandHeader*>(&m_data[offset]);
+	header->command = static_cast<unsigned int>(command);
+	header->size = static_cast<unsigned int>(size);
+	++m_commandCount;
+
+	return header + 1;
+}
+
+void Magma::CommandBuffer::Execute(RenderDevice * device) const
+{
+	const unsigned char* it = m_data.data();
+	const unsigned char* end = it + m_data.size();
+
+	while (it < end)
+	{
+		const CommandHeader* header = reinterpret_cast<const CommandHeader*>(it);
+		const void* payload = header + 1;
+
+		switch (static_cast<Command>(header->command))
+		{
+			case Command::SetPipeline:
+				device->SetPipeline(static_cast<Pipeline*>(static_cast<const PointerPayload*>(payload)->object));
+				break;
+			case Command::SetParamInt:
+			{
+				auto p = static_cast<const ParamIntPayload*>(payload);
+				p->param->SetAsInt(p->value);
+				break;
+			}
+			case Command::SetParamFloat:
+			{
+				auto p = static_cast<const ParamFloatPayload*>(payload);
+				p->param->SetAsFloat(p->value);
+				break;
+			}
+			case Command::SetParamMat4:
+			{
+				auto p = static_cast<const ParamArrayPayload*>(payload);
+				p->param->SetAsMat4(reinterpret_cast<const float*>(p + 1));
+				break;
+			}
+			case Command::SetParamIntArray:
+			{
+				auto p = static_cast<const ParamArrayPayload*>(payload);
+				p->param->SetAsIntArray(p->count, reinterpret_cast<const int*>(p + 1));
+				break;
+			}
+			case Command::SetParamFloatArray:
+			{
+				auto p = static_cast<const ParamArrayPayload*>(payload);
+				p->param->SetAsFloatArray(p->count, reinterpret_cast<const float*>(p + 1));
+				break;
+			}
+			case Command::SetParamMat4Array:
+			{
+				auto p = static_cast<const ParamArrayPayload*>(payload);
+				p->param->SetAsMat4Array(p->count, reinterpret_cast<const float*>(p + 1));
+				break;
+			}
+			case Command::SetVertexArray:
+				device->SetVertexArray(static_cast<VertexArray*>(static_cast<const PointerPayload*>(payload)->object));
+				break;
+			case Command::SetIndexBuffer:
+				device->SetIndexBuffer(static_cast<IndexBuffer*>(static_cast<const PointerPayload*>(payload)->object));
+				break;
+			case Command::SetTexture2D:
+			{
+				auto p = static_cast<const SetTexture2DPayload*>(payload);
+				device->SetTexture2D(p->slot, p->texture2D);
+				break;
+			}
+			case Command::SetSampler:
+			{
+				auto p = static_cast<const SetSamplerPayload*>(payload);
+				device->SetSampler(p->slot, p->sampler);
+				break;
+			}
+			case Command::SetRasterState:
+				device->SetRasterState(static_cast<RasterState*>(static_cast<const PointerPayload*>(payload)->object));
+				break;
+			case Command::SetDepthStencilState:
+				device->SetDepthStencilState(static_cast<DepthStencilState*>(static_cast<const PointerPayload*>(payload)->object));
+				break;
+			case Command::SetBlendState:
+				device->SetBlendState(static_cast<BlendState*>(static_cast<const PointerPayload*>(payload)->object));
+				break;
+			case Command::SetPipelineState:
+				device->SetPipelineState(static_cast<PipelineState*>(static_cast<const PointerPayload*>(payload)->object));
+				break;
+			case Command::SetRenderTarget:
+				device->SetRenderTarget(static_cast<RenderTarget*>(static_cast<const PointerPayload*>(payload)->object));
+				break;
+			case Command::ResolveRenderTarget:
+				device->ResolveRenderTarget(static_cast<RenderTarget*>(static_cast<const PointerPayload*>(payload)->object));
+				break;
+			case Command::SetViewport:
+			{
+				auto p = static_cast<const ViewportPayload*>(payload);
+				device->SetViewport(p->x, p->y, p->width, p->height);
+				break;
+			}
+			case Command::Clear:
+			{
+				auto p = static_cast<const ClearPayload*>(payload);
+				device->Clear(p->red, p->green, p->blue, p->alpha, p->depth, p->stencil);
+				break;
+			}
+			case Command::DrawTriangles:
+			{
+				auto p = static_cast<const DrawTrianglesPayload*>(payload);
+				device->DrawTriangles(p->offset, p->count);
+				break;
+			}
+			case Command::DrawTrianglesIndexed32:
+			{
+				auto p = static_cast<const DrawTrianglesIndexedPayload*>(payload);
+				device->DrawTrianglesIndexed32(p->offset, p->count);
+				break;
+			}
+			case Command::DrawTrianglesIndexed:
+			{
+				auto p = static_cast<const DrawTrianglesIndexedPayload*>(payload);
+				device->DrawTrianglesIndexed(p->offset, p->count);
+				break;
+			}
+			case Command::DrawTrianglesInstanced:
+			{
+				auto p = static_cast<const DrawTrianglesInstancedPayload*>(payload);
+				device->DrawTrianglesInstanced(p->offset, p->count, p->instanceCount);
+				break;
+			}
+			case Command::DrawTrianglesIndexedInstanced:
+			{
+				auto p = static_cast<const DrawTrianglesIndexedInstancedPayload*>(payload);
+				device->DrawTrianglesIndexedInstanced(p->offset, p->count, p->instanceCount);
+				break;
+			}
+			case Command::DrawTrianglesIndirect:
+			{
+				auto p = static_cast<const DrawIndirectPayload*>(payload);
+				device->DrawTrianglesIndirect(p->indirectBuffer, p->offset, p->drawCount);
+				break;
+			}
+			case Command::DrawTrianglesIndexedIndirect:
+			{
+				auto p = static_cast<const DrawIndirectPayload*>(payload);
+				device->DrawTrianglesIndexedIndirect(p->indirectBuffer, p->offset, p->drawCount);
+				break;
+			}
+			case Command::BeginScope:
+				// The payload is the null terminated scope name
+				device->BeginScope(static_cast<const char*>(payload));
+				break;
+			case Command::EndScope:
+				device->EndScope();
+				break;
+			default:
+				MAGMA_ERROR("Failed to execute command buffer, unknown command found in the command stream");
+				return;
+		}
+
+		it += header->size;
+	}
+}
+
+void Magma::CommandBuffer::SetPipeline(Pipeline * pipeline)
+{
+	static_cast<PointerPayload*>(this->Push(Command::SetPipeline, sizeof(PointerPayload)))->object = pipeline;
+}
+
+void Magma::CommandBuffer::SetParamInt(PipelineParam * param, int value)
+{
+	auto p = static_cast<ParamIntPayload*>(this->Push(Command::SetParamInt, sizeof(ParamIntPayload)));
+	p->param = param;
+	p->value = value;
+}
+
+void Magma::CommandBuffer::SetParamFloat(PipelineParam * param, float value)
+{
+	auto p = static_cast<ParamFloatPayload*>(this->Push(Command::SetParamFloat, sizeof(ParamFloatPayload)));
+	p->param = param;
+	p->value = value;
+}
+
+void Magma::CommandBuffer::SetParamMat4(PipelineParam * param, const float * value)
+{
+	auto p = static_cast<ParamArrayPayload*>(this->Push(Command::SetParamMat4, sizeof(ParamArrayPayload) + 16 * sizeof(float)));
+	p->param = param;
+	p->count = 1;
+	std::memcpy(p + 1, value, 16 * sizeof(float));
+}
+
+void Magma::CommandBuffer::SetParamIntArray(PipelineParam * param, int count, const int * values)
+{
+	auto p = static_cast<ParamArrayPayload*>(this->Push(Command::SetParamIntArray, sizeof(ParamArrayPayload) + count * sizeof(int)));
+	p->param = param;
+	p->count = count;
+	std::memcpy(p + 1, values, count * sizeof(int));
+}
+
+void Magma::CommandBuffer::SetParamFloatArray(PipelineParam * param, int count, const float * values)
+{
+	auto p = static_cast<ParamArrayPayload*>(this->Push(Command::SetParamFloatArray, sizeof(ParamArrayPayload) + count * sizeof(float)));
+	p->param = param;
+	p->count = count;
+	std::memcpy(p + 1, values, count * sizeof(float));
+}
+
+void Magma::CommandBuffer::SetParamMat4Array(PipelineParam * param, int count, const float * values)
+{
+	auto p = static_cast<ParamArrayPayload*>(this->Push(Command::SetParamMat4Array, sizeof(ParamArrayPayload) + count * 16 * sizeof(float)));
+	p->param = param;
+	p->count = count;
+	std::memcpy(p + 1, values, count * 16 * sizeof(float));
+}
+
+void Magma::CommandBuffer::SetVertexArray(VertexArray * vertexArray)
+{
+	static_cast<PointerPayload*>(this->Push(Command::SetVertexArray, sizeof(PointerPayload)))->object = vertexArray;
+}
+
+void Magma::CommandBuffer::SetIndexBuffer(IndexBuffer * indexBuffer)
+{
+	static_cast<PointerPayload*>(this->Push(Command::SetIndexBuffer, sizeof(PointerPayload)))->object = indexBuffer;
+}
+
+void Magma::CommandBuffer::SetTexture2D(unsigned int slot, Texture2D * texture2D)
+{
+	auto p = static_cast<SetTexture2DPayload*>(this->Push(Command::SetTexture2D, sizeof(SetTexture2DPayload)));
+	p->texture2D = texture2D;
+	p->slot = slot;
+}
+
+void Magma::CommandBuffer::SetSampler(unsigned int slot, Sampler * sampler)
+{
+	auto p = static_cast<SetSamplerPayload*>(this->Push(Command::SetSampler, sizeof(SetSamplerPayload)));
+	p->sampler = sampler;
+	p->slot = slot;
+}
+
+void Magma::CommandBuffer::SetRasterState(RasterState * rasterState)
+{
+	static_cast<PointerPayload*>(this->Push(Command::SetRasterState, sizeof(PointerPayload)))->object = rasterState;
+}
+
+void Magma::CommandBuffer::SetDepthStencilState(DepthStencilState * depthStencilState)
+{
+	static_cast<PointerPayload*>(this->Push(Command::SetDepthStencilState, sizeof(PointerPayload)))->object = depthStencilState;
+}
+
+void Magma::CommandBuffer::SetBlendState(BlendState * blendState)
+{
+	static_cast<PointerPayload*>(this->Push(Command::SetBlendState, sizeof(PointerPayload)))->object = blendState;
+}
+
+void Magma::CommandBuffer::SetPipelineState(PipelineState * pipelineState)
+{
+	static_cast<PointerPayload*>(this->Push(Command::SetPipelineState, sizeof(PointerPayload)))->object = pipelineState;
+}
+
+void Magma::CommandBuffer::SetRenderTarget(RenderTarget * renderTarget)
+{
+	static_cast<PointerPayload*>(this->Push(Command::SetRenderTarget, sizeof(PointerPayload)))->object = renderTarget;
+}
+
+void Magma::CommandBuffer::ResolveRenderTarget(RenderTarget * renderTarget)
+{
+	static_cast<PointerPayload*>(this->Push(Command::ResolveRenderTarget, sizeof(PointerPayload)))->object = renderTarget;
+}
+
+void Magma::CommandBuffer::SetViewport(int x, int y, int width, int height)
+{
+	auto p = static_cast<ViewportPayload*>(this->Push(Command::SetViewport, sizeof(ViewportPayload)));
+	p->x = x;
+	p->y = y;
+	p->width = width;
+	p->height = height;
+}
+
+void Magma::CommandBuffer::Clear(float red, float green, float blue, float alpha, float depth, int stencil)
+{
+	auto p = static_cast<ClearPayload*>(this->Push(Command::Clear, sizeof(ClearPayload)));
+	p->red = red;
+	p->green = green;
+	p->blue = blue;
+	p->alpha = alpha;
+	p->depth = depth;
+	p->stencil = stencil;
+}
+
+void Magma::CommandBuffer::DrawTriangles(int offset, int count)
+{
+	auto p = static_cast<DrawTrianglesPayload*>(this->Push(Command::DrawTriangles, sizeof(DrawTrianglesPayload)));
+	p->offset = offset;
+	p->count = count;
+}
+
+void Magma::CommandBuffer::DrawTrianglesIndexed32(long long offset, int count)
+{
+	auto p = static_cast<DrawTrianglesIndexedPayload*>(this->Push(Command::DrawTrianglesIndexed32, sizeof(DrawTrianglesIndexedPayload)));
+	p->offset = offset;
+	p->count = count;
+}
+
+void Magma::CommandBuffer::DrawTrianglesIndexed(long long offset, int count)
+{
+	auto p = static_cast<DrawTrianglesIndexedPayload*>(this->Push(Command::DrawTrianglesIndexed, sizeof(DrawTrianglesIndexedPayload)));
+	p->offset = offset;
+	p->count = count;
+}
+
+void Magma::CommandBuffer::DrawTrianglesInstanced(int offset, int count, int instanceCount)
+{
+	auto p = static_cast<DrawTrianglesInstancedPayload*>(this->Push(Command::DrawTrianglesInstanced, sizeof(DrawTrianglesInstancedPayload)));
+	p->offset = offset;
+	p->count = count;
+	p->instanceCount = instanceCount;
+}
+
+void Magma::CommandBuffer::DrawTrianglesIndexedInstanced(long long offset, int count, int instanceCount)
+{
+	auto p = static_cast<DrawTrianglesIndexedInstancedPayload*>(this->Push(Command::DrawTrianglesIndexedInstanced, sizeof(DrawTrianglesIndexedInstancedPayload)));
+	p->offset = offset;
+	p->count = count;
+	p->instanceCount = instanceCount;
+}
+
+void Magma::CommandBuffer::DrawTrianglesIndirect(IndirectBuffer * indirectBuffer, long long offset, int drawCount)
+{
+	auto p = static_cast<DrawIndirectPayload*>(this->Push(Command::DrawTrianglesIndirect, sizeof(DrawIndirectPayload)));
+	p->indirectBuffer = indirectBuffer;
+	p->offset = offset;
+	p->drawCount = drawCount;
+}
+
+void Magma::CommandBuffer::DrawTrianglesIndexedIndirect(IndirectBuffer * indirectBuffer, long long offset, int drawCount)
+{
+	auto p = static_cast<DrawIndirectPayload*>(this->Push(Command::DrawTrianglesIndexedIndirect, sizeof(DrawIndirectPayload)));
+	p->indirectBuffer = indirectBuffer;
+	p->offset = offset;
+	p->drawCount = drawCount;
+}
+
+void Magma::CommandBuffer::BeginScope(const char * name)
+{
+	const size_t length = strlen(name);
+	memcpy(this->Push(Command::BeginScope, length + 1), name, length + 1);
+}
+
+void Magma::CommandBuffer::EndScope()
+{
+	this->Push(Command::EndScope, 0);
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "RenderDevice.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace Magma
+{
+	/// <summary>
+	///		Records render device commands into a compact byte stream, to be replayed later with RenderDevice::Submit.
+	///		Any thread may record into a command buffer, but only one thread at a time.
+	///		Resources referenced by recorded commands must stay alive until the buffer is submitted.
+	/// </summary>
+	class CommandBuffer final
+	{
+	public:
+		/// <summary>
+		///		Creates an empty command buffer
+		/// </summary>
+		/// <param name="reserve">Number of bytes to reserve for the command stream</param>
+		CommandBuffer(size_t reserve = 4096);
+
+		/// <summary>
+		///		Removes every recorded command, keeping the allocated memory
+		/// </summary>
+		void Reset();
+
+		/// <summary>
+		///		Gets the size of the recorded command stream
+		/// </summary>
+		/// <returns>Size in bytes</returns>
+		inline size_t GetSize() const { return m_data.size(); }
+
+		/// <summary>
+		///		Gets the number of recorded commands
+		/// </summary>
+		/// <returns>Number of commands</returns>
+		inline size_t GetCommandCount() const { return m_commandCount; }
+
+		/// <summary>
+		///		Checks if there are no commands recorded
+		/// </summary>
+		/// <returns>True if empty, otherwise false</returns>
+		inline bool IsEmpty() const { return m_commandCount == 0; }
+
+		/// <summary>
+		///		Replays every recorded command on a render device. Must be called from the device thread.
+		/// </summary>
+		/// <param name="device">Render device</param>
+		void Execute(RenderDevice* device) const;
+
+		/// <summary>
+		///		Records RenderDevice::SetPipeline
+		/// </summary>
+		void SetPipeline(Pipeline* pipeline);
+
+		/// <summary>
+		///		Records PipelineParam::SetAsInt
+		/// </summary>
+		void SetParamInt(PipelineParam* param, int value);
+
+		/// <summary>
+		///		Records PipelineParam::SetAsFloat
+		/// </summary>
+		void SetParamFloat(PipelineParam* param, float value);
+
+		/// <summary>
+		///		Records PipelineParam::SetAsMat4 (the matrix is copied into the command stream)
+		/// </summary>
+		void SetParamMat4(PipelineParam* param, const float* value);
+
+		/// <summary>
+		///		Records PipelineParam::SetAsIntArray (the values are copied into the command stream)
+		/// </summary>
+		void SetParamIntArray(PipelineParam* param, int count, const int* values);
+
+		/// <summary>
+		///		Records PipelineParam::SetAsFloatArray (the values are copied into the command stream)
+		/// </summary>
+		void SetParamFloatArray(PipelineParam* param, int count, const float* values);
+
+		/// <summary>
+		///		Records PipelineParam::SetAsMat4Array (the values are copied into the command stream)
+		/// </summary>
+		void SetParamMat4Array(PipelineParam* param, int count, const float* values);
+
+		/// <summary>
+		///		Records RenderDevice::SetVertexArray
+		/// </summary>
+		void SetVertexArray(VertexArray* vertexArray);
+
+		/// <summary>
+		///		Records RenderDevice::SetIndexBuffer
+		/// </summary>
+		void SetIndexBuffer(IndexBuffer* indexBuffer);
+
+		/// <summary>
+		///		Records RenderDevice::SetTexture2D
+		/// </summary>
+		void SetTexture2D(unsigned int slot, Texture2D* texture2D);
+
+		/// <summary>
+		///		Records RenderDevice::SetSampler
+		/// </summary>
+		void SetSampler(unsigned int slot, Sampler* sampler);
+
+		/// <summary>
+		///		Records RenderDevice::SetRasterState
+		/// </summary>
+		void SetRasterState(RasterState* rasterState);
+
+		/// <summary>
+		///		Records RenderDevice::SetDepthStencilState
+		/// </summary>
+		void SetDepthStencilState(DepthStencilState* depthStencilState);
+
+		/// <summary>
+		///		Records RenderDevice::SetBlendState
+		/// </summary>
+		void SetBlendState(BlendState* blendState);
+
+		/// <summary>
+		///		Records RenderDevice::SetPipelineState
+		/// </summary>
+		void SetPipelineState(PipelineState* pipelineState);
+
+		/// <summary>
+		///		Records RenderDevice::SetRenderTarget
+		/// </summary>
+		void SetRenderTarget(RenderTarget* renderTarget);
+
+		/// <summary>
+		///		Records RenderDevice::ResolveRenderTarget
+		/// </summary>
+		void ResolveRenderTarget(RenderTarget* renderTarget);
+
+		/// <summary>
+		///		Records RenderDevice::SetViewport
+		/// </summary>
+		void SetViewport(int x, int y, int width, int height);
+
+		/// <summary>
+		///		Records RenderDevice::Clear
+		/// </summary>
+		void Clear(float red = 0.0f, float green = 0.0f, float blue = 0.0f, float alpha = 1.0f, float depth = 1.0f, int stencil = 0);
+
+		/// <summary>
+		///		Records RenderDevice::DrawTriangles
+		/// </summary>
+		void DrawTriangles(int offset, int count);
+
+		/// <summary>
+		///		Records RenderDevice::DrawTrianglesIndexed32
+		/// </summary>
+		void DrawTrianglesIndexed32(long long offset, int count);
+
+		/// <summary>
+		///		Records RenderDevice::DrawTrianglesIndexed
+		/// </summary>
+		void DrawTrianglesIndexed(long long offset, int count);
+
+		/// <summary>
+		///		Records RenderDevice::DrawTrianglesInstanced
+		/// </summary>
+		void DrawTrianglesInstanced(int offset, int count, int instanceCount);
+
+		/// <summary>
+		///		Records RenderDevice::DrawTrianglesIndexedInstanced
+		/// </summary>
+		void DrawTrianglesIndexedInstanced(long long offset, int count, int instanceCount);
+
+		/// <summary>
+		///		Records RenderDevice::DrawTrianglesIndirect (the draw arguments are read from the buffer when the command is executed)
+		/// </summary>
+		void DrawTrianglesIndirect(IndirectBuffer* indirectBuffer, long long offset, int drawCount);
+
+		/// <summary>
+		///		Records RenderDevice::DrawTrianglesIndexedIndirect (the draw arguments are read from the buffer when the command is executed)
+		/// </summary>
+		void DrawTrianglesIndexedIndirect(IndirectBuffer* indirectBuffer, long long offset, int drawCount);
+
+		/// <summary>
+		///		Records RenderDevice::BeginScope (the name is copied)
+		/// </summary>
+		void BeginScope(const char* name);
+
+		/// <summary>
+		///		Records RenderDevice::EndScope
+		/// </summary>
+		void EndScope();
+
+	private:
+		enum class Command : unsigned int;
+
+		// Appends a command with a payload of a certain size and returns a pointer to the payload
+		void* Push(Command command, size_t payloadSize);
+
+		std::vector<unsigned char> m_data;
+		size_t m_commandCount = 0;
+	};
+}
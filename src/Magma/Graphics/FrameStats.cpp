@@ -0,0 +1,125 @@
+#include "FrameStats.hpp"
+#include "..\Utils\Utils.hpp"
+
+#include <iomanip>
+
+namespace
+{
+	double ElapsedMilliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+}
+
+Magma::FrameProfiler::FrameProfiler(unsigned int historySize)
+	: m_historySize(historySize > 0 ? historySize : 1)
+{
+	m_frameStart = std::chrono::steady_clock::now();
+}
+
+unsigned int Magma::FrameProfiler::BeginScope(const char * name)
+{
+	FrameScopeStats scope;
+	scope.name = name != nullptr ? name : "";
+	scope.depth = static_cast<unsigned int>(m_openScopes.size());
+	m_current.scopes.push_back(scope);
+
+	const unsigned int index = static_cast<unsigned int>(m_current.scopes.size() - 1);
+	m_openScopes.push_back(index);
+	m_scopeStarts.push_back(std::chrono::steady_clock::now());
+	return index;
+}
+
+unsigned int Magma::FrameProfiler::EndScope()
+{
+	if (m_openScopes.empty())
+	{
+		MAGMA_WARNING("Failed to end scope, no scope is open");
+		return InvalidScope;
+	}
+
+	const unsigned int index = m_openScopes.back();
+	m_current.scopes[index].cpuTime = ElapsedMilliseconds(m_scopeStarts.back(), std::chrono::steady_clock::now());
+	m_openScopes.pop_back();
+	m_scopeStarts.pop_back();
+	return index;
+}
+
+unsigned long long Magma::FrameProfiler::EndFrame()
+{
+	if (!m_openScopes.empty())
+	{
+		MAGMA_WARNING("Frame ended with " + std::to_string(m_openScopes.size()) + " scopes still open, ending them");
+		while (!m_openScopes.empty())
+			this->EndScope();
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+	m_current.cpuTime = ElapsedMilliseconds(m_frameStart, now);
+	m_frameStart = now;
+
+	const unsigned long long frame = m_current.frame;
+	if (m_history.size() < m_historySize)
+		m_history.push_back(std::move(m_current));
+	else
+		m_history[m_next] = std::move(m_current);
+	m_next = (m_next + 1) % m_historySize;
+
+	m_current = FrameStats();
+	m_current.frame = frame + 1;
+	return frame;
+}
+
+void Magma::FrameProfiler::SetGPUTime(unsigned long long frame, unsigned int scope, double milliseconds)
+{
+	FrameStats* stats = this->FindFrame(frame);
+	if (stats == nullptr)
+		return;
+
+	if (scope == InvalidScope)
+		stats->gpuTime = milliseconds;
+	else if (scope < stats->scopes.size())
+		stats->scopes[scope].gpuTime = milliseconds;
+}
+
+const Magma::FrameStats * Magma::FrameProfiler::GetFrame(unsigned int age) const
+{
+	if (age >= m_history.size())
+		return nullptr;
+	return &m_history[(m_next + m_historySize - 1 - age) % m_historySize];
+}
+
+void Magma::FrameProfiler::WriteLog(std::ostream & os, unsigned int frames) const
+{
+	const unsigned int count = frames < this->GetFrameCount() ? frames : this->GetFrameCount();
+	os << std::fixed << std::setprecision(3);
+	for (unsigned int age = count; age-- > 0;)
+	{
+		const FrameStats* stats = this->GetFrame(age);
+		os << "frame " << stats->frame << ": cpu " << stats->cpuTime << " ms, gpu ";
+		if (stats->gpuTime < 0.0)
+			os << "-";
+		else
+			os << stats->gpuTime << " ms";
+		os << ", " << stats->drawCalls << " draws, " << stats->triangles << " triangles, "
+		   << stats->stateChanges << " state changes, " << stats->bytesUploaded << " bytes uploaded" << std::endl;
+
+		for (auto& scope : stats->scopes)
+		{
+			os << std::string(2 * (scope.depth + 1), ' ') << scope.name << ": cpu " << scope.cpuTime << " ms, gpu ";
+			if (scope.gpuTime < 0.0)
+				os << "-";
+			else
+				os << scope.gpuTime << " ms";
+			os << std::endl;
+		}
+	}
+}
+
+Magma::FrameStats * Magma::FrameProfiler::FindFrame(unsigned long long frame)
+{
+	const unsigned long long last = m_current.frame;
+	if (frame >= last || last - frame > m_history.size())
+		return nullptr;
+	return const_cast<FrameStats*>(this->GetFrame(static_cast<unsigned int>(last - 1 - frame)));
+}
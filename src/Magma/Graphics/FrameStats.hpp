@@ -0,0 +1,131 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Magma
+{
+	/// <summary>
+	///		Timings of a scope marked with RenderDevice::BeginScope/EndScope
+	/// </summary>
+	struct FrameScopeStats
+	{
+		std::string name;
+		// Number of scopes open when this one began
+		unsigned int depth = 0;
+		// CPU time between BeginScope and EndScope, in milliseconds
+		double cpuTime = 0.0;
+		// GPU time taken by the commands submitted inside the scope, in milliseconds, or negative if not available (yet)
+		double gpuTime = -1.0;
+	};
+
+	/// <summary>
+	///		Timings and counters of a frame
+	/// </summary>
+	struct FrameStats
+	{
+		unsigned long long frame = 0;
+		// CPU time between the previous EndFrame and this frame's EndFrame, in milliseconds
+		double cpuTime = 0.0;
+		// GPU time between the first and last command of the frame, in milliseconds, or negative if not available (yet)
+		double gpuTime = -1.0;
+		// Draws submitted, counting every command of an indirect draw as one draw (and not the API calls)
+		unsigned long long drawCalls = 0;
+		// Triangles drawn, without those of indirect draws on devices whose commands are only in GPU memory
+		unsigned long long triangles = 0;
+		unsigned long long stateChanges = 0;
+		unsigned long long bytesUploaded = 0;
+		// Scopes in the order they began
+		std::vector<FrameScopeStats> scopes;
+	};
+
+	/// <summary>
+	///		Collects the timings and counters of the frames of a render device and keeps the last ones in a rolling log.
+	///		GPU timings are only known a few frames later, so they are filled into frames already in the log.
+	/// </summary>
+	class FrameProfiler final
+	{
+	public:
+		static const unsigned int InvalidScope = 0xFFFFFFFF;
+
+		/// <summary>
+		///		Creates a frame profiler
+		/// </summary>
+		/// <param name="historySize">Number of finished frames kept in the log</param>
+		FrameProfiler(unsigned int historySize = 120);
+
+		/// <summary>
+		///		Begins a scope in the current frame
+		/// </summary>
+		/// <param name="name">Scope name</param>
+		/// <returns>Scope index in the current frame</returns>
+		unsigned int BeginScope(const char* name);
+
+		/// <summary>
+		///		Ends the scope most recently begun and not ended yet
+		/// </summary>
+		/// <returns>Index of the ended scope, or InvalidScope if no scope is open</returns>
+		unsigned int EndScope();
+
+		// Add to the counters of the current frame
+		inline void CountDraws(unsigned long long drawCalls, unsigned long long triangles) { m_current.drawCalls += drawCalls; m_current.triangles += triangles; }
+		inline void CountStateChanges(unsigned long long stateChanges = 1) { m_current.stateChanges += stateChanges; }
+		inline void CountUpload(unsigned long long bytes) { m_current.bytesUploaded += bytes; }
+
+		/// <summary>
+		///		Finishes the current frame, moving it into the log, and begins the next one
+		/// </summary>
+		/// <returns>Number of the finished frame</returns>
+		unsigned long long EndFrame();
+
+		/// <summary>
+		///		Sets the GPU time of a scope of a finished frame. Ignored if the frame already left the log.
+		/// </summary>
+		/// <param name="frame">Frame number</param>
+		/// <param name="scope">Scope index, or InvalidScope for the whole frame</param>
+		/// <param name="milliseconds">GPU time in milliseconds</param>
+		void SetGPUTime(unsigned long long frame, unsigned int scope, double milliseconds);
+
+		/// <summary>
+		///		Gets a finished frame from the log
+		/// </summary>
+		/// <param name="age">Number of frames finished after it (0 for the last finished frame)</param>
+		/// <returns>Frame stats, or nullptr if the frame isn't in the log</returns>
+		const FrameStats* GetFrame(unsigned int age = 0) const;
+
+		/// <summary>
+		///		Gets the number of finished frames in the log
+		/// </summary>
+		/// <returns>Number of frames</returns>
+		inline unsigned int GetFrameCount() const { return static_cast<unsigned int>(m_history.size()); }
+
+		/// <summary>
+		///		Gets the number of the frame being recorded
+		/// </summary>
+		/// <returns>Frame number</returns>
+		inline unsigned long long GetCurrentFrame() const { return m_current.frame; }
+
+		/// <summary>
+		///		Writes the frames in the log, oldest first, one line per frame followed by one line per scope
+		/// </summary>
+		/// <param name="os">Output stream</param>
+		/// <param name="frames">Maximum number of frames written (the most recent ones)</param>
+		void WriteLog(std::ostream& os, unsigned int frames = 0xFFFFFFFF) const;
+
+	private:
+		FrameStats* FindFrame(unsigned long long frame);
+
+		unsigned int m_historySize;
+		// Ring of finished frames, m_next is where the next finished frame goes
+		std::vector<FrameStats> m_history;
+		size_t m_next = 0;
+
+		FrameStats m_current;
+		// Indices of the open scopes in the current frame
+		std::vector<unsigned int> m_openScopes;
+		std::vector<std::chrono::steady_clock::time_point> m_scopeStarts;
+		std::chrono::steady_clock::time_point m_frameStart;
+	};
+}
@@ -0,0 +1,229 @@
+#include "MaterialSystem.hpp"
+#include "..\Utils\Utils.hpp"
+
+#include <cstring>
+
+namespace
+{
+	const unsigned long long NoArray = 0xFFFF;
+}
+
+Magma::MaterialSystem::MaterialSystem(RenderDevice * device, unsigned int maxMaterials, int layersPerArray, const SamplerDesc & sampler, bool allowBindless)
+	: m_device(device), m_layersPerArray(layersPerArray > 2 ? layersPerArray : 2), m_bindless(allowBindless)
+{
+	m_materials.resize(maxMaterials);
+	m_records.resize(maxMaterials);
+	memset(m_records.data(), 0, m_records.size() * sizeof(Record));
+	m_freeMaterials.reserve(maxMaterials);
+	for (MaterialID i = maxMaterials; i > 0; --i)
+		m_freeMaterials.push_back(i - 1);
+	m_dirtyBegin = maxMaterials;
+
+	m_buffer = m_device->CreateUniformBuffer(maxMaterials * RecordSize, m_records.data());
+	m_sampler = m_device->CreateSampler(sampler);
+}
+
+Magma::MaterialSystem::~MaterialSystem()
+{
+	for (auto& array : m_arrays)
+		m_device->DestroyTexture2D(array.texture);
+	m_device->DestroySampler(m_sampler);
+	m_device->DestroyUniformBuffer(m_buffer);
+}
+
+Magma::MaterialID Magma::MaterialSystem::CreateMaterial(const MaterialDesc & desc)
+{
+	if (m_freeMaterials.empty())
+	{
+		MAGMA_WARNING("Failed to create material, the maximum number of materials was reached");
+		return InvalidMaterial;
+	}
+	const MaterialID id = m_freeMaterials.back();
+	m_freeMaterials.pop_back();
+
+	Material& material = m_materials[id];
+	Record& record = m_records[id];
+	memcpy(record.params, desc.params, sizeof(record.params));
+	memset(record.handles, 0, sizeof(record.handles));
+
+	unsigned long long key = 0;
+	for (unsigned int t = 0; t < MaterialDesc::MaxTextures; ++t)
+	{
+		const MaterialTexture& texture = desc.textures[t];
+		int layer = -1;
+		material.arrays[t] = texture.width > 0 && texture.height > 0 ? this->AllocateLayer(texture, layer) : -1;
+		record.layers[t] = layer;
+		key = (key << 16) | (material.arrays[t] >= 0 ? static_cast<unsigned long long>(material.arrays[t]) : NoArray);
+		if (material.arrays[t] < 0)
+			continue;
+
+		// Copy the texture into its layer
+		const Array& array = m_arrays[material.arrays[t]];
+		if (texture.data != nullptr)
+		{
+			for (int level = 0; level < (texture.generateMips ? 1 : array.levels); ++level)
+				if (texture.data[level] != nullptr)
+					m_device->UpdateTexture2D(array.texture, layer, level, texture.data[level], texture.generateMips && array.levels > 1);
+		}
+
+		if (m_bindless)
+		{
+			const unsigned long long handle = m_device->GetTexture2DHandle(array.texture, m_sampler);
+			record.handles[t * 2] = static_cast<unsigned int>(handle);
+			record.handles[t * 2 + 1] = static_cast<unsigned int>(handle >> 32);
+		}
+	}
+
+	// Materials whose textures are in the same arrays share their texture set
+	if (m_bindless)
+		material.textureSet = 0;
+	else
+	{
+		auto it = m_textureSetIDs.find(key);
+		if (it == m_textureSetIDs.end())
+		{
+			it = m_textureSetIDs.insert(std::make_pair(key, static_cast<unsigned int>(m_textureSets.size()))).first;
+			m_textureSets.push_back(key);
+		}
+		material.textureSet = it->second;
+	}
+
+	material.alive = true;
+	this->MarkDirty(id);
+	return id;
+}
+
+void Magma::MaterialSystem::DestroyMaterial(MaterialID material)
+{
+	if (!this->IsValid(material, "destroy"))
+		return;
+
+	Material& m = m_materials[material];
+	for (unsigned int t = 0; t < MaterialDesc::MaxTextures; ++t)
+		if (m.arrays[t] >= 0)
+			m_arrays[m.arrays[t]].freeLayers.push_back(m_records[material].layers[t]);
+	m.alive = false;
+	m_freeMaterials.push_back(material);
+}
+
+void Magma::MaterialSystem::SetMaterialParams(MaterialID material, const float params[4])
+{
+	if (!this->IsValid(material, "set params of"))
+		return;
+	memcpy(m_records[material].params, params, sizeof(m_records[material].params));
+	this->MarkDirty(material);
+}
+
+void Magma::MaterialSystem::Flush()
+{
+	if (m_dirtyBegin >= m_dirtyEnd)
+		return;
+	m_device->UpdateUniformBuffer(m_buffer, m_dirtyBegin * RecordSize, (m_dirtyEnd - m_dirtyBegin) * RecordSize, &m_records[m_dirtyBegin]);
+	m_dirtyBegin = static_cast<MaterialID>(m_records.size());
+	m_dirtyEnd = 0;
+}
+
+void Magma::MaterialSystem::SetBuffer(Pipeline * pipeline, ParamID block)
+{
+	pipeline->SetUniformBuffer(block, m_buffer);
+}
+
+int Magma::MaterialSystem::Bind(MaterialID material)
+{
+	if (!this->IsValid(material, "bind"))
+		return 0;
+	if (m_bindless)
+		return static_cast<int>(material);
+
+	const Material& m = m_materials[material];
+	for (unsigned int t = 0; t < MaterialDesc::MaxTextures; ++t)
+	{
+		m_device->SetTexture2D(t, m.arrays[t] >= 0 ? m_arrays[m.arrays[t]].texture : nullptr);
+		m_device->SetSampler(t, m_sampler);
+	}
+	return static_cast<int>(material);
+}
+
+void Magma::MaterialSystem::SetDrawItem(MaterialID material, DrawItem & item) const
+{
+	if (!this->IsValid(material, "set draw item of"))
+		return;
+
+	item.material = static_cast<int>(material);
+	item.textureCount = m_bindless ? 0 : MaterialDesc::MaxTextures;
+	const Material& m = m_materials[material];
+	for (unsigned int t = 0; t < item.textureCount; ++t)
+		item.textures[t] = m.arrays[t] >= 0 ? m_arrays[m.arrays[t]].texture : nullptr;
+}
+
+unsigned int Magma::MaterialSystem::GetTextureSet(MaterialID material) const
+{
+	return material < m_materials.size() ? m_materials[material].textureSet : 0;
+}
+
+int Magma::MaterialSystem::AllocateLayer(const MaterialTexture & texture, int & layer)
+{
+	const int levels = texture.mipLevels > 0 ? texture.mipLevels : RenderDevice::GetFullMipLevels(texture.width, texture.height);
+
+	int index = -1;
+	for (size_t i = 0; i < m_arrays.size() && index < 0; ++i)
+	{
+		const Array& array = m_arrays[i];
+		if (array.width == texture.width && array.height == texture.height && array.format == texture.format &&
+			array.levels == levels && !array.freeLayers.empty())
+			index = static_cast<int>(i);
+	}
+
+	if (index < 0)
+	{
+		if (m_arrays.size() >= NoArray)
+		{
+			MAGMA_WARNING("Failed to allocate material texture layer, too many texture arrays");
+			return -1;
+		}
+
+		Texture2DDesc desc;
+		desc.width = texture.width;
+		desc.height = texture.height;
+		desc.format = texture.format;
+		desc.mipLevels = levels;
+		desc.arrayLayers = m_layersPerArray;
+
+		Array array;
+		array.texture = m_device->CreateTexture2D(desc);
+		array.width = texture.width;
+		array.height = texture.height;
+		array.format = texture.format;
+		array.levels = levels;
+		// Hand out the lowest layers first
+		for (int l = m_layersPerArray; l > 0; --l)
+			array.freeLayers.push_back(l - 1);
+
+		// Fall back to bound arrays as soon as the device doesn't give a handle
+		if (m_bindless && m_device->GetTexture2DHandle(array.texture, m_sampler) == 0)
+			m_bindless = false;
+
+		index = static_cast<int>(m_arrays.size());
+		m_arrays.push_back(std::move(array));
+	}
+
+	layer = m_arrays[index].freeLayers.back();
+	m_arrays[index].freeLayers.pop_back();
+	return index;
+}
+
+bool Magma::MaterialSystem::IsValid(MaterialID material, const char * action) const
+{
+	if (material >= m_materials.size() || !m_materials[material].alive)
+	{
+		MAGMA_WARNING(std::string("Failed to ") + action + " material, it isn't alive");
+		return false;
+	}
+	return true;
+}
+
+void Magma::MaterialSystem::MarkDirty(MaterialID material)
+{
+	m_dirtyBegin = material < m_dirtyBegin ? material : m_dirtyBegin;
+	m_dirtyEnd = material + 1 > m_dirtyEnd ? material + 1 : m_dirtyEnd;
+}
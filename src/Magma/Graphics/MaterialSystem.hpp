@@ -0,0 +1,204 @@
+#pragma once
+
+#include "RenderDevice.hpp"
+#include "RenderQueue.hpp"
+
+#include <map>
+#include <vector>
+
+namespace Magma
+{
+	/// <summary>
+	///		Material identifier, also the index of the material record in the materials uniform buffer
+	/// </summary>
+	typedef unsigned int MaterialID;
+
+	/// <summary>
+	///		Describes a material texture, copied into a layer of a texture array shared with other textures of the same size, format and mip levels
+	/// </summary>
+	struct MaterialTexture
+	{
+		/// <summary>
+		///		Width and height (a width of zero means the material has no texture in this slot)
+		/// </summary>
+		int width = 0;
+		int height = 0;
+		TextureFormat format = TextureFormat::RGBA8;
+
+		/// <summary>
+		///		Number of mip levels (0 for the full chain)
+		/// </summary>
+		int mipLevels = 0;
+
+		/// <summary>
+		///		Generate the mip levels from level zero instead of uploading them
+		/// </summary>
+		bool generateMips = true;
+
+		/// <summary>
+		///		Data of each mip level (only level zero if generateMips is true), may be null to leave the layer uninitialized
+		/// </summary>
+		const void* const* data = nullptr;
+	};
+
+	/// <summary>
+	///		Describes a material
+	/// </summary>
+	struct MaterialDesc
+	{
+		static const unsigned int MaxTextures = 4;
+
+		MaterialTexture textures[MaxTextures];
+
+		/// <summary>
+		///		Material constants, available to the shaders in the material record
+		/// </summary>
+		float params[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	};
+
+	/// <summary>
+	///		Packs material textures into texture arrays and material constants into one uniform buffer, so that draws with different
+	///		materials only differ in a material index instead of in their texture bindings. With bindless textures (ARB_bindless_texture)
+	///		the records also hold the array handles and no texture is ever bound.
+	///		Shaders declare the materials uniform block (std140) and index it with the material index:
+	///			struct Material { vec4 params; ivec4 layers; uvec4 handles[2]; };
+	///			layout (std140) uniform Materials { Material materials[MAX_MATERIALS]; };
+	///		layers[t] is the array layer of texture t (-1 if none). Without bindless textures, texture t is sampled from the sampler2DArray
+	///		on slot t: texture(textures[t], vec3(uv, materials[i].layers[t])). With them, from sampler2DArray(handles[t / 2].xy or .zw).
+	/// </summary>
+	class MaterialSystem final
+	{
+	public:
+		static const MaterialID InvalidMaterial = 0xFFFFFFFF;
+
+		/// <summary>
+		///		Size in bytes of a material record in the uniform buffer
+		/// </summary>
+		static const long long RecordSize = 64;
+
+		/// <summary>
+		///		Creates the materials uniform buffer and the sampler of the texture arrays
+		/// </summary>
+		/// <param name="device">Render device</param>
+		/// <param name="maxMaterials">Maximum number of materials (the uniform buffer size must fit in GL_MAX_UNIFORM_BLOCK_SIZE, 16 KB at least)</param>
+		/// <param name="layersPerArray">Number of layers of each texture array (at least 2)</param>
+		/// <param name="sampler">Sampler of the texture arrays</param>
+		/// <param name="allowBindless">Use bindless textures if the device supports them</param>
+		MaterialSystem(RenderDevice* device, unsigned int maxMaterials = 256, int layersPerArray = 64, const SamplerDesc& sampler = SamplerDesc(), bool allowBindless = true);
+		~MaterialSystem();
+
+		/// <summary>
+		///		Creates a material, uploading its textures into free array layers
+		/// </summary>
+		/// <param name="desc">Material description</param>
+		/// <returns>Material, or InvalidMaterial if there are already maxMaterials materials</returns>
+		MaterialID CreateMaterial(const MaterialDesc& desc);
+
+		/// <summary>
+		///		Destroys a material, freeing its array layers for new materials
+		/// </summary>
+		/// <param name="material">Material</param>
+		void DestroyMaterial(MaterialID material);
+
+		/// <summary>
+		///		Changes the constants of a material, uploaded on the next Flush
+		/// </summary>
+		/// <param name="material">Material</param>
+		/// <param name="params">Material constants</param>
+		void SetMaterialParams(MaterialID material, const float params[4]);
+
+		/// <summary>
+		///		Uploads the records changed since the last flush, in a single update. Must be called before drawing with them.
+		/// </summary>
+		void Flush();
+
+		/// <summary>
+		///		Sources a pipeline uniform block from the materials uniform buffer
+		/// </summary>
+		/// <param name="pipeline">Pipeline</param>
+		/// <param name="block">Uniform block ID</param>
+		void SetBuffer(Pipeline* pipeline, ParamID block = MakeParamID("Materials"));
+
+		/// <summary>
+		///		Binds the texture arrays of a material on slots 0 to MaxTextures - 1, and the materials sampler on the same slots.
+		///		Does nothing with bindless textures.
+		/// </summary>
+		/// <param name="material">Material</param>
+		/// <returns>Index of the material record, for the shaders</returns>
+		int Bind(MaterialID material);
+
+		/// <summary>
+		///		Sets the texture arrays and the material index of a draw. The materials sampler must be bound on the texture slots (see Bind).
+		/// </summary>
+		/// <param name="material">Material</param>
+		/// <param name="item">Draw, whose materialParam must be set to the pipeline material index param</param>
+		void SetDrawItem(MaterialID material, DrawItem& item) const;
+
+		/// <summary>
+		///		Gets the texture set of a material, shared by every material whose textures are in the same arrays.
+		///		Used as the texture set of the render queue sort keys. Always 0 with bindless textures.
+		/// </summary>
+		/// <param name="material">Material</param>
+		/// <returns>Texture set identifier</returns>
+		unsigned int GetTextureSet(MaterialID material) const;
+
+		inline bool IsBindless() const { return m_bindless; }
+		inline UniformBuffer* GetBuffer() const { return m_buffer; }
+		inline Sampler* GetSampler() const { return m_sampler; }
+
+		/// <summary>
+		///		Gets the number of texture arrays created
+		/// </summary>
+		/// <returns>Number of texture arrays</returns>
+		inline size_t GetArrayCount() const { return m_arrays.size(); }
+
+	private:
+		// Material record, laid out as the std140 struct declared by the shaders
+		struct Record
+		{
+			float params[4];
+			int layers[MaterialDesc::MaxTextures];
+			unsigned int handles[MaterialDesc::MaxTextures * 2];
+		};
+
+		struct Array
+		{
+			Texture2D* texture = nullptr;
+			int width;
+			int height;
+			TextureFormat format;
+			int levels;
+			std::vector<int> freeLayers;
+		};
+
+		struct Material
+		{
+			bool alive = false;
+			int arrays[MaterialDesc::MaxTextures];
+			unsigned int textureSet = 0;
+		};
+
+		// Finds or creates an array with a free layer for a texture, returns its index
+		int AllocateLayer(const MaterialTexture& texture, int& layer);
+		bool IsValid(MaterialID material, const char* action) const;
+		void MarkDirty(MaterialID material);
+
+		RenderDevice* m_device;
+		UniformBuffer* m_buffer = nullptr;
+		Sampler* m_sampler = nullptr;
+		int m_layersPerArray;
+		bool m_bindless;
+
+		std::vector<Array> m_arrays;
+		std::vector<Material> m_materials;
+		std::vector<Record> m_records;
+		std::vector<MaterialID> m_freeMaterials;
+		// Texture sets by their packed array indices, and the array indices of each set
+		std::map<unsigned long long, unsigned int> m_textureSetIDs;
+		std::vector<unsigned long long> m_textureSets;
+
+		// Range of records changed since the last flush
+		MaterialID m_dirtyBegin;
+		MaterialID m_dirtyEnd = 0;
+	};
+}
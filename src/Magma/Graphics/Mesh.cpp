@@ -0,0 +1,81 @@
+#include "Mesh.hpp"
+#include "..\Utils\Utils.hpp"
+
+#include <cmath>
+
+Magma::Mesh::Mesh(RenderDevice * device, const MeshData & data)
+	: m_device(device)
+{
+	m_vertexBuffer = m_device->CreateVertexBuffer(data.vertices.size(), data.vertices.data());
+	m_vertexDescription = m_device->CreateVertexDescription(static_cast<unsigned int>(data.elements.size()), data.elements.data());
+	m_vertexArray = m_device->CreateVertexArray(1, &m_vertexBuffer, &m_vertexDescription);
+
+	m_indexCount = static_cast<int>(data.indices.size());
+	m_indexFormat = ChooseIndexFormat(data.indices.data(), data.indices.size());
+	if (m_indexFormat == IndexFormat::UInt16)
+	{
+		std::vector<unsigned short> indices(data.indices.begin(), data.indices.end());
+		m_indexBuffer = m_device->CreateIndexBuffer(indices.size() * sizeof(unsigned short), indices.data(), BufferUsage::Static, m_indexFormat);
+	}
+	else
+		m_indexBuffer = m_device->CreateIndexBuffer(data.indices.size() * sizeof(unsigned int), data.indices.data(), BufferUsage::Static, m_indexFormat);
+
+	for (auto& lod : data.lods)
+		if (static_cast<size_t>(lod.firstIndex) + lod.indexCount > data.indices.size())
+			MAGMA_WARNING("Mesh level of detail " + std::to_string(m_lods.size()) + " is out of the index range, ignoring it");
+		else
+			m_lods.push_back(lod);
+	if (m_lods.empty())
+	{
+		m_lods.emplace_back();
+		m_lods.back().indexCount = static_cast<unsigned int>(m_indexCount);
+	}
+}
+
+Magma::Mesh::~Mesh()
+{
+	m_device->DestroyIndexBuffer(m_indexBuffer);
+	m_device->DestroyVertexArray(m_vertexArray);
+	m_device->DestroyVertexDescription(m_vertexDescription);
+	m_device->DestroyVertexBuffer(m_vertexBuffer);
+}
+
+Magma::IndexFormat Magma::Mesh::ChooseIndexFormat(const unsigned int * indices, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		if (indices[i] > 0xFFFF)
+			return IndexFormat::UInt32;
+	return IndexFormat::UInt16;
+}
+
+float Magma::Mesh::GetLODProjectionScale(float verticalFov, int viewportHeight)
+{
+	return 0.5f * static_cast<float>(viewportHeight) / std::tan(0.5f * verticalFov);
+}
+
+unsigned int Magma::Mesh::SelectLOD(float distance, float projectionScale, float maxPixelError) const
+{
+	if (distance <= 0.0f)
+		return 0;
+
+	// Levels are ordered by increasing error
+	for (unsigned int lod = this->GetLODCount(); lod-- > 1;)
+		if (m_lods[lod].error * projectionScale / distance <= maxPixelError)
+			return lod;
+	return 0;
+}
+
+void Magma::Mesh::Draw(unsigned int lod)
+{
+	if (lod >= m_lods.size())
+		lod = static_cast<unsigned int>(m_lods.size() - 1);
+
+	m_device->SetVertexArray(m_vertexArray);
+	m_device->SetIndexBuffer(m_indexBuffer);
+	m_device->DrawTrianglesIndexed(this->GetLODOffset(lod), static_cast<int>(m_lods[lod].indexCount));
+}
+
+long long Magma::Mesh::GetLODOffset(unsigned int lod) const
+{
+	return static_cast<long long>(m_lods[lod].firstIndex) * (m_indexFormat == IndexFormat::UInt16 ? sizeof(unsigned short) : sizeof(unsigned int));
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "RenderDevice.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace Magma
+{
+	/// <summary>
+	///		Index range of a level of detail of a mesh
+	/// </summary>
+	struct MeshLOD
+	{
+		unsigned int firstIndex = 0;
+		unsigned int indexCount = 0;
+
+		/// <summary>
+		///		Geometric error of the level compared to the most detailed one, as an object space distance
+		/// </summary>
+		float error = 0.0f;
+	};
+
+	/// <summary>
+	///		CPU side mesh, with interleaved vertices and 32 bit triangle list indices
+	/// </summary>
+	struct MeshData
+	{
+		/// <summary>
+		///		Interleaved vertex data
+		/// </summary>
+		std::vector<unsigned char> vertices;
+
+		/// <summary>
+		///		Number of bytes per vertex
+		/// </summary>
+		unsigned int vertexStride = 0;
+
+		/// <summary>
+		///		Vertex elements describing a vertex
+		/// </summary>
+		std::vector<VertexElement> elements;
+
+		/// <summary>
+		///		Triangle list indices
+		/// </summary>
+		std::vector<unsigned int> indices;
+
+		/// <summary>
+		///		Levels of detail, from the most detailed, as ranges of the indices (leave empty for a single level with every index)
+		/// </summary>
+		std::vector<MeshLOD> lods;
+
+		/// <summary>
+		///		Gets the number of vertices
+		/// </summary>
+		/// <returns>Vertex count</returns>
+		inline size_t GetVertexCount() const { return vertexStride > 0 ? vertices.size() / vertexStride : 0; }
+	};
+
+	/// <summary>
+	///		Mesh uploaded to a render device, owning its vertex buffer, vertex description, vertex array and index buffer.
+	///		Indices are stored in 16 bits whenever every index fits.
+	/// </summary>
+	class Mesh final
+	{
+	public:
+		/// <summary>
+		///		Uploads a mesh to a render device
+		/// </summary>
+		/// <param name="device">Render device</param>
+		/// <param name="data">Mesh data</param>
+		Mesh(RenderDevice* device, const MeshData& data);
+		~Mesh();
+
+		Mesh(const Mesh&) = delete;
+		Mesh& operator=(const Mesh&) = delete;
+
+		/// <summary>
+		///		Chooses the smallest index format able to store some indices
+		/// </summary>
+		/// <param name="indices">Indices</param>
+		/// <param name="count">Number of indices</param>
+		/// <returns>Index format</returns>
+		static IndexFormat ChooseIndexFormat(const unsigned int* indices, size_t count);
+
+		/// <summary>
+		///		Gets the scale projecting object space sizes at a distance of one to pixels, used to select levels of detail
+		/// </summary>
+		/// <param name="verticalFov">Vertical field of view in radians</param>
+		/// <param name="viewportHeight">Viewport height in pixels</param>
+		/// <returns>Projection scale</returns>
+		static float GetLODProjectionScale(float verticalFov, int viewportHeight);
+
+		/// <summary>
+		///		Selects the least detailed level whose error, projected on the screen, is below a number of pixels
+		/// </summary>
+		/// <param name="distance">Distance from the camera to the mesh (in object space units)</param>
+		/// <param name="projectionScale">Projection scale (see GetLODProjectionScale)</param>
+		/// <param name="maxPixelError">Maximum projected error in pixels</param>
+		/// <returns>Level of detail</returns>
+		unsigned int SelectLOD(float distance, float projectionScale, float maxPixelError = 1.0f) const;
+
+		/// <summary>
+		///		Binds the mesh and draws a level of detail with the current pipeline
+		/// </summary>
+		/// <param name="lod">Level of detail</param>
+		void Draw(unsigned int lod = 0);
+
+		/// <summary>
+		///		Gets the offset in bytes into the index buffer of a level of detail, to draw it with DrawTrianglesIndexed
+		/// </summary>
+		/// <param name="lod">Level of detail</param>
+		/// <returns>Offset in bytes</returns>
+		long long GetLODOffset(unsigned int lod) const;
+
+		inline unsigned int GetLODCount() const { return static_cast<unsigned int>(m_lods.size()); }
+		inline const MeshLOD& GetLOD(unsigned int lod) const { return m_lods[lod]; }
+
+		inline VertexArray* GetVertexArray() const { return m_vertexArray; }
+		inline IndexBuffer* GetIndexBuffer() const { return m_indexBuffer; }
+		inline IndexFormat GetIndexFormat() const { return m_indexFormat; }
+		inline int GetIndexCount() const { return m_indexCount; }
+
+	private:
+		RenderDevice* m_device;
+		VertexBuffer* m_vertexBuffer = nullptr;
+		VertexDescription* m_vertexDescription = nullptr;
+		VertexArray* m_vertexArray = nullptr;
+		IndexBuffer* m_indexBuffer = nullptr;
+		IndexFormat m_indexFormat = IndexFormat::UInt32;
+		int m_indexCount = 0;
+		std::vector<MeshLOD> m_lods;
+	};
+}
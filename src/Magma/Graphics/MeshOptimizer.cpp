@@ -0,0 +1,395 @@
+#include "MeshOptimizer.hpp"
+#include "..\Utils\Utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const unsigned int InvalidIndex = 0xFFFFFFFF;
+
+	bool CheckIndices(const unsigned int* indices, size_t indexCount, size_t vertexCount, const char* action)
+	{
+		if (indexCount % 3 != 0)
+		{
+			MAGMA_WARNING(std::string("Failed to ") + action + ", the index count isn't a multiple of three");
+			return false;
+		}
+		for (size_t i = 0; i < indexCount; ++i)
+			if (indices[i] >= vertexCount)
+			{
+				MAGMA_WARNING(std::string("Failed to ") + action + ", index " + std::to_string(i) + " is out of range");
+				return false;
+			}
+		return true;
+	}
+
+	// FIFO vertex cache simulated with time stamps: a vertex is cached if it was pushed less than cacheSize pushes ago
+	class VertexCache
+	{
+	public:
+		VertexCache(size_t vertexCount, unsigned int cacheSize)
+			: m_stamps(vertexCount, 0), m_cacheSize(cacheSize), m_time(cacheSize + 1)
+		{
+
+		}
+
+		// Returns true on a miss
+		bool Access(unsigned int vertex)
+		{
+			if (m_time - m_stamps[vertex] <= m_cacheSize)
+				return false;
+			m_stamps[vertex] = m_time++;
+			return true;
+		}
+
+		void Flush()
+		{
+			m_time += m_cacheSize + 1;
+		}
+
+	private:
+		std::vector<unsigned int> m_stamps;
+		unsigned int m_cacheSize;
+		unsigned int m_time;
+	};
+
+	const float* GetPosition(const float* positions, size_t positionStride, unsigned int vertex)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + vertex * positionStride);
+	}
+}
+
+Magma::VertexCacheStats Magma::AnalyzeVertexCache(const unsigned int * indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats;
+	if (indexCount == 0 || !CheckIndices(indices, indexCount, vertexCount, "analyze vertex cache"))
+		return stats;
+
+	VertexCache cache(vertexCount, cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+	size_t uniqueVertices = 0;
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		if (cache.Access(indices[i]))
+			++stats.transforms;
+		if (!referenced[indices[i]])
+		{
+			referenced[indices[i]] = true;
+			++uniqueVertices;
+		}
+	}
+
+	stats.acmr = static_cast<float>(stats.transforms) / static_cast<float>(indexCount / 3);
+	stats.atvr = static_cast<float>(stats.transforms) / static_cast<float>(uniqueVertices);
+	return stats;
+}
+
+void Magma::OptimizeVertexCache(unsigned int * indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	if (indexCount == 0 || !CheckIndices(indices, indexCount, vertexCount, "optimize vertex cache"))
+		return;
+
+	const size_t triangleCount = indexCount / 3;
+
+	// Triangles adjacent to each vertex, and the number of those not emitted yet
+	std::vector<unsigned int> live(vertexCount, 0);
+	for (size_t i = 0; i < indexCount; ++i)
+		++live[indices[i]];
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+		offsets[v + 1] = offsets[v] + live[v];
+	std::vector<unsigned int> adjacency(indexCount);
+	{
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indexCount; ++i)
+			adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+	}
+
+	std::vector<unsigned int> stamps(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(indexCount);
+	deadEnd.reserve(indexCount);
+
+	unsigned int time = cacheSize + 1;
+	size_t cursor = 0;
+	unsigned int fanning = indices[0];
+	while (fanning != InvalidIndex)
+	{
+		// Emit every triangle around the fanning vertex
+		candidates.clear();
+		for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; ++a)
+		{
+			const unsigned int triangle = adjacency[a];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = true;
+
+			for (unsigned int corner = 0; corner < 3; ++corner)
+			{
+				const unsigned int v = indices[triangle * 3 + corner];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				--live[v];
+				if (time - stamps[v] > cacheSize)
+					stamps[v] = time++;
+			}
+		}
+
+		// Fan next around the oldest candidate that will still be in the cache once its triangles are emitted
+		fanning = InvalidIndex;
+		int bestPriority = -1;
+		for (unsigned int v : candidates)
+			if (live[v] > 0)
+			{
+				int priority = 0;
+				if (time - stamps[v] + 2 * live[v] <= cacheSize)
+					priority = static_cast<int>(time - stamps[v]);
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					fanning = v;
+				}
+			}
+
+		// Otherwise continue from the most recently emitted vertex with triangles left, or from the next vertex in order
+		while (fanning == InvalidIndex && !deadEnd.empty())
+		{
+			if (live[deadEnd.back()] > 0)
+				fanning = deadEnd.back();
+			deadEnd.pop_back();
+		}
+		for (; fanning == InvalidIndex && cursor < vertexCount; ++cursor)
+			if (live[cursor] > 0)
+				fanning = static_cast<unsigned int>(cursor);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void Magma::OptimizeOverdraw(unsigned int * indices, size_t indexCount, const float * positions, size_t positionStride, size_t vertexCount, unsigned int cacheSize, float threshold)
+{
+	if (indexCount == 0 || !CheckIndices(indices, indexCount, vertexCount, "optimize overdraw"))
+		return;
+
+	const size_t triangleCount = indexCount / 3;
+
+	// Hard boundaries, where a triangle misses the cache with every vertex
+	std::vector<size_t> hard;
+	{
+		VertexCache cache(vertexCount, cacheSize);
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			unsigned int misses = 0;
+			for (unsigned int corner = 0; corner < 3; ++corner)
+				misses += cache.Access(indices[t * 3 + corner]) ? 1 : 0;
+			if (t == 0 || misses == 3)
+				hard.push_back(t);
+		}
+		hard.push_back(triangleCount);
+	}
+
+	// Soft boundaries, splitting hard clusters wherever the ACMR of the cluster so far is within the threshold of the whole cluster's
+	std::vector<size_t> clusters;
+	for (size_t h = 0; h + 1 < hard.size(); ++h)
+	{
+		const size_t start = hard[h], end = hard[h + 1];
+
+		VertexCache cache(vertexCount, cacheSize);
+		unsigned int misses = 0;
+		for (size_t t = start; t < end; ++t)
+			for (unsigned int corner = 0; corner < 3; ++corner)
+				misses += cache.Access(indices[t * 3 + corner]) ? 1 : 0;
+		const float limit = threshold * static_cast<float>(misses) / static_cast<float>(end - start);
+
+		cache.Flush();
+		clusters.push_back(start);
+		unsigned int clusterMisses = 0;
+		size_t clusterTriangles = 0;
+		for (size_t t = start; t < end; ++t)
+		{
+			for (unsigned int corner = 0; corner < 3; ++corner)
+				clusterMisses += cache.Access(indices[t * 3 + corner]) ? 1 : 0;
+			++clusterTriangles;
+
+			if (t + 1 < end && static_cast<float>(clusterMisses) / static_cast<float>(clusterTriangles) <= limit)
+			{
+				clusters.push_back(t + 1);
+				cache.Flush();
+				clusterMisses = 0;
+				clusterTriangles = 0;
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	// Area weighted centroid and normal of each cluster and of the whole mesh
+	const size_t clusterCount = clusters.size() - 1;
+	std::vector<float> centroids(clusterCount * 3, 0.0f), normals(clusterCount * 3, 0.0f), areas(clusterCount, 0.0f);
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterCount; ++c)
+	{
+		for (size_t t = clusters[c]; t < clusters[c + 1]; ++t)
+		{
+			const float* p0 = GetPosition(positions, positionStride, indices[t * 3 + 0]);
+			const float* p1 = GetPosition(positions, positionStride, indices[t * 3 + 1]);
+			const float* p2 = GetPosition(positions, positionStride, indices[t * 3 + 2]);
+
+			const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			const float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (int i = 0; i < 3; ++i)
+			{
+				centroids[c * 3 + i] += (p0[i] + p1[i] + p2[i]) / 3.0f * area;
+				normals[c * 3 + i] += n[i];
+			}
+			areas[c] += area;
+		}
+
+		for (int i = 0; i < 3; ++i)
+			meshCentroid[i] += centroids[c * 3 + i];
+		meshArea += areas[c];
+	}
+	for (int i = 0; i < 3; ++i)
+		meshCentroid[i] = meshArea > 0.0f ? meshCentroid[i] / meshArea : 0.0f;
+
+	// Clusters facing away from the center occlude the others, so they are drawn first
+	std::vector<float> keys(clusterCount, 0.0f);
+	for (size_t c = 0; c < clusterCount; ++c)
+	{
+		if (areas[c] <= 0.0f)
+			continue;
+		const float* n = &normals[c * 3];
+		const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length <= 0.0f)
+			continue;
+		for (int i = 0; i < 3; ++i)
+			keys[c] += (centroids[c * 3 + i] / areas[c] - meshCentroid[i]) * n[i] / length;
+	}
+
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+	std::vector<unsigned int> output;
+	output.reserve(indexCount);
+	for (size_t c : order)
+		output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+	std::copy(output.begin(), output.end(), indices);
+}
+
+size_t Magma::OptimizeVertexFetch(MeshData & mesh)
+{
+	const size_t vertexCount = mesh.GetVertexCount();
+	if (!CheckIndices(mesh.indices.data(), mesh.indices.size(), vertexCount, "optimize vertex fetch"))
+		return vertexCount;
+
+	std::vector<unsigned int> remap(vertexCount, InvalidIndex);
+	std::vector<unsigned char> vertices;
+	vertices.reserve(mesh.vertices.size());
+	unsigned int next = 0;
+	for (auto& index : mesh.indices)
+	{
+		if (remap[index] == InvalidIndex)
+		{
+			remap[index] = next++;
+			const unsigned char* vertex = &mesh.vertices[index * mesh.vertexStride];
+			vertices.insert(vertices.end(), vertex, vertex + mesh.vertexStride);
+		}
+		index = remap[index];
+	}
+
+	mesh.vertices = std::move(vertices);
+	return next;
+}
+
+size_t Magma::DeduplicateVertices(MeshData & mesh)
+{
+	const size_t vertexCount = mesh.GetVertexCount();
+	if (vertexCount == 0 || !CheckIndices(mesh.indices.data(), mesh.indices.size(), vertexCount, "deduplicate vertices"))
+		return vertexCount;
+
+	const unsigned int stride = mesh.vertexStride;
+	auto hash = [&mesh, stride](size_t vertex)
+	{
+		// FNV-1a over the vertex bytes
+		unsigned int h = 2166136261u;
+		for (size_t i = vertex * stride; i < (vertex + 1) * stride; ++i)
+			h = (h ^ mesh.vertices[i]) * 16777619u;
+		return h;
+	};
+
+	// Open addressing table of the unique vertices, indexed by hash
+	size_t tableSize = 1;
+	while (tableSize < vertexCount * 2)
+		tableSize *= 2;
+	std::vector<unsigned int> table(tableSize, InvalidIndex);
+
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<unsigned char> vertices;
+	vertices.reserve(mesh.vertices.size());
+	unsigned int next = 0;
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		const unsigned char* vertex = &mesh.vertices[v * stride];
+		size_t slot = hash(v) & (tableSize - 1);
+		while (table[slot] != InvalidIndex && memcmp(&vertices[table[slot] * stride], vertex, stride) != 0)
+			slot = (slot + 1) & (tableSize - 1);
+
+		if (table[slot] == InvalidIndex)
+		{
+			table[slot] = next++;
+			vertices.insert(vertices.end(), vertex, vertex + stride);
+		}
+		remap[v] = table[slot];
+	}
+
+	for (auto& index : mesh.indices)
+		index = remap[index];
+	mesh.vertices = std::move(vertices);
+	return next;
+}
+
+void Magma::OptimizeMesh(MeshData & mesh, unsigned int positionIndex, unsigned int cacheSize)
+{
+	DeduplicateVertices(mesh);
+
+	const VertexElement* position = nullptr;
+	for (auto& element : mesh.elements)
+		if (element.index == positionIndex && element.type == VertexElementType::Float && element.size >= 3)
+			position = &element;
+	if (position == nullptr)
+		MAGMA_WARNING("Skipping overdraw optimization, the mesh has no float position element with location " + std::to_string(positionIndex));
+
+	// Triangles are only reordered within each level of detail, so that the LOD index ranges stay valid
+	std::vector<MeshLOD> ranges = mesh.lods;
+	if (ranges.empty())
+	{
+		ranges.emplace_back();
+		ranges.back().indexCount = static_cast<unsigned int>(mesh.indices.size());
+	}
+	for (auto& range : ranges)
+	{
+		if (static_cast<size_t>(range.firstIndex) + range.indexCount > mesh.indices.size())
+		{
+			MAGMA_WARNING("Skipping mesh LOD optimization, its index range is out of the mesh indices");
+			continue;
+		}
+		unsigned int* indices = mesh.indices.data() + range.firstIndex;
+		OptimizeVertexCache(indices, range.indexCount, mesh.GetVertexCount(), cacheSize);
+		if (position != nullptr)
+			OptimizeOverdraw(indices, range.indexCount, reinterpret_cast<const float*>(mesh.vertices.data() + position->offset),
+							 mesh.vertexStride, mesh.GetVertexCount(), cacheSize);
+	}
+
+	OptimizeVertexFetch(mesh);
+}
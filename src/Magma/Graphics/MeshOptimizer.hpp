@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Mesh.hpp"
+
+#include <cstddef>
+
+namespace Magma
+{
+	/// <summary>
+	///		Vertex transform counts of an index buffer, simulated on a FIFO post-transform vertex cache
+	/// </summary>
+	struct VertexCacheStats
+	{
+		/// <summary>
+		///		Number of vertices transformed (cache misses)
+		/// </summary>
+		unsigned int transforms = 0;
+
+		/// <summary>
+		///		Average cache miss ratio: vertices transformed per triangle (0.5 at best, 3 at worst)
+		/// </summary>
+		float acmr = 0.0f;
+
+		/// <summary>
+		///		Average transform to vertex ratio: vertices transformed per vertex referenced (1 at best)
+		/// </summary>
+		float atvr = 0.0f;
+	};
+
+	/// <summary>
+	///		Simulates a FIFO post-transform vertex cache on a triangle list
+	/// </summary>
+	/// <param name="indices">Triangle list indices</param>
+	/// <param name="indexCount">Number of indices</param>
+	/// <param name="vertexCount">Number of vertices</param>
+	/// <param name="cacheSize">Number of vertices in the cache</param>
+	/// <returns>Cache stats</returns>
+	VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16);
+
+	/// <summary>
+	///		Reorders the triangles of a triangle list for the post-transform vertex cache (Tipsify, Sander et al. 2007).
+	///		Runs in linear time and doesn't depend much on the exact cache size.
+	/// </summary>
+	/// <param name="indices">Triangle list indices, reordered in place</param>
+	/// <param name="indexCount">Number of indices</param>
+	/// <param name="vertexCount">Number of vertices</param>
+	/// <param name="cacheSize">Number of vertices in the cache</param>
+	void OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16);
+
+	/// <summary>
+	///		Reorders clusters of triangles of a triangle list optimized with OptimizeVertexCache so that outward facing clusters
+	///		are drawn first, which reduces overdraw when the mesh is rendered with depth testing.
+	///		Clusters are split where the vertex cache would be flushed, and where splitting costs less than the threshold in ACMR.
+	/// </summary>
+	/// <param name="indices">Triangle list indices, reordered in place</param>
+	/// <param name="indexCount">Number of indices</param>
+	/// <param name="positions">Vertex positions (three floats per vertex)</param>
+	/// <param name="positionStride">Number of bytes between the positions of successive vertices</param>
+	/// <param name="vertexCount">Number of vertices</param>
+	/// <param name="cacheSize">Number of vertices in the cache</param>
+	/// <param name="threshold">Maximum ACMR degradation allowed (1.05 allows 5% more vertex transforms)</param>
+	void OptimizeOverdraw(unsigned int* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, unsigned int cacheSize = 16, float threshold = 1.05f);
+
+	/// <summary>
+	///		Reorders the vertices of a mesh in the order the indices first reference them, so that vertex fetches are sequential.
+	///		Vertices not referenced by any index are removed.
+	/// </summary>
+	/// <param name="mesh">Mesh, modified in place</param>
+	/// <returns>New vertex count</returns>
+	size_t OptimizeVertexFetch(MeshData& mesh);
+
+	/// <summary>
+	///		Merges the vertices of a mesh whose data is bitwise identical, remapping the indices
+	/// </summary>
+	/// <param name="mesh">Mesh, modified in place</param>
+	/// <returns>New vertex count</returns>
+	size_t DeduplicateVertices(MeshData& mesh);
+
+	/// <summary>
+	///		Runs every optimization on a mesh, in order: vertex deduplication, vertex cache, overdraw and vertex fetch.
+	///		Meant to run at import time, before the mesh is uploaded. The triangles of each level of detail (see GenerateLODs) are
+	///		optimized separately, so it may run before or after the levels are generated; running it after optimizes every level.
+	/// </summary>
+	/// <param name="mesh">Mesh, modified in place</param>
+	/// <param name="positionIndex">Location binding of the position vertex element (at least three floats), used by the overdraw optimization</param>
+	/// <param name="cacheSize">Number of vertices in the cache</param>
+	void OptimizeMesh(MeshData& mesh, unsigned int positionIndex = 0, unsigned int cacheSize = 16);
+}
@@ -0,0 +1,357 @@
+#include "MeshSimplifier.hpp"
+#include "..\Utils\Utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	const unsigned int InvalidIndex = 0xFFFFFFFF;
+
+	// Symmetric 4x4 matrix of a sum of squared distances to planes, plus the total weight of the planes
+	struct Quadric
+	{
+		double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+		double b2 = 0.0, bc = 0.0, bd = 0.0;
+		double c2 = 0.0, cd = 0.0;
+		double d2 = 0.0;
+		double weight = 0.0;
+
+		void AddPlane(double a, double b, double c, double d, double w)
+		{
+			a2 += w * a * a; ab += w * a * b; ac += w * a * c; ad += w * a * d;
+			b2 += w * b * b; bc += w * b * c; bd += w * b * d;
+			c2 += w * c * c; cd += w * c * d;
+			d2 += w * d * d;
+			weight += w;
+		}
+
+		void Add(const Quadric& other)
+		{
+			a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+			b2 += other.b2; bc += other.bc; bd += other.bd;
+			c2 += other.c2; cd += other.cd;
+			d2 += other.d2;
+			weight += other.weight;
+		}
+
+		// Weighted mean of the squared distances from a point to the planes
+		double Evaluate(const float* p) const
+		{
+			const double x = p[0], y = p[1], z = p[2];
+			const double error = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+							   + b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+							   + c2 * z * z + 2.0 * cd * z
+							   + d2;
+			return weight > 0.0 ? std::fabs(error) / weight : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		double error;
+	};
+
+	struct PositionKey
+	{
+		unsigned int bits[3];
+
+		bool operator==(const PositionKey& other) const
+		{
+			return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+		}
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& key) const
+		{
+			return (key.bits[0] * 73856093u) ^ (key.bits[1] * 19349663u) ^ (key.bits[2] * 83492791u);
+		}
+	};
+
+	const float* GetPosition(const float* positions, size_t positionStride, unsigned int vertex)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + vertex * positionStride);
+	}
+
+	void Cross(const float* a, const float* b, const float* c, double* normal)
+	{
+		const double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		const double v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		normal[0] = u[1] * v[2] - u[2] * v[1];
+		normal[1] = u[2] * v[0] - u[0] * v[2];
+		normal[2] = u[0] * v[1] - u[1] * v[0];
+	}
+
+	// Gets the vertices that share the position of each vertex (the first one of them)
+	std::vector<unsigned int> WeldPositions(const float* positions, size_t positionStride, size_t vertexCount)
+	{
+		std::vector<unsigned int> weld(vertexCount);
+		std::unordered_map<PositionKey, unsigned int, PositionKeyHash> first;
+		first.reserve(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			const float* p = GetPosition(positions, positionStride, static_cast<unsigned int>(v));
+			PositionKey key;
+			for (int i = 0; i < 3; ++i)
+			{
+				const float value = p[i] + 0.0f; // Merges -0 and +0
+				memcpy(&key.bits[i], &value, sizeof(float));
+			}
+			weld[v] = first.emplace(key, static_cast<unsigned int>(v)).first->second;
+		}
+		return weld;
+	}
+}
+
+float Magma::SimplifyMesh(const unsigned int * indices, size_t indexCount, const float * positions, size_t positionStride, size_t vertexCount,
+						  size_t targetIndexCount, std::vector<unsigned int>& result)
+{
+	result.assign(indices, indices + indexCount);
+	if (indexCount % 3 != 0)
+	{
+		MAGMA_WARNING("Failed to simplify mesh, the index count isn't a multiple of three");
+		return 0.0f;
+	}
+	for (size_t i = 0; i < indexCount; ++i)
+		if (indices[i] >= vertexCount)
+		{
+			MAGMA_WARNING("Failed to simplify mesh, index " + std::to_string(i) + " is out of range");
+			return 0.0f;
+		}
+	if (indexCount <= targetIndexCount)
+		return 0.0f;
+
+	// Vertices with the same position are simplified together, as a single welded vertex
+	const std::vector<unsigned int> weld = WeldPositions(positions, positionStride, vertexCount);
+
+	// Attribute seams are locked
+	std::vector<bool> locked(vertexCount, false);
+	std::vector<unsigned int> users(vertexCount, InvalidIndex);
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		const unsigned int w = weld[indices[i]];
+		if (users[w] == InvalidIndex)
+			users[w] = indices[i];
+		else if (users[w] != indices[i])
+			locked[w] = true;
+	}
+
+	// Borders and non-manifold edges are locked, found by counting the triangles using each welded edge
+	{
+		std::unordered_map<unsigned long long, unsigned int> edgeTriangles;
+		edgeTriangles.reserve(indexCount);
+		for (size_t t = 0; t < indexCount; t += 3)
+			for (int e = 0; e < 3; ++e)
+			{
+				unsigned long long a = weld[indices[t + e]], b = weld[indices[t + (e + 1) % 3]];
+				if (a == b)
+					continue;
+				if (a > b)
+					std::swap(a, b);
+				++edgeTriangles[(a << 32) | b];
+			}
+		for (auto& edge : edgeTriangles)
+			if (edge.second != 2)
+			{
+				locked[static_cast<size_t>(edge.first >> 32)] = true;
+				locked[static_cast<size_t>(edge.first & 0xFFFFFFFF)] = true;
+			}
+	}
+
+	// Error quadrics of the welded vertices, from the planes of their triangles weighted by area
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t t = 0; t < indexCount; t += 3)
+	{
+		const unsigned int a = weld[indices[t]], b = weld[indices[t + 1]], c = weld[indices[t + 2]];
+		const float* pa = GetPosition(positions, positionStride, a);
+		double normal[3];
+		Cross(pa, GetPosition(positions, positionStride, b), GetPosition(positions, positionStride, c), normal);
+		const double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length <= 0.0)
+			continue;
+		for (int i = 0; i < 3; ++i)
+			normal[i] /= length;
+		const double d = -(normal[0] * pa[0] + normal[1] * pa[1] + normal[2] * pa[2]);
+
+		Quadric plane;
+		plane.AddPlane(normal[0], normal[1], normal[2], d, 0.5 * length);
+		quadrics[a].Add(plane);
+		quadrics[b].Add(plane);
+		quadrics[c].Add(plane);
+	}
+
+	double maxError = 0.0;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<unsigned int> triangleOffsets(vertexCount + 1);
+	std::vector<unsigned int> vertexTriangles;
+
+	// Collapses are done in passes of independent edges, cheapest first, until the target is reached or nothing collapses
+	while (result.size() > targetIndexCount)
+	{
+		const size_t triangleCount = result.size() / 3;
+
+		// Triangles around each welded vertex
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (size_t i = 0; i < result.size(); ++i)
+			++triangleOffsets[weld[result[i]] + 1];
+		for (size_t v = 0; v < vertexCount; ++v)
+			triangleOffsets[v + 1] += triangleOffsets[v];
+		vertexTriangles.resize(result.size());
+		{
+			std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (size_t i = 0; i < result.size(); ++i)
+				vertexTriangles[fill[weld[result[i]]]++] = static_cast<unsigned int>(i / 3);
+		}
+
+		// Candidate collapses, moving an unlocked vertex onto the other end of one of its edges
+		collapses.clear();
+		for (size_t t = 0; t < triangleCount; ++t)
+			for (int e = 0; e < 3; ++e)
+			{
+				const unsigned int from = result[t * 3 + e], to = result[t * 3 + (e + 1) % 3];
+				const unsigned int a = weld[from], b = weld[to];
+				if (a == b)
+					continue;
+
+				Quadric quadric = quadrics[a];
+				quadric.Add(quadrics[b]);
+				if (!locked[a])
+					collapses.push_back({ from, to, quadric.Evaluate(GetPosition(positions, positionStride, b)) });
+				if (!locked[b])
+					collapses.push_back({ to, from, quadric.Evaluate(GetPosition(positions, positionStride, a)) });
+			}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.error < rhs.error; });
+
+		for (size_t v = 0; v < vertexCount; ++v)
+			remap[v] = static_cast<unsigned int>(v);
+		std::fill(touched.begin(), touched.end(), false);
+
+		// Each collapse removes about two triangles
+		const size_t maxCollapses = (result.size() - targetIndexCount) / 6 + 1;
+		size_t collapseCount = 0;
+		for (auto& collapse : collapses)
+		{
+			if (collapseCount >= maxCollapses)
+				break;
+
+			const unsigned int a = weld[collapse.from], b = weld[collapse.to];
+			if (touched[a] || touched[b])
+				continue;
+
+			// Rejects collapses which flip the triangles around the moved vertex
+			const float* target = GetPosition(positions, positionStride, b);
+			bool flips = false;
+			for (unsigned int i = triangleOffsets[a]; i < triangleOffsets[a + 1] && !flips; ++i)
+			{
+				const unsigned int* triangle = &result[vertexTriangles[i] * 3];
+				const float* p[3];
+				const float* moved[3];
+				bool degenerate = false;
+				for (int k = 0; k < 3; ++k)
+				{
+					const unsigned int w = weld[triangle[k]];
+					degenerate = degenerate || w == b;
+					p[k] = GetPosition(positions, positionStride, w);
+					moved[k] = w == a ? target : p[k];
+				}
+				if (degenerate)
+					continue;
+
+				double before[3], after[3];
+				Cross(p[0], p[1], p[2], before);
+				Cross(moved[0], moved[1], moved[2], after);
+				// Large rotations are rejected too, as they fold the surface over a few passes
+				const double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+				const double lengths = std::sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+												 (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+				flips = dot <= 0.25 * lengths;
+			}
+			if (flips)
+				continue;
+
+			// The triangles around the moved vertex change, so its neighbours can't collapse in the same pass
+			for (unsigned int i = triangleOffsets[a]; i < triangleOffsets[a + 1]; ++i)
+				for (int k = 0; k < 3; ++k)
+					touched[weld[result[vertexTriangles[i] * 3 + k]]] = true;
+
+			remap[collapse.from] = collapse.to;
+			quadrics[b].Add(quadrics[a]);
+			maxError = std::max(maxError, collapse.error);
+			++collapseCount;
+		}
+		if (collapseCount == 0)
+			break;
+
+		// Applies the collapses, removing the triangles which became degenerate
+		size_t write = 0;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			const unsigned int v0 = remap[result[t * 3]], v1 = remap[result[t * 3 + 1]], v2 = remap[result[t * 3 + 2]];
+			if (weld[v0] == weld[v1] || weld[v1] == weld[v2] || weld[v2] == weld[v0])
+				continue;
+			result[write++] = v0;
+			result[write++] = v1;
+			result[write++] = v2;
+		}
+		result.resize(write);
+	}
+
+	return static_cast<float>(std::sqrt(maxError));
+}
+
+unsigned int Magma::GenerateLODs(MeshData & mesh, unsigned int lodCount, float ratio, unsigned int positionIndex)
+{
+	// Levels generated before are replaced, starting again from the most detailed one
+	if (!mesh.lods.empty())
+		mesh.indices.resize(mesh.lods[0].firstIndex + mesh.lods[0].indexCount);
+	mesh.lods.clear();
+	mesh.lods.emplace_back();
+	mesh.lods.back().indexCount = static_cast<unsigned int>(mesh.indices.size());
+
+	if (ratio <= 0.0f || ratio >= 1.0f)
+	{
+		MAGMA_WARNING("Failed to generate mesh LODs, the ratio must be between 0 and 1");
+		return 1;
+	}
+
+	const VertexElement* position = nullptr;
+	for (auto& element : mesh.elements)
+		if (element.index == positionIndex && element.type == VertexElementType::Float && element.size >= 3)
+			position = &element;
+	if (position == nullptr)
+	{
+		MAGMA_WARNING("Failed to generate mesh LODs, the mesh has no float position element with location " + std::to_string(positionIndex));
+		return 1;
+	}
+	const float* positions = reinterpret_cast<const float*>(mesh.vertices.data() + position->offset);
+
+	std::vector<unsigned int> source, simplified;
+	while (mesh.lods.size() < lodCount)
+	{
+		const MeshLOD previous = mesh.lods.back();
+		source.assign(mesh.indices.begin() + previous.firstIndex, mesh.indices.begin() + previous.firstIndex + previous.indexCount);
+
+		const size_t target = static_cast<size_t>(previous.indexCount / 3 * ratio) * 3;
+		const float error = SimplifyMesh(source.data(), source.size(), positions, mesh.vertexStride, mesh.GetVertexCount(), target, simplified);
+		if (simplified.empty() || simplified.size() > source.size() * 95 / 100)
+			break;
+
+		// Each level is simplified from the previous one, so the errors add up
+		MeshLOD lod;
+		lod.firstIndex = static_cast<unsigned int>(mesh.indices.size());
+		lod.indexCount = static_cast<unsigned int>(simplified.size());
+		lod.error = previous.error + error;
+		mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+		mesh.lods.push_back(lod);
+	}
+
+	return static_cast<unsigned int>(mesh.lods.size());
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Mesh.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace Magma
+{
+	/// <summary>
+	///		Simplifies a triangle list by quadric error edge collapses (Garland and Heckbert 1997).
+	///		Vertices are only collapsed onto other vertices, so the result indexes the same vertex buffer.
+	///		Vertices on mesh borders and attribute seams (vertices sharing a position) are never moved.
+	/// </summary>
+	/// <param name="indices">Triangle list indices</param>
+	/// <param name="indexCount">Number of indices</param>
+	/// <param name="positions">Vertex positions (three floats per vertex)</param>
+	/// <param name="positionStride">Number of bytes between the positions of successive vertices</param>
+	/// <param name="vertexCount">Number of vertices</param>
+	/// <param name="targetIndexCount">Number of indices to simplify down to (may not be reached if the mesh can't be simplified further)</param>
+	/// <param name="result">Out simplified triangle list indices</param>
+	/// <returns>Geometric error of the result, as a distance in the units of the positions</returns>
+	float SimplifyMesh(const unsigned int* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount,
+					   size_t targetIndexCount, std::vector<unsigned int>& result);
+
+	/// <summary>
+	///		Generates the levels of detail of a mesh at import time. Each level is simplified from the previous one and its indices
+	///		are appended to the mesh indices, the index ranges being stored in the mesh LODs. Stops early if a level can't be
+	///		simplified enough (by less than 5%). Levels generated before are replaced.
+	///		Run OptimizeMesh afterwards to optimize every level, it keeps the level index ranges.
+	/// </summary>
+	/// <param name="mesh">Mesh, whose indices are the most detailed level</param>
+	/// <param name="lodCount">Maximum number of levels, including the most detailed one</param>
+	/// <param name="ratio">Triangle count of each level relative to the previous one</param>
+	/// <param name="positionIndex">Location binding of the position vertex element (at least three floats)</param>
+	/// <returns>Number of levels generated, including the most detailed one</returns>
+	unsigned int GenerateLODs(MeshData& mesh, unsigned int lodCount, float ratio = 0.5f, unsigned int positionIndex = 0);
+}
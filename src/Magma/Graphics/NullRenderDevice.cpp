@@ -0,0 +1,1225 @@
+#include "NullRenderDevice.hpp"
+#include "PipelineCache.hpp"
+#include "..\Utils\Utils.hpp"
+
+#include <map>
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Magma;
+
+namespace
+{
+	// Splits GLSL code into identifiers, numbers and single punctuation characters, skipping comments and preprocessor lines
+	std::vector<std::string> Tokenize(const std::string& code)
+	{
+		std::vector<std::string> tokens;
+		size_t i = 0;
+		while (i < code.size())
+		{
+			const char c = code[i];
+			if (isspace(static_cast<unsigned char>(c)))
+				++i;
+			else if (code.compare(i, 2, "//") == 0 || c == '#')
+				i = code.find('\n', i) != std::string::npos ? code.find('\n', i) : code.size();
+			else if (code.compare(i, 2, "/*") == 0)
+				i = code.find("*/", i + 2) != std::string::npos ? code.find("*/", i + 2) + 2 : code.size();
+			else if (isalnum(static_cast<unsigned char>(c)) || c == '_')
+			{
+				const size_t start = i;
+				while (i < code.size() && (isalnum(static_cast<unsigned char>(code[i])) || code[i] == '_'))
+					++i;
+				tokens.push_back(code.substr(start, i - start));
+			}
+			else
+				tokens.push_back(std::string(1, code[i++]));
+		}
+		return tokens;
+	}
+
+	bool IsQualifier(const std::string& token)
+	{
+		return token == "lowp" || token == "mediump" || token == "highp" || token == "const";
+	}
+
+	// Reads "type name[N], name;" from a token, adding the names, returns the token after the ';'
+	size_t ReadDeclaration(const std::vector<std::string>& tokens, size_t i, std::vector<std::string>& names)
+	{
+		while (i < tokens.size() && IsQualifier(tokens[i]))
+			++i;
+		// Skip the type
+		++i;
+		while (i < tokens.size() && tokens[i] != ";" && tokens[i] != "}")
+		{
+			if (tokens[i] == "[")
+			{
+				while (i < tokens.size() && tokens[i] != "]")
+					++i;
+			}
+			else if (tokens[i] != "," && tokens[i] != "]")
+				names.push_back(tokens[i]);
+			++i;
+		}
+		return i < tokens.size() && tokens[i] == ";" ? i + 1 : i;
+	}
+
+	// Finds the names of the uniforms and uniform blocks declared by GLSL code
+	void FindUniforms(const std::string& code, std::vector<std::string>& uniforms, std::vector<std::string>& blocks)
+	{
+		const std::vector<std::string> tokens = Tokenize(code);
+		size_t i = 0;
+		while (i < tokens.size())
+		{
+			if (tokens[i++] != "uniform")
+				continue;
+
+			// Blocks: uniform Name { members } instance;
+			if (i + 1 < tokens.size() && tokens[i + 1] == "{")
+			{
+				blocks.push_back(tokens[i]);
+				i += 2;
+				while (i < tokens.size() && tokens[i] != "}")
+					i = ReadDeclaration(tokens, i, uniforms);
+			}
+			else
+				i = ReadDeclaration(tokens, i, uniforms);
+		}
+	}
+}
+
+namespace Magma
+{
+	class NullVertexShader : public VertexShader
+	{
+	public:
+		NullVertexShader(const char* _code) : code(_code != nullptr ? _code : "") {}
+
+		std::string code;
+	};
+
+	class NullPixelShader : public PixelShader
+	{
+	public:
+		NullPixelShader(const char* _code) : code(_code != nullptr ? _code : "") {}
+
+		std::string code;
+	};
+
+	class NullPipelineParam : public PipelineParam
+	{
+	public:
+		NullPipelineParam(NullRenderDevice::Stats* _stats) : stats(_stats) {}
+
+		virtual void SetAsInt(int value) override { this->Upload(sizeof(int)); }
+		virtual void SetAsFloat(float value) override { this->Upload(sizeof(float)); }
+		virtual void SetAsMat4(const float * value) override { this->Upload(16 * sizeof(float)); }
+		virtual void SetAsIntArray(int count, const int * values) override { this->Upload(count * sizeof(int)); }
+		virtual void SetAsFloatArray(int count, const float * values) override { this->Upload(count * sizeof(float)); }
+		virtual void SetAsMat4Array(int count, const float * values) override { this->Upload(count * 16 * sizeof(float)); }
+
+		void Upload(size_t size)
+		{
+			++stats->paramUploads;
+			stats->bytesUploaded += size;
+		}
+
+		NullRenderDevice::Stats* stats;
+	};
+
+	class NullPipeline : public Pipeline
+	{
+	public:
+		NullPipeline(NullRenderDevice::Stats* _stats, bool _createUnknownParams) : stats(_stats), createUnknownParams(_createUnknownParams) {}
+
+		// Declares the uniforms and uniform blocks of a shader
+		void Declare(const std::string& code)
+		{
+			std::vector<std::string> uniforms, blockNames;
+			FindUniforms(code, uniforms, blockNames);
+			for (auto& name : uniforms)
+				if (params.find(MakeParamID(name.c_str())) == params.end())
+					params.insert(std::make_pair(MakeParamID(name.c_str()), new NullPipelineParam(stats)));
+			for (auto& name : blockNames)
+				blocks.insert(MakeParamID(name.c_str()));
+		}
+
+		virtual ~NullPipeline() override
+		{
+			for (auto& p : params)
+				delete p.second;
+		}
+
+		using Pipeline::GetParam;
+		virtual PipelineParam * GetParam(ParamID id) override
+		{
+			// Getting params waits for the pipeline to be built
+			ready = true;
+			auto it = params.find(id);
+			if (it != params.end())
+				return it->second;
+			if (!createUnknownParams)
+			{
+				MAGMA_WARNING("Failed to get param from pipeline, no param with this ID");
+				return nullptr;
+			}
+			return params.insert(std::make_pair(id, new NullPipelineParam(stats))).first->second;
+		}
+
+		using Pipeline::SetUniformBuffer;
+		virtual void SetUniformBuffer(ParamID id, UniformBuffer * uniformBuffer, long long offset) override
+		{
+			ready = true;
+			if (offset < 0)
+			{
+				MAGMA_WARNING("Failed to set pipeline uniform buffer, the offset is negative");
+				return;
+			}
+			if (!createUnknownParams && blocks.find(id) == blocks.end())
+			{
+				MAGMA_WARNING("Failed to set pipeline uniform buffer, no uniform block with this ID");
+				return;
+			}
+			if (uniformBuffer == nullptr)
+				uniformBuffers.erase(id);
+			else
+				uniformBuffers[id] = uniformBuffer;
+		}
+
+		NullRenderDevice::Stats* stats;
+		// Params and uniform blocks declared by the shaders
+		std::map<ParamID, NullPipelineParam*> params;
+		std::set<ParamID> blocks;
+		// Accept any param, for shaders whose sources are placeholders
+		bool createUnknownParams;
+		// Uniform buffers the blocks are sourced from
+		std::map<ParamID, UniformBuffer*> uniformBuffers;
+		bool ready = false;
+	};
+
+	// Buffer state shared by vertex and index buffers, memory is only allocated once the buffer is mapped
+	class NullBuffer
+	{
+	public:
+		NullBuffer(long long _size, BufferUsage _usage) : size(_size), usage(_usage) {}
+
+		bool CheckRange(long long offset, long long rangeSize, const char* action)
+		{
+			if (offset < 0 || rangeSize < 0 || offset + rangeSize > size)
+			{
+				MAGMA_WARNING(std::string("Failed to ") + action + " buffer, the range is out of bounds");
+				return false;
+			}
+			if (mapped)
+			{
+				MAGMA_WARNING(std::string("Failed to ") + action + " buffer, it is mapped");
+				return false;
+			}
+			return true;
+		}
+
+		void Update(long long offset, long long updateSize, NullRenderDevice::Stats& stats)
+		{
+			if (this->CheckRange(offset, updateSize, "update"))
+				stats.bytesUploaded += updateSize;
+		}
+
+		void* Map(long long offset, long long mapSize)
+		{
+			if (!this->CheckRange(offset, mapSize, "map"))
+				return nullptr;
+			memory.resize(static_cast<size_t>(size));
+			mapped = true;
+			mappedSize = mapSize;
+			return memory.data() + offset;
+		}
+
+		void Unmap(NullRenderDevice::Stats& stats)
+		{
+			if (!mapped)
+			{
+				MAGMA_WARNING("Failed to unmap buffer, it isn't mapped");
+				return;
+			}
+			mapped = false;
+			stats.bytesUploaded += mappedSize;
+		}
+
+		long long Advance()
+		{
+			if (usage != BufferUsage::Stream)
+				return 0;
+			if (mapped)
+				MAGMA_WARNING("Advancing a buffer while it is mapped");
+			region = (region + 1) % 3;
+			return region * size;
+		}
+
+		long long size;
+		BufferUsage usage;
+		unsigned int region = 0;
+		std::vector<unsigned char> memory;
+		bool mapped = false;
+		long long mappedSize = 0;
+	};
+
+	class NullVertexBuffer : public VertexBuffer
+	{
+	public:
+		NullVertexBuffer(long long size, BufferUsage usage) : storage(size, usage) {}
+
+		NullBuffer storage;
+	};
+
+	class NullVertexDescription : public VertexDescription
+	{
+	public:
+		NullVertexDescription(unsigned int numVertexElements, const VertexElement* vertexElements)
+			: elements(vertexElements, vertexElements + numVertexElements) {}
+
+		std::vector<VertexElement> elements;
+	};
+
+	class NullVertexArray : public VertexArray
+	{
+	};
+
+	class NullIndexBuffer : public IndexBuffer
+	{
+	public:
+		NullIndexBuffer(long long size, BufferUsage usage, IndexFormat _format) : storage(size, usage), format(_format) {}
+
+		NullBuffer storage;
+		IndexFormat format;
+	};
+
+	class NullIndirectBuffer : public IndirectBuffer
+	{
+	public:
+		NullIndirectBuffer(long long size, const void* data)
+			: data(static_cast<size_t>(size))
+		{
+			if (data != nullptr)
+				memcpy(this->data.data(), data, static_cast<size_t>(size));
+		}
+
+		std::vector<unsigned char> data;
+		bool mapped = false;
+	};
+
+	class NullUniformBuffer : public UniformBuffer
+	{
+	public:
+		NullUniformBuffer(long long size) : storage(size, BufferUsage::Dynamic) {}
+
+		NullBuffer storage;
+	};
+
+	class NullTexture2D : public Texture2D
+	{
+	public:
+		NullTexture2D(const Texture2DDesc& _desc) : desc(_desc)
+		{
+			desc.data = nullptr;
+			if (desc.mipLevels <= 0)
+				desc.mipLevels = RenderDevice::GetFullMipLevels(desc.width, desc.height);
+		}
+
+		Texture2DDesc desc;
+	};
+
+	class NullSampler : public Sampler
+	{
+	public:
+		NullSampler(const SamplerDesc& _desc) : desc(_desc) {}
+
+		SamplerDesc desc;
+	};
+
+	class NullRasterState : public RasterState
+	{
+	};
+
+	class NullDepthStencilState : public DepthStencilState
+	{
+	};
+
+	class NullBlendState : public BlendState
+	{
+	};
+
+	class NullPipelineState : public PipelineState
+	{
+	public:
+		NullPipelineState(const PipelineStateDesc& _desc) : desc(_desc) {}
+
+		PipelineStateDesc desc;
+	};
+
+	class NullRenderTarget : public RenderTarget
+	{
+	public:
+		NullRenderTarget(const RenderTargetDesc& _desc) : desc(_desc) {}
+
+		RenderTargetDesc desc;
+	};
+}
+
+Magma::NullRenderDevice::NullRenderDevice()
+{
+
+}
+
+Magma::NullRenderDevice::~NullRenderDevice()
+{
+	if (!m_liveResources.empty())
+		MAGMA_WARNING("Null render device destroyed with " + std::to_string(m_liveResources.size()) + " resources still alive");
+}
+
+template <typename T>
+T * Magma::NullRenderDevice::Track(T * resource)
+{
+	m_liveResources.insert(resource);
+	return resource;
+}
+
+bool Magma::NullRenderDevice::Untrack(const void * resource, const char * type)
+{
+	if (resource == nullptr)
+		return false;
+	if (m_liveResources.erase(resource) == 0)
+	{
+		MAGMA_WARNING(std::string("Failed to destroy ") + type + ", it isn't alive (destroyed twice or created by another device)");
+		return false;
+	}
+	return true;
+}
+
+template <typename T>
+bool Magma::NullRenderDevice::Change(T *& current, T * value)
+{
+	if (value != nullptr && !this->IsAlive(value))
+	{
+		MAGMA_WARNING("Failed to bind resource, it isn't alive");
+		return false;
+	}
+
+	if (current == value)
+	{
+		++m_stats.redundantStateChanges;
+		return false;
+	}
+	current = value;
+	++m_stats.stateChanges;
+	return true;
+}
+
+const void * Magma::NullRenderDevice::ValidateIndirectDraw(IndirectBuffer * indirectBuffer, long long offset, int drawCount, size_t commandSize)
+{
+	if (!this->IsAlive(indirectBuffer))
+	{
+		MAGMA_WARNING("Failed to draw indirect, the indirect buffer isn't alive");
+		return nullptr;
+	}
+
+	NullIndirectBuffer* buffer = static_cast<NullIndirectBuffer*>(indirectBuffer);
+	if (buffer->mapped)
+	{
+		MAGMA_WARNING("Failed to draw indirect, the indirect buffer is mapped");
+		return nullptr;
+	}
+	if (offset < 0 || drawCount < 0 || static_cast<size_t>(offset) + drawCount * commandSize > buffer->data.size())
+	{
+		MAGMA_WARNING("Failed to draw indirect, the commands are out of the indirect buffer bounds");
+		return nullptr;
+	}
+	return buffer->data.data() + offset;
+}
+
+bool Magma::NullRenderDevice::ValidateDraw(bool indexed)
+{
+	if (m_pipeline == nullptr)
+	{
+		MAGMA_WARNING("Failed to draw, no pipeline is set");
+		return false;
+	}
+	if (!static_cast<NullPipeline*>(m_pipeline)->ready)
+	{
+		++m_stats.skippedDraws;
+		return false;
+	}
+	if (m_vertexArray == nullptr)
+	{
+		MAGMA_WARNING("Failed to draw, no vertex array is set");
+		return false;
+	}
+	if (indexed && m_indexBuffer == nullptr)
+	{
+		MAGMA_WARNING("Failed to draw indexed, no index buffer is set");
+		return false;
+	}
+	return true;
+}
+
+bool Magma::NullRenderDevice::ValidateIndexRange(long long offset, int count, bool indices32)
+{
+	const NullIndexBuffer* indexBuffer = static_cast<const NullIndexBuffer*>(m_indexBuffer);
+	if (indices32 && indexBuffer->format != IndexFormat::UInt32)
+	{
+		MAGMA_WARNING("Failed to draw indexed, 32 bit indices are read from an index buffer with 16 bit indices");
+		return false;
+	}
+
+	const long long indexSize = indexBuffer->format == IndexFormat::UInt16 ? 2 : 4;
+	if (offset < 0 || count < 0 || offset % indexSize != 0 || offset + count * indexSize > indexBuffer->storage.size)
+	{
+		MAGMA_WARNING("Failed to draw indexed, the index range is misaligned or out of the index buffer bounds");
+		return false;
+	}
+	return true;
+}
+
+VertexShader * Magma::NullRenderDevice::CreateVertexShader(const char * code)
+{
+	return this->Track(new NullVertexShader(code));
+}
+
+void Magma::NullRenderDevice::DestroyVertexShader(VertexShader * vertexShader)
+{
+	if (this->Untrack(vertexShader, "vertex shader"))
+		delete vertexShader;
+}
+
+PixelShader * Magma::NullRenderDevice::CreatePixelShader(const char * code)
+{
+	return this->Track(new NullPixelShader(code));
+}
+
+void Magma::NullRenderDevice::DestroyPixelShader(PixelShader * pixelShader)
+{
+	if (this->Untrack(pixelShader, "pixel shader"))
+		delete pixelShader;
+}
+
+Pipeline * Magma::NullRenderDevice::CreatePipeline(VertexShader * vertexShader, PixelShader * pixelShader)
+{
+	NullPipeline* pipeline = new NullPipeline(&m_stats, m_createUnknownParams);
+	if (!this->IsAlive(vertexShader) || !this->IsAlive(pixelShader))
+	{
+		MAGMA_WARNING("Creating pipeline from shaders that aren't alive");
+		pipeline->ready = true;
+		return this->Track(pipeline);
+	}
+
+	// Stand in for a program binary, the concatenated sources
+	const std::string& vertexCode = static_cast<NullVertexShader*>(vertexShader)->code;
+	const std::string& pixelCode = static_cast<NullPixelShader*>(pixelShader)->code;
+	pipeline->Declare(vertexCode);
+	pipeline->Declare(pixelCode);
+	if (m_pipelineCache != nullptr)
+	{
+		const unsigned long long key = PipelineCache::MakeKey(vertexCode.c_str(), pixelCode.c_str(), "Null");
+		std::vector<unsigned char> binary;
+		if (m_pipelineCache->Load(key, binary))
+		{
+			// Cached pipelines are ready right away
+			pipeline->ready = true;
+			return this->Track(pipeline);
+		}
+
+		const std::string sources = vertexCode + pixelCode;
+		m_pipelineCache->Store(key, sources.data(), sources.size() + 1);
+	}
+
+	// Built pipelines are ready on the next EndFrame
+	++m_stats.pipelineCompiles;
+	m_pendingPipelines.insert(pipeline);
+	return this->Track(pipeline);
+}
+
+bool Magma::NullRenderDevice::IsPipelineReady(Pipeline * pipeline)
+{
+	return this->IsAlive(pipeline) && static_cast<NullPipeline*>(pipeline)->ready;
+}
+
+void Magma::NullRenderDevice::DestroyPipeline(Pipeline * pipeline)
+{
+	m_pendingPipelines.erase(pipeline);
+	if (m_pipeline == pipeline)
+		m_pipeline = nullptr;
+	if (this->Untrack(pipeline, "pipeline"))
+		delete pipeline;
+}
+
+void Magma::NullRenderDevice::SetPipelineCache(PipelineCache * pipelineCache)
+{
+	m_pipelineCache = pipelineCache;
+}
+
+void Magma::NullRenderDevice::SetPipeline(Pipeline * pipeline)
+{
+	if (this->Change(m_pipeline, pipeline))
+		m_pipelineState = nullptr;
+}
+
+VertexBuffer * Magma::NullRenderDevice::CreateVertexBuffer(long long size, const void * data, BufferUsage usage)
+{
+	if (data != nullptr)
+		m_stats.bytesUploaded += size;
+	return this->Track(new NullVertexBuffer(size, usage));
+}
+
+VertexBuffer * Magma::NullRenderDevice::CreateVertexBufferAsync(long long size, const void * data, BufferUsage usage)
+{
+	VertexBuffer* vertexBuffer = this->CreateVertexBuffer(size, data, usage);
+	m_pendingUploads.insert(vertexBuffer);
+	return vertexBuffer;
+}
+
+bool Magma::NullRenderDevice::IsVertexBufferReady(VertexBuffer * vertexBuffer)
+{
+	return m_pendingUploads.find(vertexBuffer) == m_pendingUploads.end();
+}
+
+void Magma::NullRenderDevice::DestroyVertexBuffer(VertexBuffer * vertexBuffer)
+{
+	m_pendingUploads.erase(vertexBuffer);
+	if (this->Untrack(vertexBuffer, "vertex buffer"))
+		delete vertexBuffer;
+}
+
+void Magma::NullRenderDevice::UpdateVertexBuffer(VertexBuffer * vertexBuffer, long long offset, long long size, const void * data)
+{
+	if (!this->IsAlive(vertexBuffer))
+	{
+		MAGMA_WARNING("Failed to update vertex buffer, it isn't alive");
+		return;
+	}
+	static_cast<NullVertexBuffer*>(vertexBuffer)->storage.Update(offset, size, m_stats);
+}
+
+void * Magma::NullRenderDevice::MapVertexBuffer(VertexBuffer * vertexBuffer, long long offset, long long size)
+{
+	if (!this->IsAlive(vertexBuffer))
+	{
+		MAGMA_WARNING("Failed to map vertex buffer, it isn't alive");
+		return nullptr;
+	}
+	return static_cast<NullVertexBuffer*>(vertexBuffer)->storage.Map(offset, size);
+}
+
+void Magma::NullRenderDevice::UnmapVertexBuffer(VertexBuffer * vertexBuffer)
+{
+	if (!this->IsAlive(vertexBuffer))
+	{
+		MAGMA_WARNING("Failed to unmap vertex buffer, it isn't alive");
+		return;
+	}
+	static_cast<NullVertexBuffer*>(vertexBuffer)->storage.Unmap(m_stats);
+}
+
+long long Magma::NullRenderDevice::AdvanceVertexBuffer(VertexBuffer * vertexBuffer)
+{
+	if (!this->IsAlive(vertexBuffer))
+	{
+		MAGMA_WARNING("Failed to advance vertex buffer, it isn't alive");
+		return 0;
+	}
+	return static_cast<NullVertexBuffer*>(vertexBuffer)->storage.Advance();
+}
+
+VertexDescription * Magma::NullRenderDevice::CreateVertexDescription(unsigned int numVertexElements, const VertexElement * vertexElements)
+{
+	for (unsigned int i = 0; i < numVertexElements; ++i)
+		if (vertexElements[i].type == VertexElementType::Int1010102Normalize && vertexElements[i].size != 4)
+			MAGMA_WARNING("Packed 10-10-10-2 vertex element " + std::to_string(vertexElements[i].index) + " must have 4 components");
+	return this->Track(new NullVertexDescription(numVertexElements, vertexElements));
+}
+
+void Magma::NullRenderDevice::DestroyVertexDescription(VertexDescription * vertexDescription)
+{
+	if (this->Untrack(vertexDescription, "vertex description"))
+		delete vertexDescription;
+}
+
+VertexArray * Magma::NullRenderDevice::CreateVertexArray(unsigned int numVertexBuffers, VertexBuffer ** vertexBuffers, VertexDescription ** vertexDescriptions)
+{
+	for (unsigned int i = 0; i < numVertexBuffers; ++i)
+		if (!this->IsAlive(vertexBuffers[i]) || !this->IsAlive(vertexDescriptions[i]))
+			MAGMA_WARNING("Creating vertex array from vertex buffers or descriptions that aren't alive");
+	return this->Track(new NullVertexArray());
+}
+
+void Magma::NullRenderDevice::DestroyVertexArray(VertexArray * vertexArray)
+{
+	if (m_vertexArray == vertexArray)
+		m_vertexArray = nullptr;
+	if (this->Untrack(vertexArray, "vertex array"))
+		delete vertexArray;
+}
+
+void Magma::NullRenderDevice::SetVertexArray(VertexArray * vertexArray)
+{
+	this->Change(m_vertexArray, vertexArray);
+}
+
+IndexBuffer * Magma::NullRenderDevice::CreateIndexBuffer(long long size, const void * data, BufferUsage usage, IndexFormat format)
+{
+	if (data != nullptr)
+		m_stats.bytesUploaded += size;
+	return this->Track(new NullIndexBuffer(size, usage, format));
+}
+
+void Magma::NullRenderDevice::DestroyIndexBuffer(IndexBuffer * indexBuffer)
+{
+	if (m_indexBuffer == indexBuffer)
+		m_indexBuffer = nullptr;
+	if (this->Untrack(indexBuffer, "index buffer"))
+		delete indexBuffer;
+}
+
+void Magma::NullRenderDevice::UpdateIndexBuffer(IndexBuffer * indexBuffer, long long offset, long long size, const void * data)
+{
+	if (!this->IsAlive(indexBuffer))
+	{
+		MAGMA_WARNING("Failed to update index buffer, it isn't alive");
+		return;
+	}
+	static_cast<NullIndexBuffer*>(indexBuffer)->storage.Update(offset, size, m_stats);
+}
+
+void * Magma::NullRenderDevice::MapIndexBuffer(IndexBuffer * indexBuffer, long long offset, long long size)
+{
+	if (!this->IsAlive(indexBuffer))
+	{
+		MAGMA_WARNING("Failed to map index buffer, it isn't alive");
+		return nullptr;
+	}
+	return static_cast<NullIndexBuffer*>(indexBuffer)->storage.Map(offset, size);
+}
+
+void Magma::NullRenderDevice::UnmapIndexBuffer(IndexBuffer * indexBuffer)
+{
+	if (!this->IsAlive(indexBuffer))
+	{
+		MAGMA_WARNING("Failed to unmap index buffer, it isn't alive");
+		return;
+	}
+	static_cast<NullIndexBuffer*>(indexBuffer)->storage.Unmap(m_stats);
+}
+
+long long Magma::NullRenderDevice::AdvanceIndexBuffer(IndexBuffer * indexBuffer)
+{
+	if (!this->IsAlive(indexBuffer))
+	{
+		MAGMA_WARNING("Failed to advance index buffer, it isn't alive");
+		return 0;
+	}
+	return static_cast<NullIndexBuffer*>(indexBuffer)->storage.Advance();
+}
+
+void Magma::NullRenderDevice::SetIndexBuffer(IndexBuffer * indexBuffer)
+{
+	this->Change(m_indexBuffer, indexBuffer);
+}
+
+IndirectBuffer * Magma::NullRenderDevice::CreateIndirectBuffer(long long size, const void * data)
+{
+	if (data != nullptr)
+		m_stats.bytesUploaded += size;
+	return this->Track(new NullIndirectBuffer(size, data));
+}
+
+void Magma::NullRenderDevice::DestroyIndirectBuffer(IndirectBuffer * indirectBuffer)
+{
+	if (this->Untrack(indirectBuffer, "indirect buffer"))
+		delete indirectBuffer;
+}
+
+void * Magma::NullRenderDevice::MapIndirectBuffer(IndirectBuffer * indirectBuffer)
+{
+	if (!this->IsAlive(indirectBuffer))
+	{
+		MAGMA_WARNING("Failed to map indirect buffer, it isn't alive");
+		return nullptr;
+	}
+
+	NullIndirectBuffer* buffer = static_cast<NullIndirectBuffer*>(indirectBuffer);
+	if (buffer->mapped)
+	{
+		MAGMA_WARNING("Failed to map indirect buffer, it is already mapped");
+		return nullptr;
+	}
+	buffer->mapped = true;
+	return buffer->data.data();
+}
+
+void Magma::NullRenderDevice::UnmapIndirectBuffer(IndirectBuffer * indirectBuffer)
+{
+	if (!this->IsAlive(indirectBuffer))
+	{
+		MAGMA_WARNING("Failed to unmap indirect buffer, it isn't alive");
+		return;
+	}
+
+	NullIndirectBuffer* buffer = static_cast<NullIndirectBuffer*>(indirectBuffer);
+	if (!buffer->mapped)
+		MAGMA_WARNING("Failed to unmap indirect buffer, it isn't mapped");
+	else
+		m_stats.bytesUploaded += buffer->data.size();
+	buffer->mapped = false;
+}
+
+UniformBuffer * Magma::NullRenderDevice::CreateUniformBuffer(long long size, const void * data)
+{
+	if (data != nullptr)
+		m_stats.bytesUploaded += size;
+	return this->Track(new NullUniformBuffer(size));
+}
+
+void Magma::NullRenderDevice::DestroyUniformBuffer(UniformBuffer * uniformBuffer)
+{
+	if (this->Untrack(uniformBuffer, "uniform buffer"))
+		delete uniformBuffer;
+}
+
+void Magma::NullRenderDevice::UpdateUniformBuffer(UniformBuffer * uniformBuffer, long long offset, long long size, const void * data)
+{
+	if (!this->IsAlive(uniformBuffer))
+	{
+		MAGMA_WARNING("Failed to update uniform buffer, it isn't alive");
+		return;
+	}
+	static_cast<NullUniformBuffer*>(uniformBuffer)->storage.Update(offset, size, m_stats);
+}
+
+Texture2D * Magma::NullRenderDevice::CreateTexture2D(const Texture2DDesc & desc)
+{
+	NullTexture2D* texture = new NullTexture2D(desc);
+	const int levels = texture->desc.mipLevels;
+	const int layers = desc.arrayLayers > 1 ? desc.arrayLayers : 1;
+
+	if (desc.generateMips && desc.format >= TextureFormat::BC1)
+		MAGMA_WARNING("Failed to generate texture mips, the texture format is compressed");
+
+	// Count the data a real device would upload
+	if (desc.data != nullptr)
+		for (int layer = 0; layer < layers; ++layer)
+			for (int level = 0; level < (desc.generateMips ? 1 : levels); ++level)
+				if (desc.data[layer * levels + level] != nullptr)
+				{
+					const int width = desc.width >> level > 0 ? desc.width >> level : 1;
+					const int height = desc.height >> level > 0 ? desc.height >> level : 1;
+					m_stats.bytesUploaded += GetImageSize(desc.format, width, height);
+				}
+
+	return this->Track(texture);
+}
+
+Texture2D * Magma::NullRenderDevice::CreateTexture2DAsync(const Texture2DDesc & desc)
+{
+	Texture2D* texture = this->CreateTexture2D(desc);
+	m_pendingUploads.insert(texture);
+	return texture;
+}
+
+bool Magma::NullRenderDevice::IsTexture2DReady(Texture2D * texture2D)
+{
+	return m_pendingUploads.find(texture2D) == m_pendingUploads.end();
+}
+
+void Magma::NullRenderDevice::DestroyTexture2D(Texture2D * texture2D)
+{
+	m_pendingUploads.erase(texture2D);
+	for (auto& t : m_textures)
+		if (t == texture2D)
+			t = nullptr;
+	if (this->Untrack(texture2D, "2D texture"))
+		delete texture2D;
+}
+
+void Magma::NullRenderDevice::SetTexture2D(unsigned int slot, Texture2D * texture2D)
+{
+	if (slot >= MaxTextureSlots)
+	{
+		MAGMA_WARNING("Failed to set 2D texture, slot " + std::to_string(slot) + " is out of range");
+		return;
+	}
+	this->Change(m_textures[slot], texture2D);
+}
+
+void Magma::NullRenderDevice::UpdateTexture2D(Texture2D * texture2D, int layer, int level, const void * data, bool generateMips)
+{
+	if (!this->IsAlive(texture2D))
+	{
+		MAGMA_WARNING("Failed to update 2D texture, it isn't alive");
+		return;
+	}
+
+	const Texture2DDesc& desc = static_cast<NullTexture2D*>(texture2D)->desc;
+	const int layers = desc.arrayLayers > 1 ? desc.arrayLayers : 1;
+	if (layer < 0 || layer >= layers || level < 0 || level >= desc.mipLevels)
+	{
+		MAGMA_WARNING("Failed to update 2D texture, layer " + std::to_string(layer) + " level " + std::to_string(level) + " is out of range");
+		return;
+	}
+	if (generateMips && desc.format >= TextureFormat::BC1)
+		MAGMA_WARNING("Failed to generate texture mips, the texture format is compressed");
+
+	const int width = desc.width >> level > 0 ? desc.width >> level : 1;
+	const int height = desc.height >> level > 0 ? desc.height >> level : 1;
+	m_stats.bytesUploaded += GetImageSize(desc.format, width, height);
+}
+
+unsigned long long Magma::NullRenderDevice::GetTexture2DHandle(Texture2D * texture2D, Sampler * sampler)
+{
+	// Bindless textures aren't supported
+	return 0;
+}
+
+Sampler * Magma::NullRenderDevice::CreateSampler(const SamplerDesc & desc)
+{
+	return this->Track(new NullSampler(desc));
+}
+
+void Magma::NullRenderDevice::DestroySampler(Sampler * sampler)
+{
+	for (auto& s : m_samplers)
+		if (s == sampler)
+			s = nullptr;
+	if (this->Untrack(sampler, "sampler"))
+		delete sampler;
+}
+
+void Magma::NullRenderDevice::SetSampler(unsigned int slot, Sampler * sampler)
+{
+	if (slot >= MaxTextureSlots)
+	{
+		MAGMA_WARNING("Failed to set sampler, slot " + std::to_string(slot) + " is out of range");
+		return;
+	}
+	this->Change(m_samplers[slot], sampler);
+}
+
+RasterState * Magma::NullRenderDevice::CreateRasterState(bool cullEnabled, Winding frontFace, Face cullFace, RasterMode rasterMode)
+{
+	return this->Track(new NullRasterState());
+}
+
+void Magma::NullRenderDevice::DestroyRasterState(RasterState * rasterState)
+{
+	if (m_rasterState == rasterState)
+		m_rasterState = nullptr;
+	if (this->Untrack(rasterState, "raster state"))
+		delete rasterState;
+}
+
+void Magma::NullRenderDevice::SetRasterState(RasterState * rasterState)
+{
+	if (this->Change(m_rasterState, rasterState))
+		m_pipelineState = nullptr;
+}
+
+DepthStencilState * Magma::NullRenderDevice::CreateDepthStencilState(bool depthEnabled, bool depthWriteEnabled, float depthNear, float depthFar, Compare depthCompare, bool frontFaceStencilEnabled, Compare frontFaceStencilCompare, StencilAction frontFaceStencilFail, StencilAction frontFaceStencilPass, StencilAction frontFaceDepthFail, int frontFaceRef, unsigned int frontFaceReadMask, unsigned int frontFaceWriteMask, bool backFaceStencilEnabled, Compare backFaceStencilCompare, StencilAction backFaceStencilFail, StencilAction backFaceStencilPass, StencilAction backFaceDepthFail, int backFaceRef, unsigned int backFaceReadMask, unsigned int backFaceWriteMask)
+{
+	return this->Track(new NullDepthStencilState());
+}
+
+void Magma::NullRenderDevice::DestroyDepthStencilState(DepthStencilState * depthStencilState)
+{
+	if (m_depthStencilState == depthStencilState)
+		m_depthStencilState = nullptr;
+	if (this->Untrack(depthStencilState, "depth/stencil state"))
+		delete depthStencilState;
+}
+
+void Magma::NullRenderDevice::SetDepthStencilState(DepthStencilState * depthStencilState)
+{
+	if (this->Change(m_depthStencilState, depthStencilState))
+		m_pipelineState = nullptr;
+}
+
+BlendState * Magma::NullRenderDevice::CreateBlendState(bool blendEnabled, BlendFactor srcColor, BlendFactor dstColor, BlendOp colorOp, BlendFactor srcAlpha, BlendFactor dstAlpha, BlendOp alphaOp, unsigned int colorWriteMask)
+{
+	return this->Track(new NullBlendState());
+}
+
+void Magma::NullRenderDevice::DestroyBlendState(BlendState * blendState)
+{
+	if (m_blendState == blendState)
+		m_blendState = nullptr;
+	if (this->Untrack(blendState, "blend state"))
+		delete blendState;
+}
+
+void Magma::NullRenderDevice::SetBlendState(BlendState * blendState)
+{
+	if (this->Change(m_blendState, blendState))
+		m_pipelineState = nullptr;
+}
+
+PipelineState * Magma::NullRenderDevice::CreatePipelineState(const PipelineStateDesc & desc)
+{
+	if (desc.pipeline == nullptr || !this->IsAlive(desc.pipeline))
+	{
+		MAGMA_WARNING("Failed to create pipeline state, the shader pipeline isn't alive");
+		return nullptr;
+	}
+	if ((desc.rasterState != nullptr && !this->IsAlive(desc.rasterState)) ||
+		(desc.depthStencilState != nullptr && !this->IsAlive(desc.depthStencilState)) ||
+		(desc.blendState != nullptr && !this->IsAlive(desc.blendState)))
+	{
+		MAGMA_WARNING("Failed to create pipeline state, one of its states isn't alive");
+		return nullptr;
+	}
+
+	return this->Track(new NullPipelineState(desc));
+}
+
+void Magma::NullRenderDevice::DestroyPipelineState(PipelineState * pipelineState)
+{
+	if (m_pipelineState == pipelineState)
+		m_pipelineState = nullptr;
+	if (this->Untrack(pipelineState, "pipeline state"))
+		delete pipelineState;
+}
+
+void Magma::NullRenderDevice::SetPipelineState(PipelineState * pipelineState)
+{
+	// Switching pipeline states counts as a single state change
+	if (pipelineState != nullptr && !this->IsAlive(pipelineState))
+	{
+		MAGMA_WARNING("Failed to set pipeline state, it isn't alive");
+		return;
+	}
+	if (pipelineState != nullptr && pipelineState == m_pipelineState)
+	{
+		++m_stats.redundantStateChanges;
+		return;
+	}
+
+	const PipelineStateDesc desc = pipelineState != nullptr ? static_cast<NullPipelineState*>(pipelineState)->desc : PipelineStateDesc();
+	if (desc.pipeline != nullptr && !this->IsAlive(desc.pipeline))
+		MAGMA_WARNING("Setting a pipeline state whose shader pipeline isn't alive, no pipeline is set");
+	m_pipeline = this->IsAlive(desc.pipeline) ? desc.pipeline : nullptr;
+	// The states are copied by real devices and may have been destroyed since, in which case they are reported as the default ones
+	m_rasterState = this->IsAlive(desc.rasterState) ? desc.rasterState : nullptr;
+	m_depthStencilState = this->IsAlive(desc.depthStencilState) ? desc.depthStencilState : nullptr;
+	m_blendState = this->IsAlive(desc.blendState) ? desc.blendState : nullptr;
+	m_pipelineState = pipelineState;
+	++m_stats.stateChanges;
+}
+
+RenderTarget * Magma::NullRenderDevice::CreateRenderTarget(const RenderTargetDesc & desc)
+{
+	if (desc.width <= 0 || desc.height <= 0 || desc.samples < 1 || desc.colorCount > RenderTargetDesc::MaxColorAttachments)
+	{
+		MAGMA_WARNING("Failed to create render target, invalid size, sample count or color attachment count");
+		return nullptr;
+	}
+
+	for (unsigned int i = 0; i < desc.colorCount; ++i)
+	{
+		if (!this->IsAlive(desc.colorTextures[i]))
+		{
+			MAGMA_WARNING("Failed to create render target, color texture " + std::to_string(i) + " isn't alive");
+			return nullptr;
+		}
+		const Texture2DDesc& texture = static_cast<NullTexture2D*>(desc.colorTextures[i])->desc;
+		if (texture.format >= TextureFormat::BC1 || IsDepthFormat(texture.format) || texture.width < desc.width || texture.height < desc.height)
+		{
+			MAGMA_WARNING("Failed to create render target, color texture " + std::to_string(i) + " is too small or has a compressed or depth format");
+			return nullptr;
+		}
+	}
+
+	if (desc.depthTexture != nullptr)
+	{
+		if (!this->IsAlive(desc.depthTexture))
+		{
+			MAGMA_WARNING("Failed to create render target, the depth texture isn't alive");
+			return nullptr;
+		}
+		const Texture2DDesc& texture = static_cast<NullTexture2D*>(desc.depthTexture)->desc;
+		if (!IsDepthFormat(texture.format) || texture.width < desc.width || texture.height < desc.height)
+		{
+			MAGMA_WARNING("Failed to create render target, the depth texture is too small or doesn't have a depth format");
+			return nullptr;
+		}
+	}
+	else if (desc.depthFormat != TextureFormat::Count && !IsDepthFormat(desc.depthFormat))
+	{
+		MAGMA_WARNING("Failed to create render target, the depth format isn't a depth format");
+		return nullptr;
+	}
+
+	return this->Track(new NullRenderTarget(desc));
+}
+
+void Magma::NullRenderDevice::DestroyRenderTarget(RenderTarget * renderTarget)
+{
+	if (m_renderTarget == renderTarget)
+		m_renderTarget = nullptr;
+	if (this->Untrack(renderTarget, "render target"))
+		delete renderTarget;
+}
+
+void Magma::NullRenderDevice::SetRenderTarget(RenderTarget * renderTarget)
+{
+	this->Change(m_renderTarget, renderTarget);
+}
+
+void Magma::NullRenderDevice::ResolveRenderTarget(RenderTarget * renderTarget)
+{
+	if (!this->IsAlive(renderTarget))
+		MAGMA_WARNING("Failed to resolve render target, it isn't alive");
+}
+
+void Magma::NullRenderDevice::SetViewport(int x, int y, int width, int height)
+{
+	if (width < 0 || height < 0)
+		MAGMA_WARNING("Failed to set viewport, the size is negative");
+}
+
+void Magma::NullRenderDevice::ReadPixels(int x, int y, int width, int height, void * data)
+{
+	if (width <= 0 || height <= 0)
+		return;
+
+	if (m_renderTarget != nullptr)
+	{
+		const RenderTargetDesc& desc = static_cast<NullRenderTarget*>(m_renderTarget)->desc;
+		if (desc.colorCount == 0 || x < 0 || y < 0 || x + width > desc.width || y + height > desc.height)
+		{
+			MAGMA_WARNING("Failed to read pixels, the render target has no color attachments or the region is out of bounds");
+			return;
+		}
+	}
+
+	// Nothing is rasterized, so every pixel holds the last clear color
+	unsigned char* pixels = static_cast<unsigned char*>(data);
+	for (int i = 0; i < width * height; ++i)
+		memcpy(pixels + i * 4, m_clearColor, sizeof(m_clearColor));
+}
+
+void Magma::NullRenderDevice::Clear(float red, float green, float blue, float alpha, float depth, int stencil)
+{
+	++m_stats.clears;
+
+	const float color[4] = { red, green, blue, alpha };
+	for (int i = 0; i < 4; ++i)
+	{
+		const float c = color[i] < 0.0f ? 0.0f : (color[i] > 1.0f ? 1.0f : color[i]);
+		m_clearColor[i] = static_cast<unsigned char>(c * 255.0f + 0.5f);
+	}
+}
+
+void Magma::NullRenderDevice::DrawTriangles(int offset, int count)
+{
+	if (!this->ValidateDraw(false))
+		return;
+	++m_stats.drawCalls;
+	++m_stats.instances;
+	m_stats.triangles += count / 3;
+}
+
+void Magma::NullRenderDevice::DrawTrianglesIndexed32(long long offset, int count)
+{
+	if (!this->ValidateDraw(true) || !this->ValidateIndexRange(offset, count, true))
+		return;
+	++m_stats.drawCalls;
+	++m_stats.instances;
+	m_stats.triangles += count / 3;
+}
+
+void Magma::NullRenderDevice::DrawTrianglesIndexed(long long offset, int count)
+{
+	if (!this->ValidateDraw(true) || !this->ValidateIndexRange(offset, count, false))
+		return;
+
+	++m_stats.drawCalls;
+	++m_stats.instances;
+	m_stats.triangles += count / 3;
+}
+
+void Magma::NullRenderDevice::DrawTrianglesInstanced(int offset, int count, int instanceCount)
+{
+	if (!this->ValidateDraw(false))
+		return;
+	++m_stats.drawCalls;
+	m_stats.instances += instanceCount;
+	m_stats.triangles += static_cast<unsigned long long>(count / 3) * instanceCount;
+}
+
+void Magma::NullRenderDevice::DrawTrianglesIndexedInstanced(long long offset, int count, int instanceCount)
+{
+	if (!this->ValidateDraw(true) || !this->ValidateIndexRange(offset, count, false))
+		return;
+	++m_stats.drawCalls;
+	m_stats.instances += instanceCount;
+	m_stats.triangles += static_cast<unsigned long long>(count / 3) * instanceCount;
+}
+
+void Magma::NullRenderDevice::DrawTrianglesIndirect(IndirectBuffer * indirectBuffer, long long offset, int drawCount)
+{
+	if (!this->ValidateDraw(false))
+		return;
+	auto commands = static_cast<const DrawIndirectCommand*>(this->ValidateIndirectDraw(indirectBuffer, offset, drawCount, sizeof(DrawIndirectCommand)));
+	if (commands == nullptr)
+		return;
+
+	m_stats.drawCalls += drawCount;
+	for (int i = 0; i < drawCount; ++i)
+	{
+		m_stats.instances += commands[i].instanceCount;
+		m_stats.triangles += static_cast<unsigned long long>(commands[i].count / 3) * commands[i].instanceCount;
+	}
+}
+
+void Magma::NullRenderDevice::DrawTrianglesIndexedIndirect(IndirectBuffer * indirectBuffer, long long offset, int drawCount)
+{
+	if (!this->ValidateDraw(true))
+		return;
+	auto commands = static_cast<const DrawIndexedIndirectCommand*>(this->ValidateIndirectDraw(indirectBuffer, offset, drawCount, sizeof(DrawIndexedIndirectCommand)));
+	if (commands == nullptr)
+		return;
+
+	m_stats.drawCalls += drawCount;
+	for (int i = 0; i < drawCount; ++i)
+	{
+		m_stats.instances += commands[i].instanceCount;
+		m_stats.triangles += static_cast<unsigned long long>(commands[i].count / 3) * commands[i].instanceCount;
+	}
+}
+
+void Magma::NullRenderDevice::BeginScope(const char * name)
+{
+	m_profiler.BeginScope(name);
+}
+
+void Magma::NullRenderDevice::EndScope()
+{
+	m_profiler.EndScope();
+}
+
+void Magma::NullRenderDevice::EndFrame()
+{
+	// Nothing runs on a GPU, so only CPU timings are recorded
+	this->FlushFrameCounters();
+	m_profiler.EndFrame();
+
+	// Uploads and pipeline builds complete on the frame after they were issued
+	m_pendingUploads.clear();
+	for (auto pipeline : m_pendingPipelines)
+		static_cast<NullPipeline*>(pipeline)->ready = true;
+	m_pendingPipelines.clear();
+}
+
+void Magma::NullRenderDevice::FlushFrameCounters()
+{
+	m_profiler.CountDraws(m_stats.drawCalls - m_frameStartStats.drawCalls, m_stats.triangles - m_frameStartStats.triangles);
+	m_profiler.CountStateChanges(m_stats.stateChanges - m_frameStartStats.stateChanges);
+	m_profiler.CountUpload(m_stats.bytesUploaded - m_frameStartStats.bytesUploaded);
+	m_frameStartStats = m_stats;
+}
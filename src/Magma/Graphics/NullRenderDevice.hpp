@@ -0,0 +1,223 @@
+#pragma once
+
+#include "RenderDevice.hpp"
+
+#include <cstddef>
+#include <set>
+
+namespace Magma
+{
+	/// <summary>
+	///		Render device that implements the whole RenderDevice API in memory, without a GPU.
+	///		Tracks resource lifetimes and the bound state and counts the work a real device would do,
+	///		so that renderer code can be tested and measured headlessly.
+	/// </summary>
+	class NullRenderDevice : public RenderDevice
+	{
+	public:
+		/// <summary>
+		///		Counters of the work submitted to the device
+		/// </summary>
+		struct Stats
+		{
+			// Draws, counting every command of an indirect draw (see FrameStats::drawCalls)
+			unsigned long long drawCalls = 0;
+			unsigned long long triangles = 0;
+			unsigned long long instances = 0;
+			unsigned long long stateChanges = 0;
+			unsigned long long redundantStateChanges = 0;
+			unsigned long long paramUploads = 0;
+			unsigned long long bytesUploaded = 0;
+			unsigned long long clears = 0;
+			unsigned long long pipelineCompiles = 0;
+			unsigned long long skippedDraws = 0;
+		};
+
+		NullRenderDevice();
+		virtual ~NullRenderDevice() override;
+
+		/// <summary>
+		///		Gets the counters accumulated since the device was created or the counters were last reset
+		/// </summary>
+		/// <returns>Device counters</returns>
+		inline const Stats& GetStats() const { return m_stats; }
+
+		/// <summary>
+		///		Resets every counter to zero (the counters of the current frame are kept for the frame profiler)
+		/// </summary>
+		inline void ResetStats() { this->FlushFrameCounters(); m_stats = Stats(); m_frameStartStats = m_stats; }
+
+		/// <summary>
+		///		Gets the number of resources created and not yet destroyed
+		/// </summary>
+		/// <returns>Number of live resources</returns>
+		inline size_t GetLiveResourceCount() const { return m_liveResources.size(); }
+
+		/// <summary>
+		///		Checks if a resource was created by this device and not yet destroyed
+		/// </summary>
+		/// <param name="resource">Resource</param>
+		/// <returns>True if alive, otherwise false</returns>
+		inline bool IsAlive(const void* resource) const { return m_liveResources.find(resource) != m_liveResources.end(); }
+
+		/// <summary>
+		///		Makes pipelines created from now on accept any param and uniform block ID, instead of only those declared by their shaders
+		///		(uniform declarations are found in the GLSL sources). Meant for tests using placeholder shader sources, off by default
+		///		so that missing params are reported as on a real device.
+		/// </summary>
+		/// <param name="createUnknownParams">Accept any param</param>
+		inline void SetCreateUnknownParams(bool createUnknownParams) { m_createUnknownParams = createUnknownParams; }
+
+		inline Pipeline* GetPipeline() const { return m_pipeline; }
+		inline VertexArray* GetVertexArray() const { return m_vertexArray; }
+		inline IndexBuffer* GetIndexBuffer() const { return m_indexBuffer; }
+		inline Texture2D* GetTexture2D(unsigned int slot) const { return slot < MaxTextureSlots ? m_textures[slot] : nullptr; }
+		inline Sampler* GetSampler(unsigned int slot) const { return slot < MaxTextureSlots ? m_samplers[slot] : nullptr; }
+		inline RasterState* GetRasterState() const { return m_rasterState; }
+		inline DepthStencilState* GetDepthStencilState() const { return m_depthStencilState; }
+		inline BlendState* GetBlendState() const { return m_blendState; }
+		inline PipelineState* GetPipelineState() const { return m_pipelineState; }
+		inline RenderTarget* GetRenderTarget() const { return m_renderTarget; }
+
+		// Inherited via RenderDevice
+		virtual VertexShader * CreateVertexShader(const char * code) override;
+		virtual void DestroyVertexShader(VertexShader * vertexShader) override;
+		virtual PixelShader * CreatePixelShader(const char * code) override;
+		virtual void DestroyPixelShader(PixelShader * pixelShader) override;
+		virtual Pipeline * CreatePipeline(VertexShader * vertexShader, PixelShader * pixelShader) override;
+		virtual bool IsPipelineReady(Pipeline * pipeline) override;
+		virtual void DestroyPipeline(Pipeline * pipeline) override;
+		virtual void SetPipelineCache(PipelineCache * pipelineCache) override;
+		virtual void SetPipeline(Pipeline * pipeline) override;
+		virtual VertexBuffer * CreateVertexBuffer(long long size, const void * data = nullptr, BufferUsage usage = BufferUsage::Static) override;
+		virtual VertexBuffer * CreateVertexBufferAsync(long long size, const void * data, BufferUsage usage = BufferUsage::Static) override;
+		virtual bool IsVertexBufferReady(VertexBuffer * vertexBuffer) override;
+		virtual void DestroyVertexBuffer(VertexBuffer * vertexBuffer) override;
+		virtual void UpdateVertexBuffer(VertexBuffer * vertexBuffer, long long offset, long long size, const void * data) override;
+		virtual void * MapVertexBuffer(VertexBuffer * vertexBuffer, long long offset, long long size) override;
+		virtual void UnmapVertexBuffer(VertexBuffer * vertexBuffer) override;
+		virtual long long AdvanceVertexBuffer(VertexBuffer * vertexBuffer) override;
+		virtual VertexDescription * CreateVertexDescription(unsigned int numVertexElements, const VertexElement * vertexElements) override;
+		virtual void DestroyVertexDescription(VertexDescription * vertexDescription) override;
+		virtual VertexArray * CreateVertexArray(unsigned int numVertexBuffers, VertexBuffer ** vertexBuffers, VertexDescription ** vertexDescriptions) override;
+		virtual void DestroyVertexArray(VertexArray * vertexArray) override;
+		virtual void SetVertexArray(VertexArray * vertexArray) override;
+		virtual IndexBuffer * CreateIndexBuffer(long long size, const void * data = nullptr, BufferUsage usage = BufferUsage::Static, IndexFormat format = IndexFormat::UInt32) override;
+		virtual void DestroyIndexBuffer(IndexBuffer * indexBuffer) override;
+		virtual void UpdateIndexBuffer(IndexBuffer * indexBuffer, long long offset, long long size, const void * data) override;
+		virtual void * MapIndexBuffer(IndexBuffer * indexBuffer, long long offset, long long size) override;
+		virtual void UnmapIndexBuffer(IndexBuffer * indexBuffer) override;
+		virtual long long AdvanceIndexBuffer(IndexBuffer * indexBuffer) override;
+		virtual void SetIndexBuffer(IndexBuffer * indexBuffer) override;
+		virtual IndirectBuffer * CreateIndirectBuffer(long long size, const void * data = nullptr) override;
+		virtual void DestroyIndirectBuffer(IndirectBuffer * indirectBuffer) override;
+		virtual void * MapIndirectBuffer(IndirectBuffer * indirectBuffer) override;
+		virtual void UnmapIndirectBuffer(IndirectBuffer * indirectBuffer) override;
+		virtual UniformBuffer * CreateUniformBuffer(long long size, const void * data = nullptr) override;
+		virtual void DestroyUniformBuffer(UniformBuffer * uniformBuffer) override;
+		virtual void UpdateUniformBuffer(UniformBuffer * uniformBuffer, long long offset, long long size, const void * data) override;
+		using RenderDevice::CreateTexture2D;
+		virtual Texture2D * CreateTexture2D(const Texture2DDesc & desc) override;
+		virtual Texture2D * CreateTexture2DAsync(const Texture2DDesc & desc) override;
+		virtual bool IsTexture2DReady(Texture2D * texture2D) override;
+		virtual void DestroyTexture2D(Texture2D * texture2D) override;
+		virtual void SetTexture2D(unsigned int slot, Texture2D * texture2D) override;
+		virtual void UpdateTexture2D(Texture2D * texture2D, int layer, int level, const void * data, bool generateMips = false) override;
+		virtual unsigned long long GetTexture2DHandle(Texture2D * texture2D, Sampler * sampler = nullptr) override;
+		virtual Sampler * CreateSampler(const SamplerDesc & desc) override;
+		virtual void DestroySampler(Sampler * sampler) override;
+		virtual void SetSampler(unsigned int slot, Sampler * sampler) override;
+		virtual RasterState * CreateRasterState(bool cullEnabled = true, Winding frontFace = Winding::CCW, Face cullFace = Face::Back, RasterMode rasterMode = RasterMode::Fill) override;
+		virtual void DestroyRasterState(RasterState * rasterState) override;
+		virtual void SetRasterState(RasterState * rasterState) override;
+		virtual DepthStencilState *CreateDepthStencilState(bool depthEnabled = true,
+														   bool depthWriteEnabled = true, float depthNear = 0, float depthFar = 1,
+														   Compare depthCompare = Compare::Less, bool frontFaceStencilEnabled = false,
+														   Compare frontFaceStencilCompare = Compare::Always,
+														   StencilAction frontFaceStencilFail = StencilAction::Keep,
+														   StencilAction frontFaceStencilPass = StencilAction::Keep,
+														   StencilAction frontFaceDepthFail = StencilAction::Keep,
+														   int frontFaceRef = 0, unsigned int frontFaceReadMask = 0xFFFFFFFF,
+														   unsigned int frontFaceWriteMask = 0xFFFFFFFF,
+														   bool backFaceStencilEnabled = false,
+														   Compare backFaceStencilCompare = Compare::Always,
+														   StencilAction backFaceStencilFail = StencilAction::Keep,
+														   StencilAction backFaceStencilPass = StencilAction::Keep,
+														   StencilAction backFaceDepthFail = StencilAction::Keep,
+														   int backFaceRef = 0, unsigned int backFaceReadMask = 0xFFFFFFFF,
+														   unsigned int backFaceWriteMask = 0xFFFFFFFF) override;
+		virtual void DestroyDepthStencilState(DepthStencilState * depthStencilState) override;
+		virtual void SetDepthStencilState(DepthStencilState * depthStencilState) override;
+		virtual BlendState * CreateBlendState(bool blendEnabled = false, BlendFactor srcColor = BlendFactor::One, BlendFactor dstColor = BlendFactor::Zero, BlendOp colorOp = BlendOp::Add,
+											  BlendFactor srcAlpha = BlendFactor::One, BlendFactor dstAlpha = BlendFactor::Zero, BlendOp alphaOp = BlendOp::Add,
+											  unsigned int colorWriteMask = ColorWriteAll) override;
+		virtual void DestroyBlendState(BlendState * blendState) override;
+		virtual void SetBlendState(BlendState * blendState) override;
+		virtual PipelineState * CreatePipelineState(const PipelineStateDesc & desc) override;
+		virtual void DestroyPipelineState(PipelineState * pipelineState) override;
+		virtual void SetPipelineState(PipelineState * pipelineState) override;
+		virtual RenderTarget * CreateRenderTarget(const RenderTargetDesc & desc) override;
+		virtual void DestroyRenderTarget(RenderTarget * renderTarget) override;
+		virtual void SetRenderTarget(RenderTarget * renderTarget) override;
+		virtual void ResolveRenderTarget(RenderTarget * renderTarget) override;
+		virtual void SetViewport(int x, int y, int width, int height) override;
+		virtual void ReadPixels(int x, int y, int width, int height, void * data) override;
+		virtual void Clear(float red = 0.0f, float green = 0.0f, float blue = 0.0f, float alpha = 1.0f, float depth = 1.0f, int stencil = 0) override;
+		virtual void DrawTriangles(int offset, int count) override;
+		virtual void DrawTrianglesIndexed32(long long offset, int count) override;
+		virtual void DrawTrianglesIndexed(long long offset, int count) override;
+		virtual void DrawTrianglesInstanced(int offset, int count, int instanceCount) override;
+		virtual void DrawTrianglesIndexedInstanced(long long offset, int count, int instanceCount) override;
+		virtual void DrawTrianglesIndirect(IndirectBuffer * indirectBuffer, long long offset, int drawCount) override;
+		virtual void DrawTrianglesIndexedIndirect(IndirectBuffer * indirectBuffer, long long offset, int drawCount) override;
+		virtual void BeginScope(const char * name) override;
+		virtual void EndScope() override;
+		virtual void EndFrame() override;
+
+	private:
+		static const unsigned int MaxTextureSlots = 32;
+
+		// Registers a newly created resource and returns it
+		template <typename T>
+		T* Track(T* resource);
+		// Unregisters a resource, returns false (and warns) if it isn't alive
+		bool Untrack(const void* resource, const char* type);
+		// Counts a state change and returns true if the new value differs from the current one
+		template <typename T>
+		bool Change(T*& current, T* value);
+		// Checks that there's enough bound state to draw
+		bool ValidateDraw(bool indexed);
+		// Checks that an index range is aligned and inside the bound index buffer, read with its own format or as 32 bit indices
+		bool ValidateIndexRange(long long offset, int count, bool indices32);
+		// Checks that indirect draw commands are inside the buffer and returns a pointer to the first one
+		const void* ValidateIndirectDraw(IndirectBuffer* indirectBuffer, long long offset, int drawCount, size_t commandSize);
+		// Adds the counters accumulated since the last flush to the current frame of the profiler
+		void FlushFrameCounters();
+
+		Stats m_stats;
+		// Counters when they were last flushed to the profiler
+		Stats m_frameStartStats;
+		std::set<const void*> m_liveResources;
+		// Resources created asynchronously, ready on the next EndFrame
+		std::set<const void*> m_pendingUploads;
+		// Pipelines created since the last EndFrame, not ready yet
+		std::set<Pipeline*> m_pendingPipelines;
+
+		PipelineCache* m_pipelineCache = nullptr;
+		bool m_createUnknownParams = false;
+
+		Pipeline* m_pipeline = nullptr;
+		VertexArray* m_vertexArray = nullptr;
+		IndexBuffer* m_indexBuffer = nullptr;
+		Texture2D* m_textures[MaxTextureSlots] = {};
+		Sampler* m_samplers[MaxTextureSlots] = {};
+		RasterState* m_rasterState = nullptr;
+		DepthStencilState* m_depthStencilState = nullptr;
+		BlendState* m_blendState = nullptr;
+		// Pipeline state the bound pipeline and states were last set from, null if any of them was changed since
+		PipelineState* m_pipelineState = nullptr;
+		RenderTarget* m_renderTarget = nullptr;
+		// Last clear color as RGBA8, returned by ReadPixels
+		unsigned char m_clearColor[4] = { 0, 0, 0, 255 };
+	};
+}
@@ -1,7 +1,18 @@
 #include "OpenGLRenderDevice.hpp"
+#include "PipelineCache.hpp"
 #include "..\Utils\Utils.hpp"
+#include "..\Utils\JobPool.hpp"
 
 #include <map>
+#include <unordered_map>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 #include <gl\glew.h>
@@ -10,180 +21,695 @@ using namespace Magma;
 
 namespace Magma
 {
-	class OpenGLVertexShader : public VertexShader
+	// Shader objects are created lazily, and only compiled when a pipeline using them isn't found in the pipeline cache.
+	// Compile errors are reported when the pipelines using the shader fail to link, so that compiles never block.
+	class OpenGLShader
 	{
 	public:
-		OpenGLVertexShader(const char* code)
+		OpenGLShader(GLenum _type, const char* _code) : type(_type), code(_code) {}
+
+		~OpenGLShader()
 		{
-			vertexShader = glCreateShader(GL_VERTEX_SHADER);
-			glShaderSource(vertexShader, 1, &code, NULL);
-			glCompileShader(vertexShader);
+			// Pipelines still linking keep the shader object alive until they are done with it
+			if (shader != 0)
+				glDeleteShader(shader);
+		}
 
-			int success;
-			char infoLog[512];
-			glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-			if (!success)
+		int GetShader()
+		{
+			if (shader == 0)
 			{
-				glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-				MAGMA_ERROR("Vertex shader compilation failed: " + std::string(infoLog));
+				const char* source = code.c_str();
+				shader = glCreateShader(type);
+				glShaderSource(shader, 1, &source, NULL);
 			}
+			return shader;
 		}
 
-		virtual ~OpenGLVertexShader() override
+		int Compile()
 		{
-			glDeleteShader(vertexShader);
+			this->GetShader();
+			if (!compiled)
+			{
+				glCompileShader(shader);
+				compiled = true;
+			}
+			return shader;
 		}
 
-		int vertexShader = 0;
+		GLenum type;
+		std::string code;
+		int shader = 0;
+		bool compiled = false;
+	};
+
+	class OpenGLVertexShader : public VertexShader, public OpenGLShader
+	{
+	public:
+		OpenGLVertexShader(const char* code) : OpenGLShader(GL_VERTEX_SHADER, code) {}
+	};
+
+	class OpenGLPixelShader : public PixelShader, public OpenGLShader
+	{
+	public:
+		OpenGLPixelShader(const char* code) : OpenGLShader(GL_FRAGMENT_SHADER, code) {}
 	};
 
-	class OpenGLPixelShader : public PixelShader
+	class OpenGLUniformRing
 	{
 	public:
-		OpenGLPixelShader(const char* code)
+		// The ring is split in segments, each fenced once the device moves on to the next one
+		static const GLsizeiptr Size = 4 * 1024 * 1024;
+		static const unsigned int SegmentCount = 4;
+		static const GLsizeiptr SegmentSize = Size / SegmentCount;
+
+		OpenGLUniformRing()
+		{
+			GLint offsetAlignment = 256;
+			glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+			alignment = offsetAlignment;
+
+			glGenBuffers(1, &ubo);
+			glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+			if (GLEW_ARB_buffer_storage)
+			{
+				const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+				glBufferStorage(GL_UNIFORM_BUFFER, Size, nullptr, flags);
+				mapped = static_cast<unsigned char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, Size, flags));
+			}
+			else
+				glBufferData(GL_UNIFORM_BUFFER, Size, nullptr, GL_STREAM_DRAW);
+		}
+
+		~OpenGLUniformRing()
 		{
-			fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-			glShaderSource(fragmentShader, 1, &code, NULL);
-			glCompileShader(fragmentShader);
+			for (auto& fence : fences)
+				if (fence != nullptr)
+					glDeleteSync(fence);
+			if (mapped != nullptr)
+			{
+				glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+				glUnmapBuffer(GL_UNIFORM_BUFFER);
+			}
+			glDeleteBuffers(1, &ubo);
+		}
+
+		inline GLsizeiptr Align(GLsizeiptr size) const { return (size + alignment - 1) / alignment * alignment; }
 
-			int success;
-			char infoLog[512];
-			glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-			if (!success)
+		// Reserves a range of the ring, waiting for the GPU if the range is still in use
+		GLintptr Allocate(GLsizeiptr size)
+		{
+			GLintptr offset = this->Align(head);
+			if (offset + size > (segment + 1) * SegmentSize)
 			{
-				glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-				MAGMA_ERROR("Pixel shader compilation failed: " + std::string(infoLog));
+				// Fence the current segment and move to the next one, once the GPU is done reading it
+				fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				segment = (segment + 1) % SegmentCount;
+				++epoch;
+				if (fences[segment] != nullptr)
+				{
+					while (glClientWaitSync(fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+					glDeleteSync(fences[segment]);
+					fences[segment] = nullptr;
+				}
+				offset = segment * SegmentSize;
 			}
+			head = offset + size;
+			return offset;
 		}
 
-		virtual ~OpenGLPixelShader() override
+		void Write(GLintptr offset, const void* data, GLsizeiptr size)
 		{
-			glDeleteShader(fragmentShader);
+			if (mapped != nullptr)
+				memcpy(mapped + offset, data, size);
+			else
+			{
+				glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+				glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+			}
 		}
 
-		int fragmentShader = 0;
+		// Ranges allocated on a certain epoch stay valid until their segment is reused.
+		// One segment of margin is kept, as the next allocation may already move into it.
+		inline bool IsValid(unsigned long long allocationEpoch) const { return epoch - allocationEpoch < SegmentCount - 1; }
+
+		GLuint ubo = 0;
+		GLsizeiptr alignment = 256;
+		unsigned char* mapped = nullptr;
+		GLintptr head = 0;
+		GLintptr segment = 0;
+		unsigned long long epoch = SegmentCount;
+		GLsync fences[SegmentCount] = {};
 	};
 
 	class OpenGLPipelineParam;
+	class OpenGLUniformBuffer;
 
 	class OpenGLPipeline : public Pipeline
 	{
 	public:
-		OpenGLPipeline(OpenGLVertexShader *vertexShader, OpenGLPixelShader *pixelShader)
+		// CPU copy of a uniform block, uploaded to the uniform ring when dirty
+		struct Block
+		{
+			ParamID id = 0;
+			std::vector<unsigned char> data;
+			GLuint binding = 0;
+			bool dirty = true;
+			GLintptr offset = 0;
+			unsigned long long epoch = 0;
+			// Uniform buffer the block is sourced from instead, if any
+			OpenGLUniformBuffer* buffer = nullptr;
+			long long bufferOffset = 0;
+		};
+
+		// Starts building the program. With parallel compilation the driver compiles and links in the background,
+		// otherwise compiling and linking are deferred until the pipeline is needed or the device has time for it.
+		OpenGLPipeline(OpenGLVertexShader *vertexShader, OpenGLPixelShader *pixelShader, PipelineCache* _cache, const std::string& driver, bool parallel)
 		{
-			// Attach shaders and link them
 			shaderProgram = glCreateProgram();
-			glAttachShader(shaderProgram, vertexShader->vertexShader);
-			glAttachShader(shaderProgram, pixelShader->fragmentShader);
-			glLinkProgram(shaderProgram);
 
-			// Check if there were errors when linking
-			int success;
-			char infoLog[512];
-			glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-			if (!success)
+			// Try to load the program binary linked on a previous run
+			if (_cache != nullptr && GLEW_ARB_get_program_binary)
 			{
-				glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-				MAGMA_ERROR("Pipeline linking failed: " + std::string(infoLog));
+				cache = _cache;
+				key = PipelineCache::MakeKey(vertexShader->code.c_str(), pixelShader->code.c_str(), driver.c_str());
+				std::vector<unsigned char> binary;
+				if (cache->Load(key, binary) && binary.size() > sizeof(GLenum))
+				{
+					// Binaries are stored prefixed by their format
+					GLenum format;
+					memcpy(&format, binary.data(), sizeof(GLenum));
+					glProgramBinary(shaderProgram, format, binary.data() + sizeof(GLenum), static_cast<GLsizei>(binary.size() - sizeof(GLenum)));
+
+					// Drivers may still reject binaries (e.g. after a hardware change), in which case the program is linked again
+					int success = 0;
+					glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+					if (success)
+					{
+						cache = nullptr;
+						this->Reflect();
+						state = State::Ready;
+						return;
+					}
+				}
+				glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			}
+
+			if (parallel)
+			{
+				glAttachShader(shaderProgram, vertexShader->Compile());
+				glAttachShader(shaderProgram, pixelShader->Compile());
+				glLinkProgram(shaderProgram);
+				state = State::Linking;
+			}
+			else
+			{
+				// Attached shader objects outlive their VertexShader and PixelShader until the program is deleted
+				glAttachShader(shaderProgram, vertexShader->GetShader());
+				glAttachShader(shaderProgram, pixelShader->GetShader());
+				state = State::Deferred;
 			}
 		}
 
-		virtual ~OpenGLPipeline() override
+		virtual ~OpenGLPipeline() override;
+
+		using Pipeline::GetParam;
+		PipelineParam* GetParam(ParamID id) override;
+		using Pipeline::SetUniformBuffer;
+		void SetUniformBuffer(ParamID id, UniformBuffer* uniformBuffer, long long offset) override;
+
+		inline bool IsDone() const { return state == State::Ready || state == State::Failed; }
+
+		// Compiles the attached shaders and links the program of a deferred pipeline
+		void Link();
+		// Finishes the pipeline if the program is done linking (waiting for it if asked to), returns true if ready
+		bool Poll(bool wait);
+		// Finds the uniform blocks and uniforms of the linked program
+		void Reflect();
+		// Stores the binary of the linked program in the pipeline cache
+		void StoreBinary();
+
+		enum class State
 		{
-			glDeleteProgram(shaderProgram);
-		}
+			Deferred,
+			Linking,
+			Ready,
+			Failed,
+		};
 
-		PipelineParam* GetParam(const char* name) override;
+		State state = State::Deferred;
+		// Cache the linked program is stored in, once done
+		PipelineCache* cache = nullptr;
+		unsigned long long key = 0;
 
 		int shaderProgram = 0;
-		std::map<std::string, OpenGLPipelineParam*> params;
+		// Reflected params, sorted by ID
+		std::vector<std::pair<ParamID, OpenGLPipelineParam*>> params;
+		std::vector<Block> blocks;
+		// Set once the blocks were found too large for the uniform ring, so that it is only reported once
+		bool oversizedBlocks = false;
+		// Default block params set since the last draw with this pipeline
+		std::vector<OpenGLPipelineParam*> dirtyParams;
 	};
 
 	class OpenGLPipelineParam : public PipelineParam
 	{
 	public:
+		enum class Type
+		{
+			Int,
+			Float,
+			Mat4,
+		};
+
+		// Default block uniform
 		OpenGLPipelineParam(OpenGLPipeline* _pipeline, int _location) : pipeline(_pipeline), location(_location) {}
 
+		// Uniform block member
+		OpenGLPipelineParam(OpenGLPipeline* _pipeline, int _block, int _offset, int _arrayStride)
+			: pipeline(_pipeline), block(_block), offset(_offset), arrayStride(_arrayStride) {}
+
 		virtual void SetAsInt(int value) override
 		{
-			glUseProgram(pipeline->shaderProgram);
-			glUniform1i(location, value);
+			this->Set(Type::Int, 1, &value, sizeof(int));
 		}
 
 		virtual void SetAsFloat(float value) override
 		{
-			glUseProgram(pipeline->shaderProgram);
-			glUniform1f(location, value);
+			this->Set(Type::Float, 1, &value, sizeof(float));
 		}
 
 		virtual void SetAsMat4(const float * value) override
 		{
-			glUseProgram(pipeline->shaderProgram);
-			glUniformMatrix4fv(location, 1, GL_FALSE, value);
+			this->Set(Type::Mat4, 1, value, 16 * sizeof(float));
 		}
 
 		virtual void SetAsIntArray(int count, const int * values) override
 		{
-			glUseProgram(pipeline->shaderProgram);
-			glUniform1iv(location, count, values);
+			this->Set(Type::Int, count, values, sizeof(int));
 		}
 
 		virtual void SetAsFloatArray(int count, const float * values) override
 		{
-			glUseProgram(pipeline->shaderProgram);
-			glUniform1fv(location, count, values);
+			this->Set(Type::Float, count, values, sizeof(float));
 		}
 
 		virtual void SetAsMat4Array(int count, const float * values) override
 		{
-			glUseProgram(pipeline->shaderProgram);
-			glUniformMatrix4fv(location, count, GL_FALSE, values);
+			this->Set(Type::Mat4, count, values, 16 * sizeof(float));
+		}
+
+		// Writes the value to CPU memory, it is uploaded on the next draw with the pipeline
+		void Set(Type _type, int _count, const void* values, size_t elementSize)
+		{
+			const unsigned char* src = static_cast<const unsigned char*>(values);
+
+			if (block >= 0)
+			{
+				// Block members are written at their std140/shared layout offsets (matrices are column major, 16 byte columns)
+				OpenGLPipeline::Block& b = pipeline->blocks[block];
+				const size_t stride = arrayStride > 0 ? arrayStride : elementSize;
+				for (int i = 0; i < _count; ++i)
+				{
+					if (offset + i * stride + elementSize > b.data.size())
+					{
+						MAGMA_WARNING("Failed to set pipeline param, the value doesn't fit in its uniform block");
+						break;
+					}
+					memcpy(b.data.data() + offset + i * stride, src + i * elementSize, elementSize);
+				}
+				b.dirty = true;
+				return;
+			}
+
+			type = _type;
+			count = _count;
+			value.assign(src, src + _count * elementSize);
+			if (!dirty)
+			{
+				dirty = true;
+				pipeline->dirtyParams.push_back(this);
+			}
+		}
+
+		// Uploads a default block uniform, the pipeline program must be bound
+		void Upload()
+		{
+			switch (type)
+			{
+				case Type::Int: glUniform1iv(location, count, reinterpret_cast<const GLint*>(value.data())); break;
+				case Type::Float: glUniform1fv(location, count, reinterpret_cast<const GLfloat*>(value.data())); break;
+				case Type::Mat4: glUniformMatrix4fv(location, count, GL_FALSE, reinterpret_cast<const GLfloat*>(value.data())); break;
+			}
+			dirty = false;
 		}
 
 		OpenGLPipeline* pipeline;
-		int location;
+		int location = -1;
+
+		int block = -1;
+		int offset = 0;
+		int arrayStride = 0;
+
+		Type type = Type::Int;
+		int count = 0;
+		std::vector<unsigned char> value;
+		bool dirty = false;
 	};
 
-	PipelineParam * OpenGLPipeline::GetParam(const char * name)
+	OpenGLPipeline::~OpenGLPipeline()
+	{
+		for (auto& p : params)
+			delete p.second;
+		glDeleteProgram(shaderProgram);
+	}
+
+	void OpenGLPipeline::Link()
+	{
+		GLint count = 0;
+		GLuint shaders[2];
+		glGetAttachedShaders(shaderProgram, 2, &count, shaders);
+		for (GLint i = 0; i < count; ++i)
+		{
+			// Shaders shared with pipelines linked before are already compiled
+			GLint compiled = 0;
+			glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compiled);
+			if (!compiled)
+				glCompileShader(shaders[i]);
+		}
+
+		glLinkProgram(shaderProgram);
+		state = State::Linking;
+	}
+
+	bool OpenGLPipeline::Poll(bool wait)
 	{
-		auto it = params.find(name);
-		if (it == params.end())
+		if (this->IsDone())
+			return state == State::Ready;
+
+		if (state == State::Deferred)
+		{
+			if (!wait)
+				return false;
+			this->Link();
+		}
+		else if (!wait && GLEW_KHR_parallel_shader_compile)
+		{
+			GLint completed = 0;
+			glGetProgramiv(shaderProgram, GL_COMPLETION_STATUS_KHR, &completed);
+			if (!completed)
+				return false;
+		}
+
+		// Check if there were errors when compiling or linking
+		int success;
+		char infoLog[512];
+		glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+		if (!success)
 		{
-			int location = glGetUniformLocation(shaderProgram, name);
-			if (location < 0)
+			GLint count = 0;
+			GLuint shaders[2];
+			glGetAttachedShaders(shaderProgram, 2, &count, shaders);
+			for (GLint i = 0; i < count; ++i)
 			{
-				MAGMA_WARNING("Failed to get param from pipeline, no param with this name");
-				return nullptr;
+				GLint type = 0;
+				glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+				glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &success);
+				if (!success)
+				{
+					glGetShaderInfoLog(shaders[i], 512, NULL, infoLog);
+					MAGMA_ERROR(std::string(type == GL_VERTEX_SHADER ? "Vertex" : "Pixel") + " shader compilation failed: " + std::string(infoLog));
+				}
 			}
-			OpenGLPipelineParam* param = new OpenGLPipelineParam
-			(this, location);
-			params.insert(it, std::make_pair(name, param));
-			return param;
+
+			glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+			MAGMA_ERROR("Pipeline linking failed: " + std::string(infoLog));
+			state = State::Failed;
+			return false;
 		}
-		else
+
+		if (cache != nullptr)
+			this->StoreBinary();
+		this->Reflect();
+		state = State::Ready;
+		return true;
+	}
+
+	void OpenGLPipeline::StoreBinary()
+	{
+		GLint length = 0;
+		glGetProgramiv(shaderProgram, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+
+		std::vector<unsigned char> binary(sizeof(GLenum) + length);
+		GLenum format = 0;
+		glGetProgramBinary(shaderProgram, length, &length, &format, binary.data() + sizeof(GLenum));
+		memcpy(binary.data(), &format, sizeof(GLenum));
+		cache->Store(key, binary.data(), sizeof(GLenum) + length);
+	}
+
+	void OpenGLPipeline::Reflect()
+	{
+		GLint blockCount = 0;
+		glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+		blocks.resize(blockCount);
+		for (GLint i = 0; i < blockCount; ++i)
+		{
+			GLint dataSize = 0, nameLength = 0;
+			glGetActiveUniformBlockiv(shaderProgram, i, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+			glGetActiveUniformBlockiv(shaderProgram, i, GL_UNIFORM_BLOCK_NAME_LENGTH, &nameLength);
+			std::vector<char> name(nameLength + 1, '\0');
+			glGetActiveUniformBlockName(shaderProgram, i, static_cast<GLsizei>(name.size()), nullptr, name.data());
+			blocks[i].id = MakeParamID(name.data());
+			blocks[i].data.resize(dataSize);
+			if (static_cast<unsigned int>(i) >= OpenGLRenderDevice::MaxUniformBindings)
+				MAGMA_WARNING("Pipeline uniform block \"" + std::string(name.data()) + "\" is beyond the " + std::to_string(OpenGLRenderDevice::MaxUniformBindings) + " binding points and will never be bound");
+			// Every pipeline binds its blocks to the binding points matching their indices
+			blocks[i].binding = i;
+			glUniformBlockBinding(shaderProgram, i, i);
+		}
+
+		GLint uniformCount = 0, maxNameLength = 0;
+		glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORMS, &uniformCount);
+		glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+		std::vector<char> nameBuffer(maxNameLength + 1);
+		for (GLint i = 0; i < uniformCount; ++i)
 		{
-			return it->second;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(shaderProgram, i, static_cast<GLsizei>(nameBuffer.size()), nullptr, &size, &type, nameBuffer.data());
+
+			GLuint index = i;
+			GLint block = -1, offset = 0, arrayStride = 0;
+			glGetActiveUniformsiv(shaderProgram, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block);
+			glGetActiveUniformsiv(shaderProgram, 1, &index, GL_UNIFORM_OFFSET, &offset);
+			glGetActiveUniformsiv(shaderProgram, 1, &index, GL_UNIFORM_ARRAY_STRIDE, &arrayStride);
+
+			// Arrays are reported as "name[0]"
+			std::string name = nameBuffer.data();
+			if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+				name.resize(name.size() - 3);
+
+			OpenGLPipelineParam* param;
+			if (block >= 0)
+				param = new OpenGLPipelineParam(this, block, offset, arrayStride);
+			else
+				param = new OpenGLPipelineParam(this, glGetUniformLocation(shaderProgram, nameBuffer.data()));
+			params.push_back(std::make_pair(MakeParamID(name.c_str()), param));
 		}
+
+		std::sort(params.begin(), params.end(), [](const std::pair<ParamID, OpenGLPipelineParam*>& a, const std::pair<ParamID, OpenGLPipelineParam*>& b)
+		{
+			return a.first < b.first;
+		});
+		for (size_t i = 1; i < params.size(); ++i)
+			if (params[i].first == params[i - 1].first)
+				MAGMA_WARNING("Pipeline has two params with the same ID, only one of them can be set");
 	}
 
-	class OpenGLVertexBuffer : public VertexBuffer
+	PipelineParam * OpenGLPipeline::GetParam(ParamID id)
+	{
+		// Params are only known once the program is linked
+		this->Poll(true);
+
+		auto it = std::lower_bound(params.begin(), params.end(), id, [](const std::pair<ParamID, OpenGLPipelineParam*>& p, ParamID id)
+		{
+			return p.first < id;
+		});
+		if (it == params.end() || it->first != id)
+		{
+			MAGMA_WARNING("Failed to get param from pipeline, no param with this ID");
+			return nullptr;
+		}
+		return it->second;
+	}
+
+	// Buffer storage shared by vertex and index buffers. Stream buffers hold StreamRegions copies of their size,
+	// each fenced when the buffer advances past it, so that the CPU only ever writes a region the GPU is done with.
+	class OpenGLBuffer
 	{
 	public:
+		static const unsigned int StreamRegions = 3;
+
+		OpenGLBuffer(long long _size, const void *data, BufferUsage _usage) : size(_size), usage(_usage)
+		{
+			static const GLenum toOpenGLUsage[] = { GL_STATIC_DRAW, GL_DYNAMIC_DRAW, GL_STREAM_DRAW };
+
+			glGenBuffers(1, &buffer);
+			// Use the copy write target, binding GL_ELEMENT_ARRAY_BUFFER would change the bound vertex array
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+
+			if (usage != BufferUsage::Stream)
+			{
+				glBufferData(GL_COPY_WRITE_BUFFER, size, data, toOpenGLUsage[static_cast<size_t>(usage)]);
+				return;
+			}
+
+			regionCount = StreamRegions;
+			if (GLEW_ARB_buffer_storage)
+			{
+				const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+				glBufferStorage(GL_COPY_WRITE_BUFFER, size * regionCount, nullptr, flags);
+				persistent = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size * regionCount, flags));
+			}
+			else
+				glBufferData(GL_COPY_WRITE_BUFFER, size * regionCount, nullptr, GL_STREAM_DRAW);
+
+			if (data != nullptr)
+				this->Update(0, size, data);
+		}
+
+		~OpenGLBuffer()
+		{
+			for (auto& fence : fences)
+				if (fence != nullptr)
+					glDeleteSync(fence);
+			if (persistent != nullptr)
+			{
+				glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+				glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+			}
+			glDeleteBuffers(1, &buffer);
+		}
+
+		bool CheckRange(long long offset, long long rangeSize, const char* action)
+		{
+			if (offset < 0 || rangeSize < 0 || offset + rangeSize > size)
+			{
+				MAGMA_WARNING(std::string("Failed to ") + action + " buffer, the range is out of bounds");
+				return false;
+			}
+			return true;
+		}
 
-		OpenGLVertexBuffer(long long size, const void *data)
+		bool Update(long long offset, long long updateSize, const void *data)
 		{
-			glGenBuffers(1, &vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, vbo);
-			// Assume static vertex buffer for now
-			glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+			if (!this->CheckRange(offset, updateSize, "update"))
+				return false;
+			if (mapped)
+			{
+				MAGMA_WARNING("Failed to update buffer, it is mapped");
+				return false;
+			}
+
+			if (persistent != nullptr)
+				memcpy(persistent + region * size + offset, data, static_cast<size_t>(updateSize));
+			else
+			{
+				glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+				glBufferSubData(GL_COPY_WRITE_BUFFER, region * size + offset, updateSize, data);
+			}
+			return true;
+		}
+
+		void* Map(long long offset, long long mapSize)
+		{
+			if (!this->CheckRange(offset, mapSize, "map"))
+				return nullptr;
+			if (mapped)
+			{
+				MAGMA_WARNING("Failed to map buffer, it is already mapped");
+				return nullptr;
+			}
+
+			mapped = true;
+			mappedSize = mapSize;
+			if (persistent != nullptr)
+				return persistent + region * size + offset;
+
+			// The fences already keep the GPU off the current region of stream buffers
+			GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+			if (usage == BufferUsage::Stream)
+				access |= GL_MAP_UNSYNCHRONIZED_BIT;
+
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			void* data = glMapBufferRange(GL_COPY_WRITE_BUFFER, region * size + offset, mapSize, access);
+			mapped = data != nullptr;
+			return data;
+		}
+
+		// Returns the size of the unmapped range
+		long long Unmap()
+		{
+			if (!mapped)
+			{
+				MAGMA_WARNING("Failed to unmap buffer, it isn't mapped");
+				return 0;
+			}
+
+			mapped = false;
+			if (persistent == nullptr)
+			{
+				glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+				glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+			}
+			return mappedSize;
+		}
+
+		long long Advance()
+		{
+			if (regionCount == 1)
+				return 0;
+			if (mapped)
+				MAGMA_WARNING("Advancing a buffer while it is mapped");
+
+			// Fence the draws issued with the current region and wait for the GPU to be done with the next one
+			fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			region = (region + 1) % regionCount;
+			if (fences[region] != nullptr)
+			{
+				while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+				glDeleteSync(fences[region]);
+				fences[region] = nullptr;
+			}
+			return region * size;
 		}
 
-		virtual ~OpenGLVertexBuffer() override
+		unsigned int buffer = 0;
+		long long size;
+		BufferUsage usage;
+		unsigned int regionCount = 1;
+		unsigned int region = 0;
+		GLsync fences[StreamRegions] = {};
+		unsigned char* persistent = nullptr;
+		bool mapped = false;
+		long long mappedSize = 0;
+	};
+
+	class OpenGLVertexBuffer : public VertexBuffer
+	{
+	public:
+
+		OpenGLVertexBuffer(long long size, const void *data, BufferUsage usage) : storage(size, data, usage)
 		{
-			glDeleteBuffers(1, &vbo);
+			vbo = storage.buffer;
 		}
 
+		OpenGLBuffer storage;
 		unsigned int vbo = 0;
+		// False while an asynchronous upload is in flight
+		bool ready = true;
 	};
 
 	class OpenGLVertexDescription : public VertexDescription
@@ -197,15 +723,18 @@ namespace Magma
 			GLboolean normalized;
 			GLsizei stride;
 			const GLvoid *pointer;
+			GLuint divisor;
 		};
 
 		OpenGLVertexDescription(unsigned int _numVertexElements, const VertexElement* vertexElements) : numVertexElements(_numVertexElements)
 		{
 			// Used to convert from our enum types to OpenGL types
 			static GLenum toOpenGLType[] = { GL_BYTE, GL_SHORT, GL_INT, GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_UNSIGNED_INT,
-				GL_BYTE, GL_SHORT, GL_INT, GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_UNSIGNED_INT, GL_HALF_FLOAT, GL_FLOAT, GL_DOUBLE };
+				GL_BYTE, GL_SHORT, GL_INT, GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_UNSIGNED_INT, GL_HALF_FLOAT, GL_FLOAT, GL_DOUBLE,
+				GL_INT_2_10_10_10_REV };
 			static GLboolean toOpenGLNormalized[] = { GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE,
-				GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE, GL_FALSE, GL_FALSE, GL_FALSE };
+				GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE, GL_FALSE, GL_FALSE, GL_FALSE,
+				GL_TRUE };
 
 			openGLVertexElements = new OpenGLVertexElement[numVertexElements];
 			for (unsigned int i = 0; i < numVertexElements; i++)
@@ -216,6 +745,7 @@ namespace Magma
 				openGLVertexElements[i].normalized = toOpenGLNormalized[static_cast<size_t>(vertexElements[i].type)];
 				openGLVertexElements[i].stride = vertexElements[i].stride;
 				openGLVertexElements[i].pointer = (char *)nullptr + vertexElements[i].offset;
+				openGLVertexElements[i].divisor = vertexElements[i].divisor;
 			}
 		}
 		
@@ -253,6 +783,7 @@ namespace Magma
 										  vertexDescription->openGLVertexElements[j].normalized,
 										  vertexDescription->openGLVertexElements[j].stride,
 										  vertexDescription->openGLVertexElements[j].pointer);
+					glVertexAttribDivisor(vertexDescription->openGLVertexElements[j].index, vertexDescription->openGLVertexElements[j].divisor);
 				}
 			}
 		}
@@ -263,362 +794,1679 @@ namespace Magma
 		}
 
 		unsigned int vao = 0;
+		// Serial and index type of the index buffer bound to this vertex array (element buffer bindings are vertex array state)
+		unsigned long long indexBuffer = 0;
+		GLenum indexType = GL_UNSIGNED_INT;
 	};
 
 	class OpenGLIndexBuffer : public IndexBuffer
 	{
 	public:
 
-		OpenGLIndexBuffer(long long size, const void *data)
+		OpenGLIndexBuffer(long long size, const void *data, BufferUsage usage, IndexFormat format) : storage(size, data, usage)
 		{
-			glGenBuffers(1, &ibo);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-			// Assume static index buffer for now
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
-		}
+			static const GLenum toOpenGLIndexType[] = { GL_UNSIGNED_SHORT, GL_UNSIGNED_INT };
+			type = toOpenGLIndexType[static_cast<size_t>(format)];
 
-		virtual ~OpenGLIndexBuffer() override
-		{
-			glDeleteBuffers(1, &ibo);
+			static unsigned long long nextSerial = 1;
+			serial = nextSerial++;
+			ibo = storage.buffer;
 		}
 
+		OpenGLBuffer storage;
 		unsigned int ibo = 0;
+		GLenum type;
+		// Unlike GL names, serials are never reused, so a vertex array never mistakes a new buffer for a destroyed one
+		unsigned long long serial = 0;
 	};
 
-	class OpenGLTexture2D : public Texture2D
+	class OpenGLIndirectBuffer : public IndirectBuffer
 	{
 	public:
 
-		OpenGLTexture2D(int width, int height, const void *data = nullptr)
+		OpenGLIndirectBuffer(long long _size, const void *data) : size(_size)
 		{
-			glActiveTexture(GL_TEXTURE0);
-			glGenTextures(1, &texture);
-			glBindTexture(GL_TEXTURE_2D, texture);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+			// Draw arguments are usually rewritten every frame
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, size, data, GL_DYNAMIC_DRAW);
 		}
 
-		virtual ~OpenGLTexture2D() override
+		virtual ~OpenGLIndirectBuffer() override
 		{
-			glDeleteTextures(1, &texture);
+			glDeleteBuffers(1, &buffer);
 		}
 
-		unsigned int texture = 0;
+		unsigned int buffer = 0;
+		long long size = 0;
+		bool mapped = false;
 	};
 
-	class OpenGLRasterState : public RasterState
+	class OpenGLUniformBuffer : public UniformBuffer
 	{
 	public:
 
-		OpenGLRasterState(bool _cullEnabled = true, Winding _frontFace = Winding::CCW, Face _cullFace = Face::Back, RasterMode _rasterMode = RasterMode::Fill)
+		OpenGLUniformBuffer(long long size, const void *data) : storage(size, data, BufferUsage::Dynamic)
 		{
-			static const GLenum toOpenGLFrontFace[] = { GL_CW, GL_CCW };
-			static const GLenum toOpenGLCullFace[] = { GL_FRONT, GL_BACK, GL_FRONT_AND_BACK };
-			static const GLenum toOpenGLRasterMode[] = { GL_POINT, GL_LINE, GL_FILL };
 
-			cullEnabled = _cullEnabled;
-			frontFace = toOpenGLFrontFace[static_cast<size_t>(_frontFace)];
-			cullFace = toOpenGLCullFace[static_cast<size_t>(_cullFace)];
-			polygonMode = toOpenGLRasterMode[static_cast<size_t>(_rasterMode)];
 		}
 
-		bool cullEnabled;
-		GLenum frontFace;
-		GLenum cullFace;
-		GLenum polygonMode;
+		OpenGLBuffer storage;
 	};
 
-	class OpenGLDepthStencilState : public DepthStencilState
+	void OpenGLPipeline::SetUniformBuffer(ParamID id, UniformBuffer * uniformBuffer, long long offset)
 	{
-	public:
-
-		OpenGLDepthStencilState(
-			bool			_depthEnabled = true,
-			bool			_depthWriteEnabled = true,
-			float			_depthNear = 0,
-			float			_depthFar = 1,
-			Compare			_depthCompare = Compare::Less,
-
-			bool			_frontFaceStencilEnabled = false,
-			Compare			_frontFaceStencilCompare = Compare::Always,
-			StencilAction	_frontFaceStencilFail = StencilAction::Keep,
-			StencilAction	_frontFaceStencilPass = StencilAction::Keep,
-			StencilAction	_frontFaceDepthFail = StencilAction::Keep,
-			int				_frontFaceRef = 0,
-			unsigned int	_frontFaceReadMask = 0xFFFFFFFF,
-			unsigned int	_frontFaceWriteMask = 0xFFFFFFFF,
-
-			bool			_backFaceStencilEnabled = false,
-			Compare			_backFaceStencilCompare = Compare::Always,
-			StencilAction	_backFaceStencilFail = StencilAction::Keep,
-			StencilAction	_backFaceStencilPass = StencilAction::Keep,
-			StencilAction	_backFaceDepthFail = StencilAction::Keep,
-			int				_backFaceRef = 0,
-			unsigned int	_backFaceReadMask = 0xFFFFFFFF,
-			unsigned int	_backFaceWriteMask = 0xFFFFFFFF)
+		// Blocks are only known once the program is linked
+		this->Poll(true);
 
-		{
-			static const GLenum toOpenGLCompare[] = { GL_NEVER, GL_LESS, GL_EQUAL, GL_LEQUAL, GL_GREATER, GL_NOTEQUAL, GL_GEQUAL, GL_ALWAYS };
-			static const GLenum toOpenGLStencil[] = { GL_KEEP, GL_ZERO, GL_REPLACE, GL_INCR, GL_INCR_WRAP, GL_DECR, GL_DECR_WRAP, GL_INVERT };
+		for (auto& block : blocks)
+			if (block.id == id)
+			{
+				OpenGLUniformBuffer* buffer = reinterpret_cast<OpenGLUniformBuffer*>(uniformBuffer);
+				if (buffer != nullptr && (offset < 0 || offset + static_cast<long long>(block.data.size()) > buffer->storage.size))
+				{
+					MAGMA_WARNING("Failed to set pipeline uniform buffer, the block doesn't fit in the buffer");
+					return;
+				}
+				block.buffer = buffer;
+				block.bufferOffset = offset;
+				// Going back to the params uploads them again
+				block.dirty = true;
+				return;
+			}
+		MAGMA_WARNING("Failed to set pipeline uniform buffer, no uniform block with this ID");
+	}
 
-			depthEnabled = _depthEnabled;
-			depthWriteEnabled = _depthWriteEnabled;
-			depthNear = _depthNear;
-			depthFar = _depthFar;
-			depthFunc = toOpenGLCompare[static_cast<size_t>(_depthCompare)];
-
-			frontFaceStencilEnabled = _frontFaceStencilEnabled;
-			frontStencilFunc = toOpenGLCompare[static_cast<size_t>(_frontFaceStencilCompare)];
-			frontFaceStencilFail = toOpenGLStencil[static_cast<size_t>(_frontFaceStencilFail)];
-			frontFaceStencilPass = toOpenGLStencil[static_cast<size_t>(_frontFaceStencilPass)];
-			frontFaceDepthFail = toOpenGLStencil[static_cast<size_t>(_frontFaceDepthFail)];
-			frontFaceRef = _frontFaceRef;
-			frontFaceReadMask = _frontFaceReadMask;
-			frontFaceWriteMask = _frontFaceWriteMask;
-
-			backFaceStencilEnabled = _backFaceStencilEnabled;
-			backStencilFunc = toOpenGLCompare[static_cast<size_t>(_backFaceStencilCompare)];
-			backFaceStencilFail = toOpenGLStencil[static_cast<size_t>(_backFaceStencilFail)];
-			backFaceStencilPass = toOpenGLStencil[static_cast<size_t>(_backFaceStencilPass)];
-			backFaceDepthFail = toOpenGLStencil[static_cast<size_t>(_backFaceDepthFail)];
-			backFaceRef = _backFaceRef;
-			backFaceReadMask = _backFaceReadMask;
-			backFaceWriteMask = _backFaceWriteMask;
-		}
-
-
-		bool depthEnabled;
-		bool depthWriteEnabled;
-		float depthNear;
-		float depthFar;
-		GLenum depthFunc;
-
-		bool frontFaceStencilEnabled;
-		GLenum	frontStencilFunc;
-		GLenum frontFaceStencilFail;
-		GLenum frontFaceStencilPass;
-		GLenum frontFaceDepthFail;
-		GLint frontFaceRef;
-		GLuint frontFaceReadMask;
-		GLuint frontFaceWriteMask;
-
-		bool backFaceStencilEnabled;
-		GLenum backStencilFunc;
-		GLenum backFaceStencilFail;
-		GLenum backFaceStencilPass;
-		GLenum backFaceDepthFail;
-		GLint backFaceRef;
-		GLuint backFaceReadMask;
-		GLuint backFaceWriteMask;
+	struct OpenGLFormat
+	{
+		GLenum internalFormat;
+		GLenum format;
+		GLenum type;
 	};
-}
 
-Magma::OpenGLRenderDevice::OpenGLRenderDevice()
-{
-	// Init glew
-	GLenum err = glewInit();
-	if (err != GLEW_OK)
+	static const OpenGLFormat& GetOpenGLFormat(TextureFormat textureFormat)
 	{
-		MAGMA_ERROR("Failed to init GLEW, error: " + std::string(reinterpret_cast<const char*>(glewGetErrorString(err))));
+		// Format and type are unused by compressed formats
+		static const OpenGLFormat toOpenGLFormat[] =
+		{
+			{ GL_R8, GL_RED, GL_UNSIGNED_BYTE },
+			{ GL_RG8, GL_RG, GL_UNSIGNED_BYTE },
+			{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+			{ GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE },
+			{ GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT },
+			{ GL_RGBA32F, GL_RGBA, GL_FLOAT },
+			{ GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT },
+			{ GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT },
+			{ GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT },
+			{ GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8 },
+			{ GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0 },
+			{ GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0 },
+			{ GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0 },
+			{ GL_COMPRESSED_RED_RGTC1, 0, 0 },
+			{ GL_COMPRESSED_RG_RGTC2, 0, 0 },
+			{ GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, 0, 0 },
+			{ GL_COMPRESSED_RGBA_BPTC_UNORM, 0, 0 },
+			{ GL_COMPRESSED_RGB8_ETC2, 0, 0 },
+			{ GL_COMPRESSED_RGBA8_ETC2_EAC, 0, 0 },
+		};
+		static_assert(sizeof(toOpenGLFormat) / sizeof(*toOpenGLFormat) == static_cast<size_t>(TextureFormat::Count), "Missing texture formats");
+		return toOpenGLFormat[static_cast<size_t>(textureFormat)];
 	}
-	else
+
+	// Size in bytes of the images supplied in a texture description
+	static long long GetTextureDataSize(const Texture2DDesc& desc)
 	{
-		std::cout << "GLEW successfully inited. Using GLEW " << glewGetString(GLEW_VERSION) << std::endl;
+		if (desc.data == nullptr)
+			return 0;
+
+		const int levels = desc.mipLevels > 0 ? desc.mipLevels : RenderDevice::GetFullMipLevels(desc.width, desc.height);
+		const int layers = desc.arrayLayers > 1 ? desc.arrayLayers : 1;
+		long long size = 0;
+		for (int layer = 0; layer < layers; ++layer)
+			for (int level = 0; level < (desc.generateMips ? 1 : levels); ++level)
+				if (desc.data[layer * levels + level] != nullptr)
+					size += RenderDevice::GetImageSize(desc.format, desc.width >> level > 0 ? desc.width >> level : 1, desc.height >> level > 0 ? desc.height >> level : 1);
+		return size;
 	}
 
-	// Set default raster state
-	m_defaultRasterState = dynamic_cast<OpenGLRasterState*>(CreateRasterState());
-	SetRasterState(m_defaultRasterState);
+	class OpenGLTexture2D : public Texture2D
+	{
+	public:
 
-	// Set default depth/stencil state
-	m_defaultDepthStencilState = dynamic_cast<OpenGLDepthStencilState*>(CreateDepthStencilState());
-	SetDepthStencilState(m_defaultDepthStencilState);
-}
+		// Allocates the texture and uploads the data in the description (if any)
+		OpenGLTexture2D(const Texture2DDesc& desc)
+		{
+			const OpenGLFormat& info = GetOpenGLFormat(desc.format);
+			internalFormat = info.internalFormat;
+			format = info.format;
+			type = info.type;
+			textureFormat = desc.format;
+			width = desc.width;
+			height = desc.height;
+			levels = desc.mipLevels > 0 ? desc.mipLevels : RenderDevice::GetFullMipLevels(desc.width, desc.height);
+			layers = desc.arrayLayers > 1 ? desc.arrayLayers : 1;
+			target = desc.arrayLayers > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
 
-VertexShader * Magma::OpenGLRenderDevice::CreateVertexShader(const char * code)
-{
-	return new OpenGLVertexShader(code);
-}
+			glActiveTexture(GL_TEXTURE0);
+			glGenTextures(1, &texture);
+			glBindTexture(target, texture);
+			glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+			glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
 
-void Magma::OpenGLRenderDevice::DestroyVertexShader(VertexShader * vertexShader)
-{
-	delete vertexShader;
-}
+			// Allocate every level at once when possible, making the texture immutable
+			if (GLEW_ARB_texture_storage)
+			{
+				if (target == GL_TEXTURE_2D_ARRAY)
+					glTexStorage3D(target, levels, internalFormat, width, height, layers);
+				else
+					glTexStorage2D(target, levels, internalFormat, width, height);
+			}
+			else
+			{
+				for (int level = 0; level < levels; ++level)
+				{
+					const GLsizei imageSize = static_cast<GLsizei>(this->GetImageSize(level));
+					if (target == GL_TEXTURE_2D_ARRAY)
+					{
+						if (this->IsCompressed())
+							glCompressedTexImage3D(target, level, internalFormat, this->GetWidth(level), this->GetHeight(level), layers, 0, imageSize * layers, nullptr);
+						else
+							glTexImage3D(target, level, internalFormat, this->GetWidth(level), this->GetHeight(level), layers, 0, format, type, nullptr);
+					}
+					else
+					{
+						if (this->IsCompressed())
+							glCompressedTexImage2D(target, level, internalFormat, this->GetWidth(level), this->GetHeight(level), 0, imageSize, nullptr);
+						else
+							glTexImage2D(target, level, internalFormat, this->GetWidth(level), this->GetHeight(level), 0, format, type, nullptr);
+					}
+				}
+			}
 
-PixelShader * Magma::OpenGLRenderDevice::CreatePixelShader(const char * code)
-{
-	return new OpenGLPixelShader(code);
-}
+			if (desc.data == nullptr)
+				return;
 
-void Magma::OpenGLRenderDevice::DestroyPixelShader(PixelShader * pixelShader)
-{
-	delete pixelShader;
-}
+			for (int layer = 0; layer < layers; ++layer)
+				for (int level = 0; level < (desc.generateMips ? 1 : levels); ++level)
+					if (desc.data[layer * levels + level] != nullptr)
+						this->UploadImage(level, layer, desc.data[layer * levels + level]);
 
-Pipeline * Magma::OpenGLRenderDevice::CreatePipeline(VertexShader * vertexShader, PixelShader * pixelShader)
-{
-	return new OpenGLPipeline(reinterpret_cast<OpenGLVertexShader*>(vertexShader), reinterpret_cast<OpenGLPixelShader*>(pixelShader));
+			if (desc.generateMips)
+				this->GenerateMips();
+		}
+
+		virtual ~OpenGLTexture2D() override
+		{
+			for (auto handle : handles)
+				glMakeTextureHandleNonResidentARB(handle);
+			glDeleteTextures(1, &texture);
+		}
+
+		inline bool IsCompressed() const { return textureFormat >= TextureFormat::BC1; }
+		inline int GetWidth(int level) const { return width >> level > 0 ? width >> level : 1; }
+		inline int GetHeight(int level) const { return height >> level > 0 ? height >> level : 1; }
+		inline long long GetImageSize(int level) const { return RenderDevice::GetImageSize(textureFormat, this->GetWidth(level), this->GetHeight(level)); }
+
+		// Uploads an image of a level and layer, the texture must be bound.
+		// With a pixel unpack buffer bound, data is an offset into that buffer.
+		void UploadImage(int level, int layer, const void* data)
+		{
+			const GLsizei imageSize = static_cast<GLsizei>(this->GetImageSize(level));
+			if (target == GL_TEXTURE_2D_ARRAY)
+			{
+				if (this->IsCompressed())
+					glCompressedTexSubImage3D(target, level, 0, 0, layer, this->GetWidth(level), this->GetHeight(level), 1, internalFormat, imageSize, data);
+				else
+					glTexSubImage3D(target, level, 0, 0, layer, this->GetWidth(level), this->GetHeight(level), 1, format, type, data);
+			}
+			else
+			{
+				if (this->IsCompressed())
+					glCompressedTexSubImage2D(target, level, 0, 0, this->GetWidth(level), this->GetHeight(level), internalFormat, imageSize, data);
+				else
+					glTexSubImage2D(target, level, 0, 0, this->GetWidth(level), this->GetHeight(level), format, type, data);
+			}
+		}
+
+		// Generates every mip level from level zero, the texture must be bound
+		void GenerateMips()
+		{
+			if (levels < 2)
+				return;
+			if (this->IsCompressed())
+				MAGMA_WARNING("Failed to generate texture mips, the texture format is compressed");
+			else
+				glGenerateMipmap(target);
+		}
+
+		unsigned int texture = 0;
+		GLenum target = GL_TEXTURE_2D;
+		GLenum internalFormat;
+		GLenum format;
+		GLenum type;
+		TextureFormat textureFormat;
+		int width;
+		int height;
+		int levels;
+		int layers;
+		// False while an asynchronous upload is in flight
+		bool ready = true;
+		// Resident bindless handles, one per sampler they were created with
+		std::vector<GLuint64> handles;
+	};
+
+	class OpenGLRenderTarget : public RenderTarget
+	{
+	public:
+		// Creates the framebuffer, leaving it bound
+		OpenGLRenderTarget(const RenderTargetDesc& desc)
+			: width(desc.width), height(desc.height), samples(desc.samples > 1 ? desc.samples : 1), colorCount(desc.colorCount)
+		{
+			glGenFramebuffers(1, &framebuffer);
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+			// Multisampled render targets render into renderbuffers, the textures are attached to the resolve framebuffer
+			GLenum drawBuffers[RenderTargetDesc::MaxColorAttachments];
+			for (unsigned int i = 0; i < colorCount; ++i)
+			{
+				OpenGLTexture2D* texture = reinterpret_cast<OpenGLTexture2D*>(desc.colorTextures[i]);
+				drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+				if (samples > 1)
+					this->AttachRenderbuffer(drawBuffers[i], texture->internalFormat);
+				else
+					AttachTexture(drawBuffers[i], texture);
+			}
+
+			TextureFormat depthFormat = desc.depthTexture != nullptr ? reinterpret_cast<OpenGLTexture2D*>(desc.depthTexture)->textureFormat : desc.depthFormat;
+			depthAttachment = depthFormat == TextureFormat::Depth24Stencil8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+			if (desc.depthTexture != nullptr && samples == 1)
+				AttachTexture(depthAttachment, reinterpret_cast<OpenGLTexture2D*>(desc.depthTexture));
+			else if (depthFormat != TextureFormat::Count)
+				this->AttachRenderbuffer(depthAttachment, GetOpenGLFormat(depthFormat).internalFormat);
+
+			this->SetDrawBuffers(drawBuffers);
+			complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+			if (samples > 1 && complete)
+			{
+				glGenFramebuffers(1, &resolveFramebuffer);
+				glBindFramebuffer(GL_FRAMEBUFFER, resolveFramebuffer);
+				for (unsigned int i = 0; i < colorCount; ++i)
+					AttachTexture(GL_COLOR_ATTACHMENT0 + i, reinterpret_cast<OpenGLTexture2D*>(desc.colorTextures[i]));
+				if (desc.depthTexture != nullptr)
+				{
+					AttachTexture(depthAttachment, reinterpret_cast<OpenGLTexture2D*>(desc.depthTexture));
+					resolveDepth = true;
+				}
+				this->SetDrawBuffers(drawBuffers);
+				complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+			}
+		}
+
+		virtual ~OpenGLRenderTarget() override
+		{
+			glDeleteFramebuffers(1, &framebuffer);
+			if (resolveFramebuffer != 0)
+				glDeleteFramebuffers(1, &resolveFramebuffer);
+			if (!renderbuffers.empty())
+				glDeleteRenderbuffers(static_cast<GLsizei>(renderbuffers.size()), renderbuffers.data());
+		}
+
+		// Attaches level 0 (and layer 0) of a texture to the bound framebuffer
+		static void AttachTexture(GLenum attachment, OpenGLTexture2D* texture)
+		{
+			if (texture->target == GL_TEXTURE_2D_ARRAY)
+				glFramebufferTextureLayer(GL_FRAMEBUFFER, attachment, texture->texture, 0, 0);
+			else
+				glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture->texture, 0);
+		}
+
+		void AttachRenderbuffer(GLenum attachment, GLenum internalFormat)
+		{
+			GLuint renderbuffer;
+			glGenRenderbuffers(1, &renderbuffer);
+			glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+			if (samples > 1)
+				glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, internalFormat, width, height);
+			else
+				glRenderbufferStorage(GL_RENDERBUFFER, internalFormat, width, height);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, renderbuffer);
+			renderbuffers.push_back(renderbuffer);
+		}
+
+		void SetDrawBuffers(const GLenum* drawBuffers)
+		{
+			if (colorCount > 0)
+			{
+				glDrawBuffers(colorCount, drawBuffers);
+				glReadBuffer(GL_COLOR_ATTACHMENT0);
+			}
+			else
+			{
+				// Depth only render targets (e.g. shadow maps)
+				glDrawBuffer(GL_NONE);
+				glReadBuffer(GL_NONE);
+			}
+		}
+
+		// Blits the multisampled buffers into the textures, binding the read and draw framebuffers
+		void Resolve()
+		{
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFramebuffer);
+			for (unsigned int i = 0; i < colorCount; ++i)
+			{
+				// Read and draw buffers are framebuffer state, blit one attachment at a time
+				glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+				glDrawBuffer(GL_COLOR_ATTACHMENT0 + i);
+				glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			}
+			if (resolveDepth)
+			{
+				const GLbitfield mask = depthAttachment == GL_DEPTH_STENCIL_ATTACHMENT ? GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT : GL_DEPTH_BUFFER_BIT;
+				glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, mask, GL_NEAREST);
+			}
+
+			// Restores the draw buffers of the resolve framebuffer and the read buffer of the multisampled one
+			GLenum drawBuffers[RenderTargetDesc::MaxColorAttachments];
+			for (unsigned int i = 0; i < colorCount; ++i)
+				drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+			this->SetDrawBuffers(drawBuffers);
+		}
+
+		unsigned int framebuffer = 0;
+		unsigned int resolveFramebuffer = 0;
+		std::vector<GLuint> renderbuffers;
+		int width;
+		int height;
+		int samples;
+		unsigned int colorCount;
+		GLenum depthAttachment = GL_DEPTH_ATTACHMENT;
+		bool resolveDepth = false;
+		bool complete = false;
+	};
+
+	class OpenGLSampler : public Sampler
+	{
+	public:
+
+		OpenGLSampler(const SamplerDesc& desc)
+		{
+			static const GLenum toOpenGLFilter[] = { GL_NEAREST, GL_LINEAR };
+			// Indexed by [min filter][mip filter]
+			static const GLenum toOpenGLMinFilter[2][2] =
+			{
+				{ GL_NEAREST_MIPMAP_NEAREST, GL_NEAREST_MIPMAP_LINEAR },
+				{ GL_LINEAR_MIPMAP_NEAREST, GL_LINEAR_MIPMAP_LINEAR },
+			};
+			static const GLenum toOpenGLWrap[] = { GL_REPEAT, GL_MIRRORED_REPEAT, GL_CLAMP_TO_EDGE };
+
+			glGenSamplers(1, &sampler);
+			glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, toOpenGLMinFilter[static_cast<size_t>(desc.minFilter)][static_cast<size_t>(desc.mipFilter)]);
+			glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, toOpenGLFilter[static_cast<size_t>(desc.magFilter)]);
+			glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, toOpenGLWrap[static_cast<size_t>(desc.wrapU)]);
+			glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, toOpenGLWrap[static_cast<size_t>(desc.wrapV)]);
+			if (desc.maxAnisotropy > 1.0f && GLEW_EXT_texture_filter_anisotropic)
+				glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, desc.maxAnisotropy);
+		}
+
+		virtual ~OpenGLSampler() override
+		{
+			glDeleteSamplers(1, &sampler);
+		}
+
+		unsigned int sampler = 0;
+	};
+
+	// Asynchronous upload of a texture or vertex buffer
+	struct OpenGLUpload
+	{
+		struct Image
+		{
+			int level;
+			int layer;
+			const void* source;
+			long long size;
+			// Offset from the start of the upload in the staging buffer
+			long long offset;
+		};
+
+		OpenGLTexture2D* texture = nullptr;
+		OpenGLVertexBuffer* vertexBuffer = nullptr;
+		bool generateMips = false;
+		std::vector<Image> images;
+		long long stagingOffset = 0;
+		long long stagingSize = 0;
+		// Set by the upload thread once every image was copied into the staging buffer
+		std::atomic<bool> staged;
+		bool transferred = false;
+		GLsync fence = nullptr;
+
+		OpenGLUpload() : staged(false) {}
+	};
+
+	// Stages uploads in a persistently mapped buffer from a dedicated upload thread, and transfers
+	// them from the staging buffer to their resources on the render thread, signaling them ready with fences
+	class OpenGLUploadQueue
+	{
+	public:
+		static const long long StagingSize = 32 * 1024 * 1024;
+		static const long long Alignment = 16;
+
+		OpenGLUploadQueue() : pool(1)
+		{
+			// Without persistent mapping uploads are done synchronously
+			if (!GLEW_ARB_buffer_storage)
+				return;
+
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glGenBuffers(1, &staging);
+			glBindBuffer(GL_COPY_READ_BUFFER, staging);
+			glBufferStorage(GL_COPY_READ_BUFFER, StagingSize, nullptr, flags);
+			mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, StagingSize, flags));
+		}
+
+		~OpenGLUploadQueue()
+		{
+			// The upload thread must be done with the staging buffer before it is unmapped
+			for (auto& upload : inFlight)
+			{
+				while (!upload->staged.load(std::memory_order_acquire))
+					std::this_thread::yield();
+				if (upload->fence != nullptr)
+					glDeleteSync(upload->fence);
+			}
+
+			if (mapped != nullptr)
+			{
+				glBindBuffer(GL_COPY_READ_BUFFER, staging);
+				glUnmapBuffer(GL_COPY_READ_BUFFER);
+				glDeleteBuffers(1, &staging);
+			}
+		}
+
+		// Checks if an upload of a certain size can be done asynchronously
+		inline bool CanUpload(long long size) const { return mapped != nullptr && size <= StagingSize; }
+
+		void Add(std::unique_ptr<OpenGLUpload> upload)
+		{
+			waiting.push_back(std::move(upload));
+			this->Stage();
+		}
+
+		// Forgets the uploads of a resource about to be destroyed
+		void Cancel(const void* resource)
+		{
+			for (auto it = waiting.begin(); it != waiting.end();)
+				if ((*it)->texture == resource || (*it)->vertexBuffer == resource)
+					it = waiting.erase(it);
+				else
+					++it;
+
+			for (auto& upload : inFlight)
+				if (upload->texture == resource || upload->vertexBuffer == resource)
+				{
+					// The caller may free the source data once the resource is destroyed
+					while (!upload->staged.load(std::memory_order_acquire))
+						std::this_thread::yield();
+					upload->texture = nullptr;
+					upload->vertexBuffer = nullptr;
+				}
+		}
+
+		void Process(OpenGLRenderDevice* device)
+		{
+			this->Stage();
+
+			// Transfer every staged upload and fence the transfer
+			for (auto& upload : inFlight)
+				if (!upload->transferred && upload->staged.load(std::memory_order_acquire))
+				{
+					this->Transfer(device, *upload);
+					upload->transferred = true;
+					upload->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				}
+
+			// Retire finished uploads in order, freeing their staging memory
+			while (!inFlight.empty())
+			{
+				OpenGLUpload& upload = *inFlight.front();
+				if (!upload.transferred || glClientWaitSync(upload.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+					break;
+				glDeleteSync(upload.fence);
+
+				if (upload.texture != nullptr)
+					upload.texture->ready = true;
+				if (upload.vertexBuffer != nullptr)
+					upload.vertexBuffer->ready = true;
+				inFlight.pop_front();
+			}
+		}
+
+	private:
+		// Allocates staging memory, in the order uploads are retired
+		bool Allocate(long long size, long long& offset)
+		{
+			if (inFlight.empty())
+				head = 0;
+			const long long tail = inFlight.empty() ? 0 : inFlight.front()->stagingOffset;
+
+			if (inFlight.empty() || head > tail)
+			{
+				if (head + size <= StagingSize)
+					offset = head;
+				else if (size < tail)
+					offset = 0;
+				else
+					return false;
+			}
+			else if (head + size < tail)
+				offset = head;
+			else
+				return false;
+
+			head = (offset + size + Alignment - 1) / Alignment * Alignment;
+			return true;
+		}
+
+		// Hands the waiting uploads which fit in the staging buffer to the upload thread
+		void Stage()
+		{
+			while (!waiting.empty())
+			{
+				long long offset;
+				if (!this->Allocate(waiting.front()->stagingSize, offset))
+					break;
+
+				OpenGLUpload* upload = waiting.front().get();
+				upload->stagingOffset = offset;
+				unsigned char* destination = mapped + offset;
+				pool.Submit([upload, destination]()
+				{
+					for (auto& image : upload->images)
+						memcpy(destination + image.offset, image.source, static_cast<size_t>(image.size));
+					upload->staged.store(true, std::memory_order_release);
+				});
+
+				inFlight.push_back(std::move(waiting.front()));
+				waiting.pop_front();
+			}
+		}
+
+		void Transfer(OpenGLRenderDevice* device, OpenGLUpload& upload)
+		{
+			if (upload.texture != nullptr)
+			{
+				const unsigned int boundTexture = device->m_textures[0], boundTarget = device->m_textureTargets[0];
+				device->BindTexture(0, upload.texture->texture, upload.texture->target);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+				for (auto& image : upload.images)
+					upload.texture->UploadImage(image.level, image.layer, reinterpret_cast<const void*>(upload.stagingOffset + image.offset));
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				if (upload.generateMips)
+					upload.texture->GenerateMips();
+				device->RestoreTexture(0, boundTexture, boundTarget);
+			}
+			else if (upload.vertexBuffer != nullptr)
+			{
+				glBindBuffer(GL_COPY_READ_BUFFER, staging);
+				glBindBuffer(GL_COPY_WRITE_BUFFER, upload.vertexBuffer->vbo);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, upload.stagingOffset, 0, upload.images[0].size);
+			}
+		}
+
+		JobPool pool;
+		unsigned int staging = 0;
+		unsigned char* mapped = nullptr;
+		long long head = 0;
+		std::deque<std::unique_ptr<OpenGLUpload>> waiting;
+		std::deque<std::unique_ptr<OpenGLUpload>> inFlight;
+	};
+
+	class OpenGLRasterState : public RasterState
+	{
+	public:
+
+		OpenGLRasterState(bool _cullEnabled = true, Winding _frontFace = Winding::CCW, Face _cullFace = Face::Back, RasterMode _rasterMode = RasterMode::Fill)
+		{
+			static const GLenum toOpenGLFrontFace[] = { GL_CW, GL_CCW };
+			static const GLenum toOpenGLCullFace[] = { GL_FRONT, GL_BACK, GL_FRONT_AND_BACK };
+			static const GLenum toOpenGLRasterMode[] = { GL_POINT, GL_LINE, GL_FILL };
+
+			state.cullEnabled = _cullEnabled;
+			state.frontFace = toOpenGLFrontFace[static_cast<size_t>(_frontFace)];
+			state.cullFace = toOpenGLCullFace[static_cast<size_t>(_cullFace)];
+			state.polygonMode = toOpenGLRasterMode[static_cast<size_t>(_rasterMode)];
+		}
+
+		OpenGLFixedState::Raster state;
+	};
+
+	class OpenGLDepthStencilState : public DepthStencilState
+	{
+	public:
+
+		OpenGLDepthStencilState(
+			bool			_depthEnabled = true,
+			bool			_depthWriteEnabled = true,
+			float			_depthNear = 0,
+			float			_depthFar = 1,
+			Compare			_depthCompare = Compare::Less,
+
+			bool			_frontFaceStencilEnabled = false,
+			Compare			_frontFaceStencilCompare = Compare::Always,
+			StencilAction	_frontFaceStencilFail = StencilAction::Keep,
+			StencilAction	_frontFaceStencilPass = StencilAction::Keep,
+			StencilAction	_frontFaceDepthFail = StencilAction::Keep,
+			int				_frontFaceRef = 0,
+			unsigned int	_frontFaceReadMask = 0xFFFFFFFF,
+			unsigned int	_frontFaceWriteMask = 0xFFFFFFFF,
+
+			bool			_backFaceStencilEnabled = false,
+			Compare			_backFaceStencilCompare = Compare::Always,
+			StencilAction	_backFaceStencilFail = StencilAction::Keep,
+			StencilAction	_backFaceStencilPass = StencilAction::Keep,
+			StencilAction	_backFaceDepthFail = StencilAction::Keep,
+			int				_backFaceRef = 0,
+			unsigned int	_backFaceReadMask = 0xFFFFFFFF,
+			unsigned int	_backFaceWriteMask = 0xFFFFFFFF)
+
+		{
+			static const GLenum toOpenGLCompare[] = { GL_NEVER, GL_LESS, GL_EQUAL, GL_LEQUAL, GL_GREATER, GL_NOTEQUAL, GL_GEQUAL, GL_ALWAYS };
+			static const GLenum toOpenGLStencil[] = { GL_KEEP, GL_ZERO, GL_REPLACE, GL_INCR, GL_INCR_WRAP, GL_DECR, GL_DECR_WRAP, GL_INVERT };
+
+			state.depthEnabled = _depthEnabled;
+			state.depthWriteEnabled = _depthWriteEnabled;
+			state.depthNear = _depthNear;
+			state.depthFar = _depthFar;
+			state.depthFunc = toOpenGLCompare[static_cast<size_t>(_depthCompare)];
+			state.stencilEnabled = _frontFaceStencilEnabled || _backFaceStencilEnabled;
+
+			state.front.func = toOpenGLCompare[static_cast<size_t>(_frontFaceStencilCompare)];
+			state.front.stencilFail = toOpenGLStencil[static_cast<size_t>(_frontFaceStencilFail)];
+			state.front.pass = toOpenGLStencil[static_cast<size_t>(_frontFaceStencilPass)];
+			state.front.depthFail = toOpenGLStencil[static_cast<size_t>(_frontFaceDepthFail)];
+			state.front.ref = _frontFaceRef;
+			state.front.readMask = _frontFaceReadMask;
+			state.front.writeMask = _frontFaceWriteMask;
+
+			state.back.func = toOpenGLCompare[static_cast<size_t>(_backFaceStencilCompare)];
+			state.back.stencilFail = toOpenGLStencil[static_cast<size_t>(_backFaceStencilFail)];
+			state.back.pass = toOpenGLStencil[static_cast<size_t>(_backFaceStencilPass)];
+			state.back.depthFail = toOpenGLStencil[static_cast<size_t>(_backFaceDepthFail)];
+			state.back.ref = _backFaceRef;
+			state.back.readMask = _backFaceReadMask;
+			state.back.writeMask = _backFaceWriteMask;
+		}
+
+		OpenGLFixedState::DepthStencil state;
+	};
+
+	class OpenGLBlendState : public BlendState
+	{
+	public:
+
+		OpenGLBlendState(bool _blendEnabled = false, BlendFactor _srcColor = BlendFactor::One, BlendFactor _dstColor = BlendFactor::Zero, BlendOp _colorOp = BlendOp::Add,
+						 BlendFactor _srcAlpha = BlendFactor::One, BlendFactor _dstAlpha = BlendFactor::Zero, BlendOp _alphaOp = BlendOp::Add, unsigned int _colorWriteMask = ColorWriteAll)
+		{
+			static const GLenum toOpenGLBlendFactor[] = { GL_ZERO, GL_ONE, GL_SRC_COLOR, GL_ONE_MINUS_SRC_COLOR, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+														  GL_DST_COLOR, GL_ONE_MINUS_DST_COLOR, GL_DST_ALPHA, GL_ONE_MINUS_DST_ALPHA };
+			static const GLenum toOpenGLBlendOp[] = { GL_FUNC_ADD, GL_FUNC_SUBTRACT, GL_FUNC_REVERSE_SUBTRACT, GL_MIN, GL_MAX };
+
+			state.enabled = _blendEnabled;
+			state.srcColor = toOpenGLBlendFactor[static_cast<size_t>(_srcColor)];
+			state.dstColor = toOpenGLBlendFactor[static_cast<size_t>(_dstColor)];
+			state.colorOp = toOpenGLBlendOp[static_cast<size_t>(_colorOp)];
+			state.srcAlpha = toOpenGLBlendFactor[static_cast<size_t>(_srcAlpha)];
+			state.dstAlpha = toOpenGLBlendFactor[static_cast<size_t>(_dstAlpha)];
+			state.alphaOp = toOpenGLBlendOp[static_cast<size_t>(_alphaOp)];
+			state.writeMask = _colorWriteMask & ColorWriteAll;
+		}
+
+		OpenGLFixedState::Blend state;
+	};
+
+	class OpenGLPipelineState : public PipelineState
+	{
+	public:
+
+		OpenGLPipelineState(OpenGLPipeline* _pipeline, const OpenGLFixedState& _state) : pipeline(_pipeline), state(_state)
+		{
+			static unsigned long long nextSerial = 1;
+			serial = nextSerial++;
+		}
+
+		OpenGLPipeline* pipeline;
+		OpenGLFixedState state;
+		// Never reused, so that transitions from destroyed pipeline states are never mistaken for new ones
+		unsigned long long serial = 0;
+		// Groups which change when switching from other pipeline states, by serial, computed on the first switch
+		std::unordered_map<unsigned long long, unsigned int> transitions;
+	};
+}
+
+unsigned int Magma::OpenGLFixedState::Diff(const OpenGLFixedState & lhs, const OpenGLFixedState & rhs)
+{
+	const Raster& r0 = lhs.raster, & r1 = rhs.raster;
+	const DepthStencil& d0 = lhs.depthStencil, & d1 = rhs.depthStencil;
+	const Blend& b0 = lhs.blend, & b1 = rhs.blend;
+
+	unsigned int groups = 0;
+	groups |= r0.cullEnabled != r1.cullEnabled ? CullEnable : 0;
+	groups |= r0.frontFace != r1.frontFace ? FrontFace : 0;
+	groups |= r0.cullFace != r1.cullFace ? CullFace : 0;
+	groups |= r0.polygonMode != r1.polygonMode ? PolygonMode : 0;
+
+	groups |= d0.depthEnabled != d1.depthEnabled ? DepthTest : 0;
+	groups |= d0.depthFunc != d1.depthFunc ? DepthFunc : 0;
+	groups |= d0.depthWriteEnabled != d1.depthWriteEnabled ? DepthMask : 0;
+	groups |= d0.depthNear != d1.depthNear || d0.depthFar != d1.depthFar ? DepthRange : 0;
+	groups |= d0.stencilEnabled != d1.stencilEnabled ? StencilTest : 0;
+	groups |= d0.front.func != d1.front.func || d0.front.ref != d1.front.ref || d0.front.readMask != d1.front.readMask ? FrontStencilFunc : 0;
+	groups |= d0.front.writeMask != d1.front.writeMask ? FrontStencilMask : 0;
+	groups |= d0.front.stencilFail != d1.front.stencilFail || d0.front.depthFail != d1.front.depthFail || d0.front.pass != d1.front.pass ? FrontStencilOp : 0;
+	groups |= d0.back.func != d1.back.func || d0.back.ref != d1.back.ref || d0.back.readMask != d1.back.readMask ? BackStencilFunc : 0;
+	groups |= d0.back.writeMask != d1.back.writeMask ? BackStencilMask : 0;
+	groups |= d0.back.stencilFail != d1.back.stencilFail || d0.back.depthFail != d1.back.depthFail || d0.back.pass != d1.back.pass ? BackStencilOp : 0;
+
+	groups |= b0.enabled != b1.enabled ? BlendEnable : 0;
+	groups |= b0.srcColor != b1.srcColor || b0.dstColor != b1.dstColor || b0.srcAlpha != b1.srcAlpha || b0.dstAlpha != b1.dstAlpha ? BlendFunc : 0;
+	groups |= b0.colorOp != b1.colorOp || b0.alphaOp != b1.alphaOp ? BlendEquation : 0;
+	groups |= b0.writeMask != b1.writeMask ? ColorMask : 0;
+	return groups;
+}
+
+namespace Magma
+{
+	// Measures the GPU time of every frame and scope with timestamp queries.
+	// Results are read back a few frames later, once available, so that the CPU never waits for the GPU.
+	class OpenGLTimerQueries
+	{
+	public:
+		// Frames whose queries may be in flight before the results of the oldest one are waited for
+		static const size_t MaxFramesInFlight = 4;
+
+		OpenGLTimerQueries()
+		{
+			current.begin = this->Timestamp();
+		}
+
+		~OpenGLTimerQueries()
+		{
+			inFlight.push_back(std::move(current));
+			for (auto& frame : inFlight)
+			{
+				this->Release(frame.begin);
+				this->Release(frame.end);
+				for (auto& scope : frame.scopes)
+				{
+					this->Release(scope.begin);
+					this->Release(scope.end);
+				}
+			}
+			if (!pool.empty())
+				glDeleteQueries(static_cast<GLsizei>(pool.size()), pool.data());
+		}
+
+		void BeginScope(unsigned int index)
+		{
+			current.scopes.push_back({ index, this->Timestamp(), 0 });
+			open.push_back(current.scopes.size() - 1);
+		}
+
+		void EndScope()
+		{
+			if (open.empty())
+				return;
+			current.scopes[open.back()].end = this->Timestamp();
+			open.pop_back();
+		}
+
+		// Ends the queries of a frame and hands the results of the finished frames to the profiler
+		void EndFrame(unsigned long long number, FrameProfiler& profiler)
+		{
+			while (!open.empty())
+				this->EndScope();
+			current.number = number;
+			current.end = this->Timestamp();
+			inFlight.push_back(std::move(current));
+			current = Frame();
+			current.begin = this->Timestamp();
+
+			while (!inFlight.empty())
+			{
+				Frame& frame = inFlight.front();
+				// Timestamps are written in order, so when the frame's last one is available so are the others
+				GLint available = GL_FALSE;
+				glGetQueryObjectiv(frame.end, GL_QUERY_RESULT_AVAILABLE, &available);
+				if (available == GL_FALSE && inFlight.size() <= MaxFramesInFlight)
+					break;
+
+				profiler.SetGPUTime(frame.number, FrameProfiler::InvalidScope, this->Elapsed(frame.begin, frame.end));
+				for (auto& scope : frame.scopes)
+				{
+					profiler.SetGPUTime(frame.number, scope.index, this->Elapsed(scope.begin, scope.end));
+					this->Release(scope.begin);
+					this->Release(scope.end);
+				}
+				this->Release(frame.begin);
+				this->Release(frame.end);
+				inFlight.pop_front();
+			}
+		}
+
+		struct Scope
+		{
+			unsigned int index;
+			GLuint begin;
+			GLuint end;
+		};
+
+		struct Frame
+		{
+			unsigned long long number = 0;
+			GLuint begin = 0;
+			GLuint end = 0;
+			std::vector<Scope> scopes;
+		};
+
+		GLuint Timestamp()
+		{
+			GLuint query;
+			if (pool.empty())
+				glGenQueries(1, &query);
+			else
+			{
+				query = pool.back();
+				pool.pop_back();
+			}
+			glQueryCounter(query, GL_TIMESTAMP);
+			return query;
+		}
+
+		void Release(GLuint query)
+		{
+			if (query != 0)
+				pool.push_back(query);
+		}
+
+		double Elapsed(GLuint begin, GLuint end)
+		{
+			GLuint64 beginTime = 0, endTime = 0;
+			glGetQueryObjectui64v(begin, GL_QUERY_RESULT, &beginTime);
+			glGetQueryObjectui64v(end, GL_QUERY_RESULT, &endTime);
+			return static_cast<double>(endTime - beginTime) / 1000000.0;
+		}
+
+		Frame current;
+		// Indices in current.scopes of the open scopes
+		std::vector<size_t> open;
+		std::deque<Frame> inFlight;
+		std::vector<GLuint> pool;
+	};
+}
+
+Magma::OpenGLRenderDevice::OpenGLRenderDevice()
+{
+	// Init glew
+	GLenum err = glewInit();
+	if (err != GLEW_OK)
+	{
+		MAGMA_ERROR("Failed to init GLEW, error: " + std::string(reinterpret_cast<const char*>(glewGetErrorString(err))));
+	}
+	else
+	{
+		std::cout << "GLEW successfully inited. Using GLEW " << glewGetString(GLEW_VERSION) << std::endl;
+	}
+
+	for (unsigned int i = 0; i < MaxTextureSlots; ++i)
+	{
+		m_textures[i] = UnknownBinding;
+		m_textureTargets[i] = 0;
+	}
+	for (unsigned int i = 0; i < MaxUniformBindings; ++i)
+	{
+		m_uniformBuffers[i] = UnknownBinding;
+		m_uniformRanges[i][0] = m_uniformRanges[i][1] = -1;
+	}
+
+	m_uniformRing = new OpenGLUniformRing();
+
+	if (GLEW_KHR_parallel_shader_compile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+	// Pipeline binaries are only valid on the driver which built them
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+	{
+		const GLubyte* str = glGetString(name);
+		if (str != nullptr)
+			m_driver += reinterpret_cast<const char*>(str);
+		m_driver += '\n';
+	}
+	m_uploadQueue = new OpenGLUploadQueue();
+
+	if (GLEW_ARB_timer_query)
+		m_timerQueries = new OpenGLTimerQueries();
+	else
+		MAGMA_WARNING("Timer queries aren't supported, GPU timings won't be available");
+
+	// Rows of texture data are tightly packed
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	// Bind the default sampler to every slot
+	m_defaultSampler = this->CreateSampler(SamplerDesc());
+	for (unsigned int i = 0; i < MaxTextureSlots; ++i)
+	{
+		m_samplers[i] = UnknownBinding;
+		this->SetSampler(i, nullptr);
+	}
+
+	// Set the default raster, depth/stencil and blend states, issuing every call as the GL state isn't known yet
+	m_defaultRasterState = dynamic_cast<OpenGLRasterState*>(CreateRasterState());
+	m_defaultDepthStencilState = dynamic_cast<OpenGLDepthStencilState*>(CreateDepthStencilState());
+	m_defaultBlendState = dynamic_cast<OpenGLBlendState*>(CreateBlendState());
+	m_rasterState = m_defaultRasterState;
+	m_depthStencilState = m_defaultDepthStencilState;
+	m_blendState = m_defaultBlendState;
+	OpenGLFixedState state;
+	state.raster = m_rasterState->state;
+	state.depthStencil = m_depthStencilState->state;
+	state.blend = m_blendState->state;
+	this->ApplyFixedState(state, OpenGLFixedState::AllGroups);
+}
+
+Magma::OpenGLRenderDevice::~OpenGLRenderDevice()
+{
+	delete m_timerQueries;
+	delete m_uploadQueue;
+	delete m_uniformRing;
+	delete m_defaultSampler;
+	delete m_defaultRasterState;
+	delete m_defaultDepthStencilState;
+	delete m_defaultBlendState;
+}
+
+VertexShader * Magma::OpenGLRenderDevice::CreateVertexShader(const char * code)
+{
+	return new OpenGLVertexShader(code);
+}
+
+void Magma::OpenGLRenderDevice::DestroyVertexShader(VertexShader * vertexShader)
+{
+	delete vertexShader;
+}
+
+PixelShader * Magma::OpenGLRenderDevice::CreatePixelShader(const char * code)
+{
+	return new OpenGLPixelShader(code);
+}
+
+void Magma::OpenGLRenderDevice::DestroyPixelShader(PixelShader * pixelShader)
+{
+	delete pixelShader;
+}
+
+Pipeline * Magma::OpenGLRenderDevice::CreatePipeline(VertexShader * vertexShader, PixelShader * pixelShader)
+{
+	OpenGLPipeline* pipeline = new OpenGLPipeline(reinterpret_cast<OpenGLVertexShader*>(vertexShader), reinterpret_cast<OpenGLPixelShader*>(pixelShader),
+												  m_pipelineCache, m_driver, GLEW_KHR_parallel_shader_compile != 0);
+	if (!pipeline->IsDone())
+		m_pendingPipelines.push_back(pipeline);
+	return pipeline;
+}
+
+bool Magma::OpenGLRenderDevice::IsPipelineReady(Pipeline * pipeline)
+{
+	return reinterpret_cast<OpenGLPipeline*>(pipeline)->Poll(false);
+}
+
+void Magma::OpenGLRenderDevice::DestroyPipeline(Pipeline * pipeline)
+{
+	m_pendingPipelines.erase(std::remove(m_pendingPipelines.begin(), m_pendingPipelines.end(), pipeline), m_pendingPipelines.end());
+	if (pipeline != nullptr && m_pipeline == pipeline)
+	{
+		m_program = UnknownBinding;
+		m_pipeline = nullptr;
+	}
+	delete pipeline;
+}
+
+void Magma::OpenGLRenderDevice::SetPipelineCache(PipelineCache * pipelineCache)
+{
+	m_pipelineCache = pipelineCache;
+}
+
+void Magma::OpenGLRenderDevice::SetPipeline(Pipeline * pipeline)
+{
+	// Pipelines which aren't ready yet are bound by the first draw after they are
+	m_pipeline = reinterpret_cast<OpenGLPipeline*>(pipeline);
+	if (m_pipeline == nullptr || m_pipeline->state == OpenGLPipeline::State::Ready)
+		this->BindProgram(m_pipeline ? m_pipeline->shaderProgram : 0);
+}
+
+VertexBuffer * Magma::OpenGLRenderDevice::CreateVertexBuffer(long long size, const void * data, BufferUsage usage)
+{
+	if (data != nullptr)
+		m_profiler.CountUpload(size);
+	return new OpenGLVertexBuffer(size, data, usage);
+}
+
+void Magma::OpenGLRenderDevice::DestroyVertexBuffer(VertexBuffer * vertexBuffer)
+{
+	if (vertexBuffer != nullptr && !reinterpret_cast<OpenGLVertexBuffer *>(vertexBuffer)->ready)
+		m_uploadQueue->Cancel(vertexBuffer);
+	delete vertexBuffer;
+}
+
+VertexBuffer * Magma::OpenGLRenderDevice::CreateVertexBufferAsync(long long size, const void * data, BufferUsage usage)
+{
+	if (data == nullptr || !m_uploadQueue->CanUpload(size))
+		return this->CreateVertexBuffer(size, data, usage);
+
+	m_profiler.CountUpload(size);
+
+	OpenGLVertexBuffer* vertexBuffer = new OpenGLVertexBuffer(size, nullptr, usage);
+	vertexBuffer->ready = false;
+
+	std::unique_ptr<OpenGLUpload> upload(new OpenGLUpload());
+	upload->vertexBuffer = vertexBuffer;
+	upload->images.push_back({ 0, 0, data, size, 0 });
+	upload->stagingSize = size;
+	m_uploadQueue->Add(std::move(upload));
+	return vertexBuffer;
+}
+
+bool Magma::OpenGLRenderDevice::IsVertexBufferReady(VertexBuffer * vertexBuffer)
+{
+	return reinterpret_cast<OpenGLVertexBuffer *>(vertexBuffer)->ready;
+}
+
+void Magma::OpenGLRenderDevice::UpdateVertexBuffer(VertexBuffer * vertexBuffer, long long offset, long long size, const void * data)
+{
+	if (reinterpret_cast<OpenGLVertexBuffer *>(vertexBuffer)->storage.Update(offset, size, data))
+		m_profiler.CountUpload(size);
+}
+
+void * Magma::OpenGLRenderDevice::MapVertexBuffer(VertexBuffer * vertexBuffer, long long offset, long long size)
+{
+	return reinterpret_cast<OpenGLVertexBuffer *>(vertexBuffer)->storage.Map(offset, size);
+}
+
+void Magma::OpenGLRenderDevice::UnmapVertexBuffer(VertexBuffer * vertexBuffer)
+{
+	m_profiler.CountUpload(reinterpret_cast<OpenGLVertexBuffer *>(vertexBuffer)->storage.Unmap());
+}
+
+long long Magma::OpenGLRenderDevice::AdvanceVertexBuffer(VertexBuffer * vertexBuffer)
+{
+	return reinterpret_cast<OpenGLVertexBuffer *>(vertexBuffer)->storage.Advance();
+}
+
+VertexDescription * Magma::OpenGLRenderDevice::CreateVertexDescription(unsigned int numVertexElements, const VertexElement * vertexElements)
+{
+	return new OpenGLVertexDescription(numVertexElements, vertexElements);
+}
+
+void Magma::OpenGLRenderDevice::DestroyVertexDescription(VertexDescription * vertexDescription)
+{
+	delete vertexDescription;
+}
+
+VertexArray * Magma::OpenGLRenderDevice::CreateVertexArray(unsigned int numVertexBuffers, VertexBuffer ** vertexBuffers, VertexDescription ** vertexDescriptions)
+{
+	OpenGLVertexArray* vertexArray = new OpenGLVertexArray(numVertexBuffers, vertexBuffers, vertexDescriptions);
+	// The constructor leaves the new vertex array bound
+	m_vertexArray = vertexArray->vao;
+	m_vertexArrayObject = vertexArray;
+	return vertexArray;
+}
+
+void Magma::OpenGLRenderDevice::DestroyVertexArray(VertexArray * vertexArray)
+{
+	if (vertexArray != nullptr && m_vertexArrayObject == vertexArray)
+	{
+		m_vertexArray = UnknownBinding;
+		m_vertexArrayObject = nullptr;
+	}
+	delete vertexArray;
+}
+
+void Magma::OpenGLRenderDevice::SetVertexArray(VertexArray * vertexArray)
+{
+	this->BindVertexArray(reinterpret_cast<OpenGLVertexArray *>(vertexArray));
+}
+
+IndexBuffer * Magma::OpenGLRenderDevice::CreateIndexBuffer(long long size, const void * data, BufferUsage usage, IndexFormat format)
+{
+	if (data != nullptr)
+		m_profiler.CountUpload(size);
+	return new OpenGLIndexBuffer(size, data, usage, format);
+}
+
+void Magma::OpenGLRenderDevice::DestroyIndexBuffer(IndexBuffer * indexBuffer)
+{
+	delete indexBuffer;
+}
+
+void Magma::OpenGLRenderDevice::UpdateIndexBuffer(IndexBuffer * indexBuffer, long long offset, long long size, const void * data)
+{
+	if (reinterpret_cast<OpenGLIndexBuffer *>(indexBuffer)->storage.Update(offset, size, data))
+		m_profiler.CountUpload(size);
+}
+
+void * Magma::OpenGLRenderDevice::MapIndexBuffer(IndexBuffer * indexBuffer, long long offset, long long size)
+{
+	return reinterpret_cast<OpenGLIndexBuffer *>(indexBuffer)->storage.Map(offset, size);
+}
+
+void Magma::OpenGLRenderDevice::UnmapIndexBuffer(IndexBuffer * indexBuffer)
+{
+	m_profiler.CountUpload(reinterpret_cast<OpenGLIndexBuffer *>(indexBuffer)->storage.Unmap());
+}
+
+long long Magma::OpenGLRenderDevice::AdvanceIndexBuffer(IndexBuffer * indexBuffer)
+{
+	return reinterpret_cast<OpenGLIndexBuffer *>(indexBuffer)->storage.Advance();
+}
+
+void Magma::OpenGLRenderDevice::SetIndexBuffer(IndexBuffer * indexBuffer)
+{
+	if (indexBuffer == nullptr)
+		this->BindIndexBuffer(0, 0);
+	else
+	{
+		OpenGLIndexBuffer* buffer = reinterpret_cast<OpenGLIndexBuffer *>(indexBuffer);
+		this->BindIndexBuffer(buffer->ibo, buffer->serial);
+		if (m_vertexArrayObject != nullptr)
+			m_vertexArrayObject->indexType = buffer->type;
+	}
+}
+
+IndirectBuffer * Magma::OpenGLRenderDevice::CreateIndirectBuffer(long long size, const void * data)
+{
+	OpenGLIndirectBuffer* indirectBuffer = new OpenGLIndirectBuffer(size, data);
+	// The constructor leaves the new buffer bound
+	m_indirectBuffer = indirectBuffer->buffer;
+	return indirectBuffer;
+}
+
+void Magma::OpenGLRenderDevice::DestroyIndirectBuffer(IndirectBuffer * indirectBuffer)
+{
+	if (indirectBuffer != nullptr && m_indirectBuffer == reinterpret_cast<OpenGLIndirectBuffer *>(indirectBuffer)->buffer)
+		m_indirectBuffer = UnknownBinding;
+	delete indirectBuffer;
+}
+
+void * Magma::OpenGLRenderDevice::MapIndirectBuffer(IndirectBuffer * indirectBuffer)
+{
+	OpenGLIndirectBuffer* buffer = reinterpret_cast<OpenGLIndirectBuffer *>(indirectBuffer);
+	if (buffer->mapped)
+	{
+		MAGMA_WARNING("Failed to map indirect buffer, it is already mapped");
+		return nullptr;
+	}
+
+	this->BindIndirectBuffer(buffer->buffer);
+	// Invalidating lets the driver hand out new memory instead of waiting for draws still reading the buffer
+	void* data = glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, buffer->size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	buffer->mapped = data != nullptr;
+	return data;
+}
+
+void Magma::OpenGLRenderDevice::UnmapIndirectBuffer(IndirectBuffer * indirectBuffer)
+{
+	OpenGLIndirectBuffer* buffer = reinterpret_cast<OpenGLIndirectBuffer *>(indirectBuffer);
+	if (!buffer->mapped)
+	{
+		MAGMA_WARNING("Failed to unmap indirect buffer, it isn't mapped");
+		return;
+	}
+
+	this->BindIndirectBuffer(buffer->buffer);
+	glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
+	buffer->mapped = false;
+	m_profiler.CountUpload(buffer->size);
+}
+
+UniformBuffer * Magma::OpenGLRenderDevice::CreateUniformBuffer(long long size, const void * data)
+{
+	if (data != nullptr)
+		m_profiler.CountUpload(size);
+	return new OpenGLUniformBuffer(size, data);
+}
+
+void Magma::OpenGLRenderDevice::DestroyUniformBuffer(UniformBuffer * uniformBuffer)
+{
+	if (uniformBuffer != nullptr)
+		for (unsigned int i = 0; i < MaxUniformBindings; ++i)
+			if (m_uniformBuffers[i] == reinterpret_cast<OpenGLUniformBuffer *>(uniformBuffer)->storage.buffer)
+				m_uniformBuffers[i] = UnknownBinding;
+	delete uniformBuffer;
+}
+
+void Magma::OpenGLRenderDevice::UpdateUniformBuffer(UniformBuffer * uniformBuffer, long long offset, long long size, const void * data)
+{
+	if (reinterpret_cast<OpenGLUniformBuffer *>(uniformBuffer)->storage.Update(offset, size, data))
+		m_profiler.CountUpload(size);
+}
+
+Texture2D * Magma::OpenGLRenderDevice::CreateTexture2D(const Texture2DDesc & desc)
+{
+	m_profiler.CountUpload(GetTextureDataSize(desc));
+	// Clear slot 0 first, the constructor binds the new texture to it without unbinding textures of other targets
+	const unsigned int boundTexture = m_textures[0], boundTarget = m_textureTargets[0];
+	this->BindTexture(0, 0, GL_TEXTURE_2D);
+	OpenGLTexture2D* texture = new OpenGLTexture2D(desc);
+	m_activeTexture = 0;
+	m_textures[0] = texture->texture;
+	m_textureTargets[0] = texture->target;
+	this->RestoreTexture(0, boundTexture, boundTarget);
+	return texture;
+}
+
+void Magma::OpenGLRenderDevice::DestroyTexture2D(Texture2D * texture2D)
+{
+	if (texture2D != nullptr && !reinterpret_cast<OpenGLTexture2D *>(texture2D)->ready)
+		m_uploadQueue->Cancel(texture2D);
+	if (texture2D != nullptr)
+		for (unsigned int i = 0; i < MaxTextureSlots; ++i)
+			if (m_textures[i] == reinterpret_cast<OpenGLTexture2D *>(texture2D)->texture)
+			{
+				// Deleting the texture unbinds it
+				m_textures[i] = UnknownBinding;
+				m_textureTargets[i] = 0;
+			}
+	delete texture2D;
+}
+
+void Magma::OpenGLRenderDevice::SetTexture2D(unsigned int slot, Texture2D * texture2D)
+{
+	if (slot >= MaxTextureSlots)
+	{
+		MAGMA_WARNING("Failed to set 2D texture, slot " + std::to_string(slot) + " is out of range");
+		return;
+	}
+
+	// Textures still being uploaded are left unbound
+	OpenGLTexture2D* texture = reinterpret_cast<OpenGLTexture2D *>(texture2D);
+	if (texture != nullptr && !texture->ready)
+		texture = nullptr;
+	this->BindTexture(slot, texture ? texture->texture : 0, texture ? texture->target : GL_TEXTURE_2D);
+}
+
+Texture2D * Magma::OpenGLRenderDevice::CreateTexture2DAsync(const Texture2DDesc & desc)
+{
+	m_profiler.CountUpload(GetTextureDataSize(desc));
+	std::unique_ptr<OpenGLUpload> upload(new OpenGLUpload());
+	upload->generateMips = desc.generateMips;
+
+	// Allocate the texture without data and lay its images out in the staging buffer
+	Texture2DDesc storageDesc = desc;
+	storageDesc.data = nullptr;
+	const unsigned int boundTexture = m_textures[0], boundTarget = m_textureTargets[0];
+	this->BindTexture(0, 0, GL_TEXTURE_2D);
+	OpenGLTexture2D* texture = new OpenGLTexture2D(storageDesc);
+	m_activeTexture = 0;
+	m_textures[0] = texture->texture;
+	m_textureTargets[0] = texture->target;
+
+	if (desc.data != nullptr)
+		for (int layer = 0; layer < texture->layers; ++layer)
+			for (int level = 0; level < (desc.generateMips ? 1 : texture->levels); ++level)
+			{
+				const void* source = desc.data[layer * texture->levels + level];
+				if (source == nullptr)
+					continue;
+				const long long size = texture->GetImageSize(level);
+				upload->images.push_back({ level, layer, source, size, upload->stagingSize });
+				upload->stagingSize += (size + OpenGLUploadQueue::Alignment - 1) / OpenGLUploadQueue::Alignment * OpenGLUploadQueue::Alignment;
+			}
+
+	if (upload->images.empty())
+	{
+		if (desc.generateMips)
+			texture->GenerateMips();
+		this->RestoreTexture(0, boundTexture, boundTarget);
+		return texture;
+	}
+
+	if (!m_uploadQueue->CanUpload(upload->stagingSize))
+	{
+		// Fall back to a synchronous upload
+		for (auto& image : upload->images)
+			texture->UploadImage(image.level, image.layer, image.source);
+		if (desc.generateMips)
+			texture->GenerateMips();
+		this->RestoreTexture(0, boundTexture, boundTarget);
+		return texture;
+	}
+
+	this->RestoreTexture(0, boundTexture, boundTarget);
+	texture->ready = false;
+	upload->texture = texture;
+	m_uploadQueue->Add(std::move(upload));
+	return texture;
 }
 
-void Magma::OpenGLRenderDevice::DestroyPipeline(Pipeline * pipeline)
+bool Magma::OpenGLRenderDevice::IsTexture2DReady(Texture2D * texture2D)
 {
-	delete pipeline;
+	return reinterpret_cast<OpenGLTexture2D *>(texture2D)->ready;
 }
 
-void Magma::OpenGLRenderDevice::SetPipeline(Pipeline * pipeline)
+void Magma::OpenGLRenderDevice::UpdateTexture2D(Texture2D * texture2D, int layer, int level, const void * data, bool generateMips)
 {
-	glUseProgram(reinterpret_cast<OpenGLPipeline*>(pipeline)->shaderProgram);
+	OpenGLTexture2D* texture = reinterpret_cast<OpenGLTexture2D *>(texture2D);
+	if (layer < 0 || layer >= texture->layers || level < 0 || level >= texture->levels)
+	{
+		MAGMA_WARNING("Failed to update 2D texture, layer " + std::to_string(layer) + " level " + std::to_string(level) + " is out of range");
+		return;
+	}
+	if (!texture->ready)
+	{
+		MAGMA_WARNING("Failed to update 2D texture, it is still being uploaded");
+		return;
+	}
+
+	// Keep the texture set on slot 0 for the next draws, it may be updated in the middle of a frame
+	const unsigned int boundTexture = m_textures[0], boundTarget = m_textureTargets[0];
+	this->BindTexture(0, texture->texture, texture->target);
+	texture->UploadImage(level, layer, data);
+	if (generateMips)
+		texture->GenerateMips();
+	this->RestoreTexture(0, boundTexture, boundTarget);
+	m_profiler.CountUpload(texture->GetImageSize(level));
 }
 
-VertexBuffer * Magma::OpenGLRenderDevice::CreateVertexBuffer(long long size, const void * data)
+unsigned long long Magma::OpenGLRenderDevice::GetTexture2DHandle(Texture2D * texture2D, Sampler * sampler)
 {
-	return new OpenGLVertexBuffer(size, data);
+	if (!GLEW_ARB_bindless_texture)
+		return 0;
+
+	OpenGLTexture2D* texture = reinterpret_cast<OpenGLTexture2D *>(texture2D);
+	const GLuint64 handle = glGetTextureSamplerHandleARB(texture->texture, reinterpret_cast<OpenGLSampler *>(sampler ? sampler : m_defaultSampler)->sampler);
+	if (std::find(texture->handles.begin(), texture->handles.end(), handle) == texture->handles.end())
+	{
+		glMakeTextureHandleResidentARB(handle);
+		texture->handles.push_back(handle);
+	}
+	return handle;
 }
 
-void Magma::OpenGLRenderDevice::DestroyVertexBuffer(VertexBuffer * vertexBuffer)
+Sampler * Magma::OpenGLRenderDevice::CreateSampler(const SamplerDesc & desc)
 {
-	delete vertexBuffer;
+	return new OpenGLSampler(desc);
 }
 
-VertexDescription * Magma::OpenGLRenderDevice::CreateVertexDescription(unsigned int numVertexElements, const VertexElement * vertexElements)
+void Magma::OpenGLRenderDevice::DestroySampler(Sampler * sampler)
 {
-	return new OpenGLVertexDescription(numVertexElements, vertexElements);
+	if (sampler == nullptr)
+		return;
+	if (sampler == m_defaultSampler)
+	{
+		MAGMA_WARNING("Failed to destroy sampler, the default sampler can't be destroyed");
+		return;
+	}
+
+	// Slots using the destroyed sampler fall back to the default one
+	for (unsigned int i = 0; i < MaxTextureSlots; ++i)
+		if (m_samplers[i] == reinterpret_cast<OpenGLSampler *>(sampler)->sampler)
+			this->SetSampler(i, nullptr);
+	delete sampler;
 }
 
-void Magma::OpenGLRenderDevice::DestroyVertexDescription(VertexDescription * vertexDescription)
+void Magma::OpenGLRenderDevice::SetSampler(unsigned int slot, Sampler * sampler)
 {
-	delete vertexDescription;
+	if (slot >= MaxTextureSlots)
+	{
+		MAGMA_WARNING("Failed to set sampler, slot " + std::to_string(slot) + " is out of range");
+		return;
+	}
+
+	unsigned int name = reinterpret_cast<OpenGLSampler *>(sampler ? sampler : m_defaultSampler)->sampler;
+	if (m_samplers[slot] == name)
+	{
+		++m_stateCacheStats.sampler;
+		return;
+	}
+	glBindSampler(slot, name);
+	m_samplers[slot] = name;
+	m_profiler.CountStateChanges();
 }
 
-VertexArray * Magma::OpenGLRenderDevice::CreateVertexArray(unsigned int numVertexBuffers, VertexBuffer ** vertexBuffers, VertexDescription ** vertexDescriptions)
+RasterState * Magma::OpenGLRenderDevice::CreateRasterState(bool cullEnabled, Winding frontFace, Face cullFace, RasterMode rasterMode)
 {
-	return new OpenGLVertexArray(numVertexBuffers, vertexBuffers, vertexDescriptions);
+	return new OpenGLRasterState(cullEnabled, frontFace, cullFace, rasterMode);
 }
 
-void Magma::OpenGLRenderDevice::DestroyVertexArray(VertexArray * vertexArray)
+void Magma::OpenGLRenderDevice::DestroyRasterState(RasterState * rasterState)
 {
-	delete vertexArray;
+	if (rasterState != nullptr && m_rasterState == rasterState)
+		m_rasterState = nullptr;
+	delete rasterState;
 }
 
-void Magma::OpenGLRenderDevice::SetVertexArray(VertexArray * vertexArray)
+void Magma::OpenGLRenderDevice::SetRasterState(RasterState * rasterState)
 {
-	glBindVertexArray(reinterpret_cast<OpenGLVertexArray *>(vertexArray)->vao);
+	OpenGLRasterState* newRasterState = rasterState ? reinterpret_cast<OpenGLRasterState*>(rasterState) : m_defaultRasterState;
+	if (newRasterState == m_rasterState)
+	{
+		++m_stateCacheStats.rasterState;
+		return;
+	}
+
+	m_rasterState = newRasterState;
+	OpenGLFixedState state = m_fixedState;
+	state.raster = m_rasterState->state;
+	this->ApplyFixedState(state, OpenGLFixedState::Diff(m_fixedState, state));
 }
 
-IndexBuffer * Magma::OpenGLRenderDevice::CreateIndexBuffer(long long size, const void * data)
+DepthStencilState * Magma::OpenGLRenderDevice::CreateDepthStencilState(bool depthEnabled, bool depthWriteEnabled, float depthNear, float depthFar, Compare depthCompare, bool frontFaceStencilEnabled, Compare frontFaceStencilCompare, StencilAction frontFaceStencilFail, StencilAction frontFaceStencilPass, StencilAction frontFaceDepthFail, int frontFaceRef, unsigned int frontFaceReadMask, unsigned int frontFaceWriteMask, bool backFaceStencilEnabled, Compare backFaceStencilCompare, StencilAction backFaceStencilFail, StencilAction backFaceStencilPass, StencilAction backFaceDepthFail, int backFaceRef, unsigned int backFaceReadMask, unsigned int backFaceWriteMask)
 {
-	return new OpenGLIndexBuffer(size, data);
+	return new OpenGLDepthStencilState(depthEnabled, depthWriteEnabled, depthNear, depthFar, depthCompare, frontFaceStencilEnabled, frontFaceStencilCompare,
+									   frontFaceStencilFail, frontFaceStencilPass, frontFaceDepthFail, frontFaceRef, frontFaceReadMask, frontFaceWriteMask, backFaceStencilEnabled,
+									   backFaceStencilCompare, backFaceStencilFail, backFaceStencilPass, backFaceDepthFail, backFaceRef, backFaceReadMask, backFaceWriteMask);
 }
 
-void Magma::OpenGLRenderDevice::DestroyIndexBuffer(IndexBuffer * indexBuffer)
+void Magma::OpenGLRenderDevice::DestroyDepthStencilState(DepthStencilState * depthStencilState)
 {
-	delete indexBuffer;
+	if (depthStencilState != nullptr && m_depthStencilState == depthStencilState)
+		m_depthStencilState = nullptr;
+	delete depthStencilState;
 }
 
-void Magma::OpenGLRenderDevice::SetIndexBuffer(IndexBuffer * indexBuffer)
+void Magma::OpenGLRenderDevice::SetDepthStencilState(DepthStencilState * depthStencilState)
 {
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, reinterpret_cast<OpenGLIndexBuffer *>(indexBuffer)->ibo);
+	OpenGLDepthStencilState* newDepthStencilState = depthStencilState ? reinterpret_cast<OpenGLDepthStencilState*>(depthStencilState) : m_defaultDepthStencilState;
+	if (newDepthStencilState == m_depthStencilState)
+	{
+		++m_stateCacheStats.depthStencilState;
+		return;
+	}
+
+	m_depthStencilState = newDepthStencilState;
+	OpenGLFixedState state = m_fixedState;
+	state.depthStencil = m_depthStencilState->state;
+	this->ApplyFixedState(state, OpenGLFixedState::Diff(m_fixedState, state));
 }
 
-Texture2D * Magma::OpenGLRenderDevice::CreateTexture2D(int width, int height, const void * data)
+BlendState * Magma::OpenGLRenderDevice::CreateBlendState(bool blendEnabled, BlendFactor srcColor, BlendFactor dstColor, BlendOp colorOp, BlendFactor srcAlpha, BlendFactor dstAlpha, BlendOp alphaOp, unsigned int colorWriteMask)
 {
-	return new OpenGLTexture2D(width, height, data);
+	return new OpenGLBlendState(blendEnabled, srcColor, dstColor, colorOp, srcAlpha, dstAlpha, alphaOp, colorWriteMask);
 }
 
-void Magma::OpenGLRenderDevice::DestroyTexture2D(Texture2D * texture2D)
+void Magma::OpenGLRenderDevice::DestroyBlendState(BlendState * blendState)
 {
-	delete texture2D;
+	if (blendState != nullptr && m_blendState == blendState)
+		m_blendState = nullptr;
+	delete blendState;
 }
 
-void Magma::OpenGLRenderDevice::SetTexture2D(unsigned int slot, Texture2D * texture2D)
+void Magma::OpenGLRenderDevice::SetBlendState(BlendState * blendState)
 {
-	glActiveTexture(GL_TEXTURE0 + slot);
-	glBindTexture(GL_TEXTURE_2D, texture2D ? reinterpret_cast<OpenGLTexture2D *>(texture2D)->texture : 0);
+	OpenGLBlendState* newBlendState = blendState ? reinterpret_cast<OpenGLBlendState*>(blendState) : m_defaultBlendState;
+	if (newBlendState == m_blendState)
+	{
+		++m_stateCacheStats.blendState;
+		return;
+	}
 
-	// TO DO: Make parameters as option for 2D texture creation
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	m_blendState = newBlendState;
+	OpenGLFixedState state = m_fixedState;
+	state.blend = m_blendState->state;
+	this->ApplyFixedState(state, OpenGLFixedState::Diff(m_fixedState, state));
 }
 
-RasterState * Magma::OpenGLRenderDevice::CreateRasterState(bool cullEnabled, Winding frontFace, Face cullFace, RasterMode rasterMode)
+PipelineState * Magma::OpenGLRenderDevice::CreatePipelineState(const PipelineStateDesc & desc)
 {
-	return new OpenGLRasterState(cullEnabled, frontFace, cullFace, rasterMode);
+	if (desc.pipeline == nullptr)
+	{
+		MAGMA_WARNING("Failed to create pipeline state, no shader pipeline");
+		return nullptr;
+	}
+
+	OpenGLFixedState state;
+	state.raster = (desc.rasterState ? reinterpret_cast<OpenGLRasterState*>(desc.rasterState) : m_defaultRasterState)->state;
+	state.depthStencil = (desc.depthStencilState ? reinterpret_cast<OpenGLDepthStencilState*>(desc.depthStencilState) : m_defaultDepthStencilState)->state;
+	state.blend = (desc.blendState ? reinterpret_cast<OpenGLBlendState*>(desc.blendState) : m_defaultBlendState)->state;
+	return new OpenGLPipelineState(reinterpret_cast<OpenGLPipeline*>(desc.pipeline), state);
 }
 
-void Magma::OpenGLRenderDevice::DestroyRasterState(RasterState * rasterState)
+void Magma::OpenGLRenderDevice::DestroyPipelineState(PipelineState * pipelineState)
 {
-	delete rasterState;
+	if (pipelineState != nullptr && m_pipelineState == pipelineState)
+		m_pipelineState = nullptr;
+	delete pipelineState;
 }
 
-void Magma::OpenGLRenderDevice::SetRasterState(RasterState * rasterState)
+void Magma::OpenGLRenderDevice::SetPipelineState(PipelineState * pipelineState)
 {
-	RasterState *oldRasterState = m_rasterState;
+	if (pipelineState == nullptr)
+	{
+		this->SetPipeline(nullptr);
+		this->SetRasterState(nullptr);
+		this->SetDepthStencilState(nullptr);
+		this->SetBlendState(nullptr);
+		return;
+	}
 
-	if (rasterState)
-		m_rasterState = dynamic_cast<OpenGLRasterState *>(rasterState);
-	else
-		m_rasterState = m_defaultRasterState;
+	OpenGLPipelineState* newPipelineState = reinterpret_cast<OpenGLPipelineState*>(pipelineState);
+	this->SetPipeline(newPipelineState->pipeline);
+	if (newPipelineState == m_pipelineState)
+	{
+		++m_stateCacheStats.pipelineState;
+		return;
+	}
 
-	if (m_rasterState != oldRasterState)
+	// Switching between pipeline states uses the transition computed on the first switch,
+	// otherwise the fixed function state was changed by individual states and is compared with the shadow copy
+	unsigned int groups;
+	if (m_pipelineState != nullptr)
 	{
-		if (m_rasterState->cullEnabled)
-			glEnable(GL_CULL_FACE);
-		else
-			glDisable(GL_CULL_FACE);
-		glFrontFace(m_rasterState->frontFace);
-		glCullFace(m_rasterState->cullFace);
-		glPolygonMode(GL_FRONT_AND_BACK, m_rasterState->polygonMode);
+		auto it = newPipelineState->transitions.find(m_pipelineState->serial);
+		if (it == newPipelineState->transitions.end())
+			it = newPipelineState->transitions.emplace(m_pipelineState->serial, OpenGLFixedState::Diff(m_pipelineState->state, newPipelineState->state)).first;
+		groups = it->second;
 	}
+	else
+		groups = OpenGLFixedState::Diff(m_fixedState, newPipelineState->state);
+	this->ApplyFixedState(newPipelineState->state, groups);
+
+	// The individual states are unknown until set again
+	m_pipelineState = newPipelineState;
+	m_rasterState = nullptr;
+	m_depthStencilState = nullptr;
+	m_blendState = nullptr;
 }
 
-DepthStencilState * Magma::OpenGLRenderDevice::CreateDepthStencilState(bool depthEnabled, bool depthWriteEnabled, float depthNear, float depthFar, Compare depthCompare, bool frontFaceStencilEnabled, Compare frontFaceStencilCompare, StencilAction frontFaceStencilFail, StencilAction frontFaceStencilPass, StencilAction frontFaceDepthFail, int frontFaceRef, unsigned int frontFaceReadMask, unsigned int frontFaceWriteMask, bool backFaceStencilEnabled, Compare backFaceStencilCompare, StencilAction backFaceStencilFail, StencilAction backFaceStencilPass, StencilAction backFaceDepthFail, int backFaceRef, unsigned int backFaceReadMask, unsigned int backFaceWriteMask)
+RenderTarget * Magma::OpenGLRenderDevice::CreateRenderTarget(const RenderTargetDesc & desc)
 {
-	return new OpenGLDepthStencilState(depthEnabled, depthWriteEnabled, depthNear, depthFar, depthCompare, frontFaceStencilEnabled, frontFaceStencilCompare,
-									   frontFaceStencilFail, frontFaceStencilPass, frontFaceDepthFail, frontFaceRef, frontFaceReadMask, frontFaceWriteMask, backFaceStencilEnabled,
-									   backFaceStencilCompare, backFaceStencilFail, backFaceStencilPass, backFaceDepthFail, backFaceRef, backFaceReadMask, backFaceWriteMask);
+	if (desc.width <= 0 || desc.height <= 0 || desc.colorCount > RenderTargetDesc::MaxColorAttachments)
+	{
+		MAGMA_WARNING("Failed to create render target, invalid size or color attachment count");
+		return nullptr;
+	}
+	for (unsigned int i = 0; i < desc.colorCount; ++i)
+	{
+		OpenGLTexture2D* texture = reinterpret_cast<OpenGLTexture2D*>(desc.colorTextures[i]);
+		if (texture == nullptr || texture->IsCompressed() || IsDepthFormat(texture->textureFormat) || texture->width < desc.width || texture->height < desc.height)
+		{
+			MAGMA_WARNING("Failed to create render target, color texture " + std::to_string(i) + " is missing, too small or has a compressed or depth format");
+			return nullptr;
+		}
+	}
+	OpenGLTexture2D* depthTexture = reinterpret_cast<OpenGLTexture2D*>(desc.depthTexture);
+	if ((depthTexture != nullptr && (!IsDepthFormat(depthTexture->textureFormat) || depthTexture->width < desc.width || depthTexture->height < desc.height)) ||
+		(depthTexture == nullptr && desc.depthFormat != TextureFormat::Count && !IsDepthFormat(desc.depthFormat)))
+	{
+		MAGMA_WARNING("Failed to create render target, the depth texture is too small or the depth format isn't a depth format");
+		return nullptr;
+	}
+
+	GLint maxSamples = 1;
+	glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+	RenderTargetDesc clamped = desc;
+	clamped.samples = desc.samples < maxSamples ? desc.samples : maxSamples;
+
+	OpenGLRenderTarget* renderTarget = new OpenGLRenderTarget(clamped);
+	// Creating the render target changed the framebuffer binding
+	m_framebuffer = UnknownBinding;
+	this->BindFramebuffer(m_renderTarget ? m_renderTarget->framebuffer : 0);
+
+	if (!renderTarget->complete)
+	{
+		MAGMA_WARNING("Failed to create render target, the framebuffer is incomplete (unsupported format combination)");
+		delete renderTarget;
+		return nullptr;
+	}
+	return renderTarget;
 }
 
-void Magma::OpenGLRenderDevice::DestroyDepthStencilState(DepthStencilState * depthStencilState)
+void Magma::OpenGLRenderDevice::DestroyRenderTarget(RenderTarget * renderTarget)
 {
-	delete depthStencilState;
+	if (renderTarget != nullptr && renderTarget == m_renderTarget)
+	{
+		m_renderTarget = nullptr;
+		this->BindFramebuffer(0);
+	}
+	delete renderTarget;
 }
 
-void Magma::OpenGLRenderDevice::SetDepthStencilState(DepthStencilState * depthStencilState)
+void Magma::OpenGLRenderDevice::SetRenderTarget(RenderTarget * renderTarget)
 {
-	DepthStencilState *oldDepthStencilState = m_depthStencilState;
+	m_renderTarget = reinterpret_cast<OpenGLRenderTarget*>(renderTarget);
+	this->BindFramebuffer(m_renderTarget ? m_renderTarget->framebuffer : 0);
+	if (m_renderTarget != nullptr)
+		glViewport(0, 0, m_renderTarget->width, m_renderTarget->height);
+}
 
-	if (depthStencilState)
-		m_depthStencilState = dynamic_cast<OpenGLDepthStencilState *>(depthStencilState);
-	else
-		m_depthStencilState = m_defaultDepthStencilState;
+void Magma::OpenGLRenderDevice::ResolveRenderTarget(RenderTarget * renderTarget)
+{
+	OpenGLRenderTarget* target = reinterpret_cast<OpenGLRenderTarget*>(renderTarget);
+	if (target->samples <= 1)
+		return;
+
+	target->Resolve();
+	// Blitting bound separate read and draw framebuffers
+	m_framebuffer = UnknownBinding;
+	this->BindFramebuffer(m_renderTarget ? m_renderTarget->framebuffer : 0);
+}
 
-	if (m_depthStencilState != oldDepthStencilState)
-	{
-		if (m_depthStencilState->depthEnabled)
-			glEnable(GL_DEPTH_TEST);
-		else
-			glDisable(GL_DEPTH_TEST);
-		glDepthFunc(m_depthStencilState->depthFunc);
-		glDepthMask(m_depthStencilState->depthWriteEnabled ? GL_TRUE : GL_FALSE);
-		glDepthRange(m_depthStencilState->depthNear, m_depthStencilState->depthFar);
+void Magma::OpenGLRenderDevice::SetViewport(int x, int y, int width, int height)
+{
+	glViewport(x, y, width, height);
+}
 
-		if (m_depthStencilState->frontFaceStencilEnabled || m_depthStencilState->backFaceStencilEnabled)
-			glEnable(GL_STENCIL_TEST);
-		else
-			glDisable(GL_STENCIL_TEST);
+void Magma::OpenGLRenderDevice::ReadPixels(int x, int y, int width, int height, void * data)
+{
+	// Multisampled render targets are read from their resolved textures
+	if (m_renderTarget != nullptr && m_renderTarget->samples > 1)
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_renderTarget->resolveFramebuffer);
 
-		// Front face
-		glStencilFuncSeparate(GL_FRONT, m_depthStencilState->frontStencilFunc, m_depthStencilState->frontFaceRef, m_depthStencilState->frontFaceReadMask);
-		glStencilMaskSeparate(GL_FRONT, m_depthStencilState->frontFaceWriteMask);
-		glStencilOpSeparate(GL_FRONT, m_depthStencilState->frontFaceStencilFail, m_depthStencilState->frontFaceDepthFail, m_depthStencilState->frontFaceStencilPass);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
 
-		// Back face
-		glStencilFuncSeparate(GL_BACK, m_depthStencilState->backStencilFunc, m_depthStencilState->backFaceRef, m_depthStencilState->backFaceReadMask);
-		glStencilMaskSeparate(GL_BACK, m_depthStencilState->backFaceWriteMask);
-		glStencilOpSeparate(GL_BACK, m_depthStencilState->backFaceStencilFail, m_depthStencilState->backFaceDepthFail, m_depthStencilState->backFaceStencilPass);
-	}
+	if (m_renderTarget != nullptr && m_renderTarget->samples > 1)
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_renderTarget->framebuffer);
 }
 
 void Magma::OpenGLRenderDevice::Clear(float red, float green, float blue, float alpha, float depth, int stencil)
@@ -631,10 +2479,401 @@ void Magma::OpenGLRenderDevice::Clear(float red, float green, float blue, float
 
 void Magma::OpenGLRenderDevice::DrawTriangles(int offset, int count)
 {
+	if (!this->PrepareDraw())
+		return;
 	glDrawArrays(GL_TRIANGLES, offset, count);
+	m_profiler.CountDraws(1, count / 3);
 }
 
 void Magma::OpenGLRenderDevice::DrawTrianglesIndexed32(long long offset, int count)
 {
+	if (!this->PrepareDraw())
+		return;
 	glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, reinterpret_cast<const void *>(offset));
+	m_profiler.CountDraws(1, count / 3);
+}
+
+void Magma::OpenGLRenderDevice::DrawTrianglesIndexed(long long offset, int count)
+{
+	if (!this->PrepareDraw())
+		return;
+	glDrawElements(GL_TRIANGLES, count, this->GetIndexType(), reinterpret_cast<const void *>(offset));
+	m_profiler.CountDraws(1, count / 3);
+}
+
+void Magma::OpenGLRenderDevice::DrawTrianglesInstanced(int offset, int count, int instanceCount)
+{
+	if (!this->PrepareDraw())
+		return;
+	glDrawArraysInstanced(GL_TRIANGLES, offset, count, instanceCount);
+	m_profiler.CountDraws(1, static_cast<unsigned long long>(count / 3) * instanceCount);
+}
+
+void Magma::OpenGLRenderDevice::DrawTrianglesIndexedInstanced(long long offset, int count, int instanceCount)
+{
+	if (!this->PrepareDraw())
+		return;
+	glDrawElementsInstanced(GL_TRIANGLES, count, this->GetIndexType(), reinterpret_cast<const void *>(offset), instanceCount);
+	m_profiler.CountDraws(1, static_cast<unsigned long long>(count / 3) * instanceCount);
+}
+
+void Magma::OpenGLRenderDevice::DrawTrianglesIndirect(IndirectBuffer * indirectBuffer, long long offset, int drawCount)
+{
+	OpenGLIndirectBuffer* buffer = reinterpret_cast<OpenGLIndirectBuffer *>(indirectBuffer);
+	if (buffer->mapped)
+	{
+		MAGMA_WARNING("Failed to draw indirect, the indirect buffer is mapped");
+		return;
+	}
+
+	this->BindIndirectBuffer(buffer->buffer);
+	if (!this->PrepareDraw())
+		return;
+	// The triangle counts are in GPU memory, so only the draws are counted
+	m_profiler.CountDraws(drawCount, 0);
+	if (GLEW_ARB_multi_draw_indirect)
+		glMultiDrawArraysIndirect(GL_TRIANGLES, reinterpret_cast<const void *>(offset), drawCount, 0);
+	else
+		for (int i = 0; i < drawCount; ++i)
+			glDrawArraysIndirect(GL_TRIANGLES, reinterpret_cast<const void *>(offset + i * sizeof(DrawIndirectCommand)));
+}
+
+void Magma::OpenGLRenderDevice::DrawTrianglesIndexedIndirect(IndirectBuffer * indirectBuffer, long long offset, int drawCount)
+{
+	OpenGLIndirectBuffer* buffer = reinterpret_cast<OpenGLIndirectBuffer *>(indirectBuffer);
+	if (buffer->mapped)
+	{
+		MAGMA_WARNING("Failed to draw indexed indirect, the indirect buffer is mapped");
+		return;
+	}
+
+	this->BindIndirectBuffer(buffer->buffer);
+	if (!this->PrepareDraw())
+		return;
+	m_profiler.CountDraws(drawCount, 0);
+	if (GLEW_ARB_multi_draw_indirect)
+		glMultiDrawElementsIndirect(GL_TRIANGLES, this->GetIndexType(), reinterpret_cast<const void *>(offset), drawCount, 0);
+	else
+		for (int i = 0; i < drawCount; ++i)
+			glDrawElementsIndirect(GL_TRIANGLES, this->GetIndexType(), reinterpret_cast<const void *>(offset + i * sizeof(DrawIndexedIndirectCommand)));
+}
+
+unsigned int Magma::OpenGLRenderDevice::GetIndexType() const
+{
+	return m_vertexArrayObject != nullptr ? m_vertexArrayObject->indexType : GL_UNSIGNED_INT;
+}
+
+void Magma::OpenGLRenderDevice::BindFramebuffer(unsigned int framebuffer)
+{
+	if (m_framebuffer == framebuffer)
+	{
+		++m_stateCacheStats.framebuffer;
+		return;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	m_framebuffer = framebuffer;
+	m_profiler.CountStateChanges();
+}
+
+void Magma::OpenGLRenderDevice::ApplyFixedState(const OpenGLFixedState & state, unsigned int groups)
+{
+	if (groups == 0)
+		return;
+
+	const OpenGLFixedState::Raster& r = state.raster;
+	const OpenGLFixedState::DepthStencil& d = state.depthStencil;
+	const OpenGLFixedState::Blend& b = state.blend;
+
+	if (groups & OpenGLFixedState::CullEnable)
+	{
+		if (r.cullEnabled)
+			glEnable(GL_CULL_FACE);
+		else
+			glDisable(GL_CULL_FACE);
+	}
+	if (groups & OpenGLFixedState::FrontFace)
+		glFrontFace(r.frontFace);
+	if (groups & OpenGLFixedState::CullFace)
+		glCullFace(r.cullFace);
+	if (groups & OpenGLFixedState::PolygonMode)
+		glPolygonMode(GL_FRONT_AND_BACK, r.polygonMode);
+
+	if (groups & OpenGLFixedState::DepthTest)
+	{
+		if (d.depthEnabled)
+			glEnable(GL_DEPTH_TEST);
+		else
+			glDisable(GL_DEPTH_TEST);
+	}
+	if (groups & OpenGLFixedState::DepthFunc)
+		glDepthFunc(d.depthFunc);
+	if (groups & OpenGLFixedState::DepthMask)
+		glDepthMask(d.depthWriteEnabled ? GL_TRUE : GL_FALSE);
+	if (groups & OpenGLFixedState::DepthRange)
+		glDepthRange(d.depthNear, d.depthFar);
+	if (groups & OpenGLFixedState::StencilTest)
+	{
+		if (d.stencilEnabled)
+			glEnable(GL_STENCIL_TEST);
+		else
+			glDisable(GL_STENCIL_TEST);
+	}
+	if (groups & OpenGLFixedState::FrontStencilFunc)
+		glStencilFuncSeparate(GL_FRONT, d.front.func, d.front.ref, d.front.readMask);
+	if (groups & OpenGLFixedState::FrontStencilMask)
+		glStencilMaskSeparate(GL_FRONT, d.front.writeMask);
+	if (groups & OpenGLFixedState::FrontStencilOp)
+		glStencilOpSeparate(GL_FRONT, d.front.stencilFail, d.front.depthFail, d.front.pass);
+	if (groups & OpenGLFixedState::BackStencilFunc)
+		glStencilFuncSeparate(GL_BACK, d.back.func, d.back.ref, d.back.readMask);
+	if (groups & OpenGLFixedState::BackStencilMask)
+		glStencilMaskSeparate(GL_BACK, d.back.writeMask);
+	if (groups & OpenGLFixedState::BackStencilOp)
+		glStencilOpSeparate(GL_BACK, d.back.stencilFail, d.back.depthFail, d.back.pass);
+
+	if (groups & OpenGLFixedState::BlendEnable)
+	{
+		if (b.enabled)
+			glEnable(GL_BLEND);
+		else
+			glDisable(GL_BLEND);
+	}
+	if (groups & OpenGLFixedState::BlendFunc)
+		glBlendFuncSeparate(b.srcColor, b.dstColor, b.srcAlpha, b.dstAlpha);
+	if (groups & OpenGLFixedState::BlendEquation)
+		glBlendEquationSeparate(b.colorOp, b.alphaOp);
+	if (groups & OpenGLFixedState::ColorMask)
+		glColorMask((b.writeMask & ColorWriteRed) != 0, (b.writeMask & ColorWriteGreen) != 0, (b.writeMask & ColorWriteBlue) != 0, (b.writeMask & ColorWriteAlpha) != 0);
+
+	// Each group is set by a single call
+	unsigned int calls = 0;
+	for (unsigned int bits = groups; bits != 0; bits &= bits - 1)
+		++calls;
+	m_profiler.CountStateChanges(calls);
+
+	m_fixedState = state;
+	m_pipelineState = nullptr;
+}
+
+void Magma::OpenGLRenderDevice::BindProgram(unsigned int program)
+{
+	if (m_program == program)
+	{
+		++m_stateCacheStats.program;
+		return;
+	}
+	glUseProgram(program);
+	m_program = program;
+	m_profiler.CountStateChanges();
+}
+
+void Magma::OpenGLRenderDevice::BindVertexArray(OpenGLVertexArray * vertexArray)
+{
+	unsigned int vao = vertexArray ? vertexArray->vao : 0;
+	if (m_vertexArray == vao)
+	{
+		++m_stateCacheStats.vertexArray;
+		return;
+	}
+	glBindVertexArray(vao);
+	m_vertexArray = vao;
+	m_profiler.CountStateChanges();
+	m_vertexArrayObject = vertexArray;
+}
+
+void Magma::OpenGLRenderDevice::BindIndexBuffer(unsigned int ibo, unsigned long long serial)
+{
+	// Without a known vertex array there's nowhere to remember the binding
+	if (m_vertexArrayObject != nullptr && m_vertexArrayObject->indexBuffer == serial)
+	{
+		++m_stateCacheStats.indexBuffer;
+		return;
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	m_profiler.CountStateChanges();
+	if (m_vertexArrayObject != nullptr)
+		m_vertexArrayObject->indexBuffer = serial;
+}
+
+void Magma::OpenGLRenderDevice::BindIndirectBuffer(unsigned int buffer)
+{
+	if (m_indirectBuffer == buffer)
+	{
+		++m_stateCacheStats.indirectBuffer;
+		return;
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+	m_indirectBuffer = buffer;
+	m_profiler.CountStateChanges();
+}
+
+void Magma::OpenGLRenderDevice::ActiveTexture(unsigned int slot)
+{
+	if (m_activeTexture == slot)
+	{
+		++m_stateCacheStats.activeTexture;
+		return;
+	}
+	glActiveTexture(GL_TEXTURE0 + slot);
+	m_activeTexture = slot;
+	m_profiler.CountStateChanges();
+}
+
+void Magma::OpenGLRenderDevice::BindTexture(unsigned int slot, unsigned int texture, unsigned int target)
+{
+	if (m_textures[slot] == texture && (texture == 0 || m_textureTargets[slot] == target))
+	{
+		++m_stateCacheStats.texture;
+		return;
+	}
+	this->ActiveTexture(slot);
+
+	// Each target has its own binding on a slot, unbind the texture of the previous target so that only one stays bound
+	if (m_textureTargets[slot] != 0 && m_textureTargets[slot] != target)
+		glBindTexture(m_textureTargets[slot], 0);
+	if (texture != 0 || m_textureTargets[slot] == 0 || m_textureTargets[slot] == target)
+		glBindTexture(target, texture);
+	m_textures[slot] = texture;
+	m_textureTargets[slot] = texture != 0 ? target : 0;
+	m_profiler.CountStateChanges();
+}
+
+void Magma::OpenGLRenderDevice::RestoreTexture(unsigned int slot, unsigned int texture, unsigned int target)
+{
+	// An unknown binding was a deleted texture, which left the slot empty
+	if (texture == UnknownBinding || texture == 0)
+		this->BindTexture(slot, 0, GL_TEXTURE_2D);
+	else
+		this->BindTexture(slot, texture, target);
+}
+
+void Magma::OpenGLRenderDevice::BeginScope(const char * name)
+{
+	const unsigned int index = m_profiler.BeginScope(name);
+	if (m_timerQueries != nullptr)
+		m_timerQueries->BeginScope(index);
+}
+
+void Magma::OpenGLRenderDevice::EndScope()
+{
+	if (m_profiler.EndScope() != FrameProfiler::InvalidScope && m_timerQueries != nullptr)
+		m_timerQueries->EndScope();
+}
+
+void Magma::OpenGLRenderDevice::EndFrame()
+{
+	m_uploadQueue->Process(this);
+
+	// Finish the pipelines done linking. Deferred pipelines are linked here, for a limited time per frame
+	const auto start = std::chrono::steady_clock::now();
+	bool budget = true;
+	for (auto it = m_pendingPipelines.begin(); it != m_pendingPipelines.end();)
+	{
+		OpenGLPipeline* pipeline = *it;
+		if (pipeline->state == OpenGLPipeline::State::Deferred && budget)
+		{
+			pipeline->Poll(true);
+			budget = std::chrono::steady_clock::now() - start < std::chrono::milliseconds(PipelineLinkBudget);
+		}
+		else
+			pipeline->Poll(false);
+
+		if (pipeline->IsDone())
+			it = m_pendingPipelines.erase(it);
+		else
+			++it;
+	}
+
+	const unsigned long long frame = m_profiler.EndFrame();
+	if (m_timerQueries != nullptr)
+		m_timerQueries->EndFrame(frame, m_profiler);
+}
+
+void Magma::OpenGLRenderDevice::BindUniformRange(unsigned int binding, unsigned int buffer, long long offset, long long size)
+{
+	if (m_uniformBuffers[binding] == buffer && m_uniformRanges[binding][0] == offset && m_uniformRanges[binding][1] == size)
+	{
+		++m_stateCacheStats.uniformBuffer;
+		return;
+	}
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+	m_profiler.CountStateChanges();
+	m_uniformBuffers[binding] = buffer;
+	m_uniformRanges[binding][0] = offset;
+	m_uniformRanges[binding][1] = size;
+}
+
+bool Magma::OpenGLRenderDevice::PrepareDraw()
+{
+	if (m_pipeline == nullptr)
+		return true;
+
+	if (m_pipeline->state != OpenGLPipeline::State::Ready && !m_pipeline->Poll(false))
+	{
+		++m_skippedDraws;
+		return false;
+	}
+
+	// The pipeline may have become ready outside of a draw (GetParam, EndFrame) while SetPipeline left it unbound
+	this->BindProgram(m_pipeline->shaderProgram);
+	if (!this->FlushParams())
+	{
+		++m_skippedDraws;
+		return false;
+	}
+	return true;
+}
+
+bool Magma::OpenGLRenderDevice::FlushParams()
+{
+
+	// Default block uniforms, the program is already bound
+	for (auto param : m_pipeline->dirtyParams)
+		param->Upload();
+	m_pipeline->dirtyParams.clear();
+
+	// Gather the dirty blocks (and those whose ring range was recycled) into a single ring range, skipping those sourced from uniform buffers
+	long long size = 0;
+	for (auto& block : m_pipeline->blocks)
+	{
+		if (block.buffer != nullptr)
+			continue;
+		if (!block.dirty && !m_uniformRing->IsValid(block.epoch))
+			block.dirty = true;
+		if (block.dirty)
+			size += m_uniformRing->Align(block.data.size());
+	}
+
+	if (size > OpenGLUniformRing::SegmentSize)
+	{
+		// Drawing would read the ranges bound for another pipeline, warn once and skip the draws
+		if (!m_pipeline->oversizedBlocks)
+			MAGMA_WARNING("Failed to upload pipeline uniform blocks, they don't fit in the uniform ring");
+		m_pipeline->oversizedBlocks = true;
+		return false;
+	}
+
+	if (size > 0)
+	{
+		m_profiler.CountUpload(size);
+		long long offset = m_uniformRing->Allocate(size);
+		for (auto& block : m_pipeline->blocks)
+			if (block.dirty && block.buffer == nullptr)
+			{
+				m_uniformRing->Write(offset, block.data.data(), block.data.size());
+				block.offset = offset;
+				block.epoch = m_uniformRing->epoch;
+				block.dirty = false;
+				offset += m_uniformRing->Align(block.data.size());
+			}
+	}
+
+	for (auto& block : m_pipeline->blocks)
+		if (block.binding >= MaxUniformBindings)
+			continue;
+		else if (block.buffer != nullptr)
+			this->BindUniformRange(block.binding, block.buffer->storage.buffer, block.bufferOffset, block.data.size());
+		else
+			this->BindUniformRange(block.binding, m_uniformRing->ubo, block.offset, block.data.size());
+	return true;
 }
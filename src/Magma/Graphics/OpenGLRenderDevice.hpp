@@ -2,16 +2,156 @@
 
 #include "RenderDevice.hpp"
 
+#include <string>
+#include <vector>
+
 namespace Magma
 {
 
 	class OpenGLRasterState;
 	class OpenGLDepthStencilState;
+	class OpenGLBlendState;
+	class OpenGLPipelineState;
+	class OpenGLVertexArray;
+	class OpenGLPipeline;
+	class OpenGLUniformRing;
+	class OpenGLUploadQueue;
+	class OpenGLRenderTarget;
+	class OpenGLTimerQueries;
+
+	/// <summary>
+	///		Flat copy of the GL fixed function state set by raster, depth/stencil and blend states.
+	///		States are compared group by group, each group being the values set by one GL call, so that only the calls that change something are issued.
+	/// </summary>
+	struct OpenGLFixedState
+	{
+		enum Group : unsigned int
+		{
+			CullEnable = 1 << 0,
+			FrontFace = 1 << 1,
+			CullFace = 1 << 2,
+			PolygonMode = 1 << 3,
+			DepthTest = 1 << 4,
+			DepthFunc = 1 << 5,
+			DepthMask = 1 << 6,
+			DepthRange = 1 << 7,
+			StencilTest = 1 << 8,
+			FrontStencilFunc = 1 << 9,
+			FrontStencilMask = 1 << 10,
+			FrontStencilOp = 1 << 11,
+			BackStencilFunc = 1 << 12,
+			BackStencilMask = 1 << 13,
+			BackStencilOp = 1 << 14,
+			BlendEnable = 1 << 15,
+			BlendFunc = 1 << 16,
+			BlendEquation = 1 << 17,
+			ColorMask = 1 << 18,
+			AllGroups = (1 << 19) - 1,
+		};
+
+		struct Raster
+		{
+			bool cullEnabled;
+			unsigned int frontFace;
+			unsigned int cullFace;
+			unsigned int polygonMode;
+		};
+
+		struct StencilFace
+		{
+			unsigned int func;
+			int ref;
+			unsigned int readMask;
+			unsigned int writeMask;
+			unsigned int stencilFail;
+			unsigned int depthFail;
+			unsigned int pass;
+		};
+
+		struct DepthStencil
+		{
+			bool depthEnabled;
+			bool depthWriteEnabled;
+			float depthNear;
+			float depthFar;
+			unsigned int depthFunc;
+			bool stencilEnabled;
+			StencilFace front;
+			StencilFace back;
+		};
+
+		struct Blend
+		{
+			bool enabled;
+			unsigned int srcColor;
+			unsigned int dstColor;
+			unsigned int colorOp;
+			unsigned int srcAlpha;
+			unsigned int dstAlpha;
+			unsigned int alphaOp;
+			unsigned int writeMask;
+		};
+
+		Raster raster = {};
+		DepthStencil depthStencil = {};
+		Blend blend = {};
+
+		/// <summary>
+		///		Gets the groups whose values differ between two states
+		/// </summary>
+		/// <param name="lhs">First state</param>
+		/// <param name="rhs">Second state</param>
+		/// <returns>Group bits</returns>
+		static unsigned int Diff(const OpenGLFixedState& lhs, const OpenGLFixedState& rhs);
+	};
 
 	class OpenGLRenderDevice : public RenderDevice
 	{
 	public:
+		/// <summary>
+		///		Number of uniform block binding points used, pipelines with more uniform blocks can't be drawn with
+		/// </summary>
+		static const unsigned int MaxUniformBindings = 16;
+
+		/// <summary>
+		///		Counters of the GL calls skipped because the state they would set was already set
+		/// </summary>
+		struct StateCacheStats
+		{
+			unsigned long long program = 0;
+			unsigned long long uniformBuffer = 0;
+			unsigned long long vertexArray = 0;
+			unsigned long long indexBuffer = 0;
+			unsigned long long indirectBuffer = 0;
+			unsigned long long activeTexture = 0;
+			unsigned long long texture = 0;
+			unsigned long long sampler = 0;
+			unsigned long long rasterState = 0;
+			unsigned long long depthStencilState = 0;
+			unsigned long long blendState = 0;
+			unsigned long long pipelineState = 0;
+			unsigned long long framebuffer = 0;
+		};
+
 		OpenGLRenderDevice();
+		virtual ~OpenGLRenderDevice() override;
+
+		/// <summary>
+		///		Gets the number of GL calls skipped by the state cache since the device was created or the counters were last reset
+		/// </summary>
+		/// <returns>State cache counters</returns>
+		inline const StateCacheStats& GetStateCacheStats() const { return m_stateCacheStats; }
+
+		/// <summary>
+		///		Resets the state cache counters to zero
+		/// </summary>
+		inline void ResetStateCacheStats() { m_stateCacheStats = StateCacheStats(); }
+
+		/// <summary>
+		///		Gets the number of draws skipped because their pipeline wasn't ready yet
+		/// </summary>
+		/// <returns>Number of skipped draws</returns>
+		inline unsigned long long GetSkippedDrawCount() const { return m_skippedDraws; }
 
 		// Inherited via RenderDevice
 		virtual VertexShader * CreateVertexShader(const char * code) override;
@@ -19,21 +159,48 @@ namespace Magma
 		virtual PixelShader * CreatePixelShader(const char * code) override;
 		virtual void DestroyPixelShader(PixelShader * pixelShader) override;
 		virtual Pipeline * CreatePipeline(VertexShader * vertexShader, PixelShader * pixelShader) override;
+		virtual bool IsPipelineReady(Pipeline * pipeline) override;
 		virtual void DestroyPipeline(Pipeline * pipeline) override;
+		virtual void SetPipelineCache(PipelineCache * pipelineCache) override;
 		virtual void SetPipeline(Pipeline * pipeline) override;
-		virtual VertexBuffer * CreateVertexBuffer(long long size, const void * data = nullptr) override;
+		virtual VertexBuffer * CreateVertexBuffer(long long size, const void * data = nullptr, BufferUsage usage = BufferUsage::Static) override;
 		virtual void DestroyVertexBuffer(VertexBuffer * vertexBuffer) override;
+		virtual void UpdateVertexBuffer(VertexBuffer * vertexBuffer, long long offset, long long size, const void * data) override;
+		virtual void * MapVertexBuffer(VertexBuffer * vertexBuffer, long long offset, long long size) override;
+		virtual void UnmapVertexBuffer(VertexBuffer * vertexBuffer) override;
+		virtual long long AdvanceVertexBuffer(VertexBuffer * vertexBuffer) override;
+		virtual VertexBuffer * CreateVertexBufferAsync(long long size, const void * data, BufferUsage usage = BufferUsage::Static) override;
+		virtual bool IsVertexBufferReady(VertexBuffer * vertexBuffer) override;
 		virtual VertexDescription * CreateVertexDescription(unsigned int numVertexElements, const VertexElement * vertexElements) override;
 		virtual void DestroyVertexDescription(VertexDescription * vertexDescription) override;
 		virtual VertexArray * CreateVertexArray(unsigned int numVertexBuffers, VertexBuffer ** vertexBuffers, VertexDescription ** vertexDescriptions) override;
 		virtual void DestroyVertexArray(VertexArray * vertexArray) override;
 		virtual void SetVertexArray(VertexArray * vertexArray) override;
-		virtual IndexBuffer * CreateIndexBuffer(long long size, const void * data = nullptr) override;
+		virtual IndexBuffer * CreateIndexBuffer(long long size, const void * data = nullptr, BufferUsage usage = BufferUsage::Static, IndexFormat format = IndexFormat::UInt32) override;
 		virtual void DestroyIndexBuffer(IndexBuffer * indexBuffer) override;
+		virtual void UpdateIndexBuffer(IndexBuffer * indexBuffer, long long offset, long long size, const void * data) override;
+		virtual void * MapIndexBuffer(IndexBuffer * indexBuffer, long long offset, long long size) override;
+		virtual void UnmapIndexBuffer(IndexBuffer * indexBuffer) override;
+		virtual long long AdvanceIndexBuffer(IndexBuffer * indexBuffer) override;
 		virtual void SetIndexBuffer(IndexBuffer * indexBuffer) override;
-		virtual Texture2D * CreateTexture2D(int width, int height, const void * data = nullptr) override;
+		virtual IndirectBuffer * CreateIndirectBuffer(long long size, const void * data = nullptr) override;
+		virtual void DestroyIndirectBuffer(IndirectBuffer * indirectBuffer) override;
+		virtual void * MapIndirectBuffer(IndirectBuffer * indirectBuffer) override;
+		virtual void UnmapIndirectBuffer(IndirectBuffer * indirectBuffer) override;
+		virtual UniformBuffer * CreateUniformBuffer(long long size, const void * data = nullptr) override;
+		virtual void DestroyUniformBuffer(UniformBuffer * uniformBuffer) override;
+		virtual void UpdateUniformBuffer(UniformBuffer * uniformBuffer, long long offset, long long size, const void * data) override;
+		using RenderDevice::CreateTexture2D;
+		virtual Texture2D * CreateTexture2D(const Texture2DDesc & desc) override;
+		virtual Texture2D * CreateTexture2DAsync(const Texture2DDesc & desc) override;
+		virtual bool IsTexture2DReady(Texture2D * texture2D) override;
 		virtual void DestroyTexture2D(Texture2D * texture2D) override;
 		virtual void SetTexture2D(unsigned int slot, Texture2D * texture2D) override;
+		virtual void UpdateTexture2D(Texture2D * texture2D, int layer, int level, const void * data, bool generateMips = false) override;
+		virtual unsigned long long GetTexture2DHandle(Texture2D * texture2D, Sampler * sampler = nullptr) override;
+		virtual Sampler * CreateSampler(const SamplerDesc & desc) override;
+		virtual void DestroySampler(Sampler * sampler) override;
+		virtual void SetSampler(unsigned int slot, Sampler * sampler) override;
 		virtual RasterState * CreateRasterState(bool cullEnabled = true, Winding frontFace = Winding::CCW, Face cullFace = Face::Back, RasterMode rasterMode = RasterMode::Fill) override;
 		virtual void DestroyRasterState(RasterState * rasterState) override;
 		virtual void SetRasterState(RasterState * rasterState) override;
@@ -55,15 +222,107 @@ namespace Magma
 														   unsigned int backFaceWriteMask = 0xFFFFFFFF) override;
 		virtual void DestroyDepthStencilState(DepthStencilState * depthStencilState) override;
 		virtual void SetDepthStencilState(DepthStencilState * depthStencilState) override;
+		virtual BlendState * CreateBlendState(bool blendEnabled = false, BlendFactor srcColor = BlendFactor::One, BlendFactor dstColor = BlendFactor::Zero, BlendOp colorOp = BlendOp::Add,
+											  BlendFactor srcAlpha = BlendFactor::One, BlendFactor dstAlpha = BlendFactor::Zero, BlendOp alphaOp = BlendOp::Add,
+											  unsigned int colorWriteMask = ColorWriteAll) override;
+		virtual void DestroyBlendState(BlendState * blendState) override;
+		virtual void SetBlendState(BlendState * blendState) override;
+		virtual PipelineState * CreatePipelineState(const PipelineStateDesc & desc) override;
+		virtual void DestroyPipelineState(PipelineState * pipelineState) override;
+		virtual void SetPipelineState(PipelineState * pipelineState) override;
+		virtual RenderTarget * CreateRenderTarget(const RenderTargetDesc & desc) override;
+		virtual void DestroyRenderTarget(RenderTarget * renderTarget) override;
+		virtual void SetRenderTarget(RenderTarget * renderTarget) override;
+		virtual void ResolveRenderTarget(RenderTarget * renderTarget) override;
+		virtual void SetViewport(int x, int y, int width, int height) override;
+		virtual void ReadPixels(int x, int y, int width, int height, void * data) override;
 		virtual void Clear(float red = 0.0f, float green = 0.0f, float blue = 0.0f, float alpha = 1.0f, float depth = 1.0f, int stencil = 0) override;
 		virtual void DrawTriangles(int offset, int count) override;
 		virtual void DrawTrianglesIndexed32(long long offset, int count) override;
+		virtual void DrawTrianglesIndexed(long long offset, int count) override;
+		virtual void DrawTrianglesInstanced(int offset, int count, int instanceCount) override;
+		virtual void DrawTrianglesIndexedInstanced(long long offset, int count, int instanceCount) override;
+		virtual void DrawTrianglesIndirect(IndirectBuffer * indirectBuffer, long long offset, int drawCount) override;
+		virtual void DrawTrianglesIndexedIndirect(IndirectBuffer * indirectBuffer, long long offset, int drawCount) override;
+		virtual void BeginScope(const char * name) override;
+		virtual void EndScope() override;
+		virtual void EndFrame() override;
 
 	private:
+		friend class OpenGLUploadQueue;
+
+		// Binding value used when the bound GL object isn't known, forcing the next bind to be issued
+		static const unsigned int UnknownBinding = 0xFFFFFFFF;
+		static const unsigned int MaxTextureSlots = 32;
+		// Time in milliseconds spent linking deferred pipelines per frame, when parallel compilation isn't available
+		static const unsigned int PipelineLinkBudget = 4;
+
+		// Bind GL objects, skipping the call if the object is already bound
+		void BindFramebuffer(unsigned int framebuffer);
+		void BindProgram(unsigned int program);
+		void BindVertexArray(OpenGLVertexArray* vertexArray);
+		void BindIndexBuffer(unsigned int ibo, unsigned long long serial);
+		void BindIndirectBuffer(unsigned int buffer);
+		void ActiveTexture(unsigned int slot);
+		void BindTexture(unsigned int slot, unsigned int texture, unsigned int target);
+		// Binds back a texture saved from m_textures and m_textureTargets, after slot 0 was used to create or update another one
+		void RestoreTexture(unsigned int slot, unsigned int texture, unsigned int target);
+		void BindUniformRange(unsigned int binding, unsigned int buffer, long long offset, long long size);
+		// Issues the GL calls of some groups of a fixed function state and updates the shadow copy
+		void ApplyFixedState(const OpenGLFixedState& state, unsigned int groups);
+
+		// Gets the GL type of the indices of the index buffer bound to the current vertex array
+		unsigned int GetIndexType() const;
+
+		// Binds the current pipeline if it just became ready and flushes its params, returns false if the draw must be skipped
+		bool PrepareDraw();
+		// Uploads the params of the current pipeline set since its last draw, returns false if the draw must be skipped
+		bool FlushParams();
+
+		StateCacheStats m_stateCacheStats;
+
+		// Shadow copy of the GL binding state
+		unsigned int m_framebuffer = UnknownBinding;
+		OpenGLRenderTarget* m_renderTarget = nullptr;
+		unsigned int m_program = UnknownBinding;
+		OpenGLPipeline* m_pipeline = nullptr;
+		unsigned int m_vertexArray = UnknownBinding;
+		OpenGLVertexArray* m_vertexArrayObject = nullptr;
+		unsigned int m_indirectBuffer = UnknownBinding;
+		unsigned int m_activeTexture = UnknownBinding;
+		unsigned int m_textures[MaxTextureSlots];
+		// Target of the texture bound on each slot, 0 if none
+		unsigned int m_textureTargets[MaxTextureSlots];
+		unsigned int m_samplers[MaxTextureSlots];
+		unsigned int m_uniformBuffers[MaxUniformBindings];
+		long long m_uniformRanges[MaxUniformBindings][2];
+		OpenGLFixedState m_fixedState;
+		// Pipeline state the fixed function state was last set from, null if it was changed since
+		OpenGLPipelineState* m_pipelineState = nullptr;
+
+		// Ring buffer the uniform blocks of every pipeline are streamed through
+		OpenGLUniformRing* m_uniformRing = nullptr;
+		// Queue of the asynchronous uploads in flight
+		OpenGLUploadQueue* m_uploadQueue = nullptr;
+		// Timestamp queries of the GPU timings, null if not supported
+		OpenGLTimerQueries* m_timerQueries = nullptr;
+
+		PipelineCache* m_pipelineCache = nullptr;
+		// Vendor, renderer and version strings, part of the pipeline cache keys
+		std::string m_driver;
+		// Pipelines still compiling or linking
+		std::vector<OpenGLPipeline*> m_pendingPipelines;
+		unsigned long long m_skippedDraws = 0;
+
+		Sampler* m_defaultSampler = nullptr;
+
 		OpenGLRasterState* m_rasterState = nullptr;
 		OpenGLRasterState* m_defaultRasterState = nullptr;
 
 		OpenGLDepthStencilState* m_depthStencilState = nullptr;
 		OpenGLDepthStencilState* m_defaultDepthStencilState = nullptr;
+
+		OpenGLBlendState* m_blendState = nullptr;
+		OpenGLBlendState* m_defaultBlendState = nullptr;
 	};
 }
\ No newline at end of file
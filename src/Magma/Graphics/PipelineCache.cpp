@@ -0,0 +1,179 @@
+#include "PipelineCache.hpp"
+#include "..\Utils\Utils.hpp"
+
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	const unsigned long long FNVOffsetBasis = 14695981039346656037ull;
+	const unsigned long long FNVPrime = 1099511628211ull;
+
+	// Bumped whenever the way pipelines are keyed or stored changes
+	const unsigned int CacheVersion = 1;
+	const char CacheMagic[4] = { 'M', 'G', 'P', 'C' };
+
+	unsigned long long Hash(unsigned long long hash, const char* str)
+	{
+		if (str != nullptr)
+			for (; *str != '\0'; ++str)
+				hash = (hash ^ static_cast<unsigned char>(*str)) * FNVPrime;
+		// Hash the terminator too, so that moving characters between strings changes the key
+		return hash * FNVPrime;
+	}
+
+	template <typename T>
+	bool Read(std::istream& is, T& value)
+	{
+		return static_cast<bool>(is.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	template <typename T>
+	void Write(std::ostream& os, const T& value)
+	{
+		os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+}
+
+bool Magma::MemoryPipelineCacheStorage::Load(unsigned long long key, std::vector<unsigned char>& data)
+{
+	auto it = m_blobs.find(key);
+	if (it == m_blobs.end())
+		return false;
+	data = it->second;
+	return true;
+}
+
+void Magma::MemoryPipelineCacheStorage::Store(unsigned long long key, const void * data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	m_blobs[key].assign(bytes, bytes + size);
+}
+
+Magma::FilePipelineCacheStorage::FilePipelineCacheStorage(const std::string & path)
+	: m_path(path)
+{
+	std::ifstream ifs(m_path, std::ios::binary | std::ios::ate);
+	if (!ifs.is_open())
+		return;
+	// Blob sizes are checked against the file size, so that a corrupt size can't make the load allocate anything large
+	const unsigned long long fileSize = static_cast<unsigned long long>(ifs.tellg());
+	ifs.seekg(0);
+
+	// Layout: magic, version, blob count, then the key, size and data of each blob
+	char magic[4];
+	unsigned int version = 0;
+	unsigned long long count = 0;
+	if (!ifs.read(magic, sizeof(magic)) || memcmp(magic, CacheMagic, sizeof(magic)) != 0 ||
+		!Read(ifs, version) || version != CacheVersion || !Read(ifs, count))
+	{
+		MAGMA_WARNING("Failed to load pipeline cache file '" + m_path + "', the file is invalid or outdated");
+		return;
+	}
+
+	for (unsigned long long i = 0; i < count; ++i)
+	{
+		unsigned long long key = 0, size = 0;
+		std::vector<unsigned char> data;
+		if (Read(ifs, key) && Read(ifs, size) && size <= fileSize - static_cast<unsigned long long>(ifs.tellg()))
+		{
+			data.resize(static_cast<size_t>(size));
+			if (size == 0 || ifs.read(reinterpret_cast<char*>(data.data()), size))
+			{
+				m_blobs[key] = std::move(data);
+				continue;
+			}
+		}
+
+		MAGMA_WARNING("Failed to load pipeline cache file '" + m_path + "', the file is truncated");
+		m_blobs.clear();
+		return;
+	}
+}
+
+Magma::FilePipelineCacheStorage::~FilePipelineCacheStorage()
+{
+	this->Save();
+}
+
+bool Magma::FilePipelineCacheStorage::Save()
+{
+	if (!m_dirty)
+		return true;
+
+	std::ofstream ofs(m_path, std::ios::binary | std::ios::trunc);
+	if (!ofs.is_open())
+	{
+		MAGMA_WARNING("Failed to save pipeline cache file '" + m_path + "', couldn't open file");
+		return false;
+	}
+
+	ofs.write(CacheMagic, sizeof(CacheMagic));
+	Write(ofs, CacheVersion);
+	Write(ofs, static_cast<unsigned long long>(m_blobs.size()));
+	for (auto& blob : m_blobs)
+	{
+		Write(ofs, blob.first);
+		Write(ofs, static_cast<unsigned long long>(blob.second.size()));
+		ofs.write(reinterpret_cast<const char*>(blob.second.data()), blob.second.size());
+	}
+
+	if (!ofs)
+	{
+		MAGMA_WARNING("Failed to save pipeline cache file '" + m_path + "', couldn't write file");
+		return false;
+	}
+
+	m_dirty = false;
+	return true;
+}
+
+bool Magma::FilePipelineCacheStorage::Load(unsigned long long key, std::vector<unsigned char>& data)
+{
+	auto it = m_blobs.find(key);
+	if (it == m_blobs.end())
+		return false;
+	data = it->second;
+	return true;
+}
+
+void Magma::FilePipelineCacheStorage::Store(unsigned long long key, const void * data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	m_blobs[key].assign(bytes, bytes + size);
+	m_dirty = true;
+}
+
+Magma::PipelineCache::PipelineCache(PipelineCacheStorage * storage)
+	: m_storage(storage)
+{
+
+}
+
+unsigned long long Magma::PipelineCache::MakeKey(const char * vertexCode, const char * pixelCode, const char * driver)
+{
+	unsigned long long hash = FNVOffsetBasis;
+	hash = (hash ^ CacheVersion) * FNVPrime;
+	hash = Hash(hash, vertexCode);
+	hash = Hash(hash, pixelCode);
+	hash = Hash(hash, driver);
+	return hash;
+}
+
+bool Magma::PipelineCache::Load(unsigned long long key, std::vector<unsigned char>& binary)
+{
+	if (m_storage != nullptr && m_storage->Load(key, binary) && !binary.empty())
+	{
+		++m_hits;
+		return true;
+	}
+
+	++m_misses;
+	return false;
+}
+
+void Magma::PipelineCache::Store(unsigned long long key, const void * binary, size_t size)
+{
+	if (m_storage != nullptr)
+		m_storage->Store(key, binary, size);
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Magma
+{
+	/// <summary>
+	///		Storage backend of a pipeline cache, mapping keys to opaque binary blobs
+	/// </summary>
+	class PipelineCacheStorage
+	{
+	public:
+		virtual ~PipelineCacheStorage() = default;
+
+		/// <summary>
+		///		Loads the blob stored with a key
+		/// </summary>
+		/// <param name="key">Blob key</param>
+		/// <param name="data">Out blob data</param>
+		/// <returns>True if the key was found, otherwise false</returns>
+		virtual bool Load(unsigned long long key, std::vector<unsigned char>& data) = 0;
+
+		/// <summary>
+		///		Stores a blob with a key, replacing the blob previously stored with it
+		/// </summary>
+		/// <param name="key">Blob key</param>
+		/// <param name="data">Blob data</param>
+		/// <param name="size">Blob size in bytes</param>
+		virtual void Store(unsigned long long key, const void* data, size_t size) = 0;
+	};
+
+	/// <summary>
+	///		Pipeline cache storage kept in memory
+	/// </summary>
+	class MemoryPipelineCacheStorage : public PipelineCacheStorage
+	{
+	public:
+		/// <summary>
+		///		Gets the number of blobs stored
+		/// </summary>
+		/// <returns>Number of blobs</returns>
+		inline size_t GetSize() const { return m_blobs.size(); }
+
+		// Inherited via PipelineCacheStorage
+		virtual bool Load(unsigned long long key, std::vector<unsigned char>& data) override;
+		virtual void Store(unsigned long long key, const void* data, size_t size) override;
+
+	private:
+		std::map<unsigned long long, std::vector<unsigned char>> m_blobs;
+	};
+
+	/// <summary>
+	///		Pipeline cache storage persisted to a single file.
+	///		The file is read when the storage is created and rewritten on Save (or destruction) if anything was stored.
+	/// </summary>
+	class FilePipelineCacheStorage : public PipelineCacheStorage
+	{
+	public:
+		/// <summary>
+		///		Opens the storage, loading the blobs in the file if it exists and is valid
+		/// </summary>
+		/// <param name="path">Cache file path</param>
+		FilePipelineCacheStorage(const std::string& path);
+		virtual ~FilePipelineCacheStorage() override;
+
+		/// <summary>
+		///		Writes the blobs to the cache file, if anything was stored since it was last written
+		/// </summary>
+		/// <returns>True if the file is up to date, false if it couldn't be written</returns>
+		bool Save();
+
+		// Inherited via PipelineCacheStorage
+		virtual bool Load(unsigned long long key, std::vector<unsigned char>& data) override;
+		virtual void Store(unsigned long long key, const void* data, size_t size) override;
+
+	private:
+		std::string m_path;
+		std::map<unsigned long long, std::vector<unsigned char>> m_blobs;
+		bool m_dirty = false;
+	};
+
+	/// <summary>
+	///		Caches linked pipeline binaries, keyed by the hash of their shader sources and of the driver that built them,
+	///		so that pipelines seen on previous runs are loaded instead of being compiled again
+	/// </summary>
+	class PipelineCache final
+	{
+	public:
+		/// <summary>
+		///		Creates a pipeline cache
+		/// </summary>
+		/// <param name="storage">Storage backend (not owned, must outlive the cache)</param>
+		PipelineCache(PipelineCacheStorage* storage);
+
+		/// <summary>
+		///		Builds the key of a pipeline (64 bit FNV-1a hash)
+		/// </summary>
+		/// <param name="vertexCode">Vertex shader source</param>
+		/// <param name="pixelCode">Pixel shader source</param>
+		/// <param name="driver">Driver identification (vendor, renderer and version), as binaries are only valid on the driver that built them</param>
+		/// <returns>Pipeline key</returns>
+		static unsigned long long MakeKey(const char* vertexCode, const char* pixelCode, const char* driver);
+
+		/// <summary>
+		///		Loads a pipeline binary
+		/// </summary>
+		/// <param name="key">Pipeline key</param>
+		/// <param name="binary">Out pipeline binary</param>
+		/// <returns>True on a hit, false on a miss</returns>
+		bool Load(unsigned long long key, std::vector<unsigned char>& binary);
+
+		/// <summary>
+		///		Stores a pipeline binary
+		/// </summary>
+		/// <param name="key">Pipeline key</param>
+		/// <param name="binary">Pipeline binary</param>
+		/// <param name="size">Binary size in bytes</param>
+		void Store(unsigned long long key, const void* binary, size_t size);
+
+		inline PipelineCacheStorage* GetStorage() const { return m_storage; }
+		inline unsigned long long GetHits() const { return m_hits; }
+		inline unsigned long long GetMisses() const { return m_misses; }
+
+	private:
+		PipelineCacheStorage* m_storage;
+		unsigned long long m_hits = 0;
+		unsigned long long m_misses = 0;
+	};
+}
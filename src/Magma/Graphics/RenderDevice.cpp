@@ -0,0 +1,49 @@
+#include "RenderDevice.hpp"
+#include "CommandBuffer.hpp"
+
+void Magma::RenderDevice::Submit(CommandBuffer * commandBuffer)
+{
+	commandBuffer->Execute(this);
+}
+
+Magma::Texture2D * Magma::RenderDevice::CreateTexture2D(int width, int height, const void * data)
+{
+	Texture2DDesc desc;
+	desc.width = width;
+	desc.height = height;
+	desc.format = TextureFormat::RGBA8;
+	desc.mipLevels = 0;
+	desc.generateMips = true;
+	desc.data = data != nullptr ? &data : nullptr;
+	return this->CreateTexture2D(desc);
+}
+
+long long Magma::RenderDevice::GetImageSize(TextureFormat format, int width, int height)
+{
+	// Bytes per pixel, or per 4x4 block for compressed formats
+	static const long long sizes[] = { 1, 2, 4, 4, 8, 16, 2, 4, 4, 4, 8, 16, 16, 8, 16, 16, 16, 8, 16 };
+	static_assert(sizeof(sizes) / sizeof(*sizes) == static_cast<size_t>(TextureFormat::Count), "Missing texture format sizes");
+
+	if (format >= TextureFormat::BC1)
+		return ((width + 3) / 4) * ((height + 3) / 4) * sizes[static_cast<size_t>(format)];
+	return static_cast<long long>(width) * height * sizes[static_cast<size_t>(format)];
+}
+
+int Magma::RenderDevice::GetFullMipLevels(int width, int height)
+{
+	int levels = 1;
+	for (int size = width > height ? width : height; size > 1; size /= 2)
+		++levels;
+	return levels;
+}
+
+int Magma::RenderDevice::GetVertexElementSize(VertexElementType type, int size)
+{
+	// Bytes per component
+	static const int sizes[] = { 1, 2, 4, 1, 2, 4, 1, 2, 4, 1, 2, 4, 2, 4, 8 };
+
+	// Packed types hold every component in 32 bits
+	if (type == VertexElementType::Int1010102Normalize)
+		return 4;
+	return sizes[static_cast<size_t>(type)] * size;
+}
@@ -2,8 +2,14 @@
 
 // This architecture is based on https://github.com/amesgames/RenderDevice
 
+#include "FrameStats.hpp"
+
 namespace Magma
 {
+	class CommandBuffer;
+	class PipelineCache;
+	class UniformBuffer;
+
 	/// <summary>
 	///		Encapsulates a vertex shader
 	/// </summary>
@@ -47,6 +53,22 @@ namespace Magma
 		PipelineParam() = default;
 	};
 
+	/// <summary>
+	///		Identifies a pipeline param, the 32 bit FNV-1a hash of its name (without the "[0]" suffix of arrays)
+	/// </summary>
+	typedef unsigned int ParamID;
+
+	/// <summary>
+	///		Computes the ID of a pipeline param. Can be evaluated at compile time, so that params are fetched without any string work.
+	/// </summary>
+	/// <param name="name">Param name</param>
+	/// <param name="hash">Hash of the preceding characters</param>
+	/// <returns>Param ID</returns>
+	constexpr ParamID MakeParamID(const char *name, ParamID hash = 2166136261u)
+	{
+		return *name == '\0' ? hash : MakeParamID(name + 1, (hash ^ static_cast<unsigned char>(*name)) * 16777619u);
+	}
+
 	/// <summary>
 	///		Encapsulates a shader pipeline
 	/// </summary>
@@ -55,12 +77,63 @@ namespace Magma
 	public:
 		virtual ~Pipeline() = default;
 
-		virtual PipelineParam *GetParam(const char *name) = 0;
+		/// <summary>
+		///		Gets a param of the pipeline
+		/// </summary>
+		/// <param name="id">Param ID (see MakeParamID)</param>
+		/// <returns>Param, or nullptr if the pipeline has no param with this ID</returns>
+		virtual PipelineParam *GetParam(ParamID id) = 0;
+
+		/// <summary>
+		///		Gets a param of the pipeline by name, hashing the name into its ID
+		/// </summary>
+		/// <param name="name">Param name</param>
+		/// <returns>Param, or nullptr if the pipeline has no param with this name</returns>
+		inline PipelineParam *GetParam(const char *name) { return this->GetParam(MakeParamID(name)); }
+
+		/// <summary>
+		///		Sources a uniform block of the pipeline from a range of a uniform buffer, instead of from the params set on the pipeline.
+		///		The buffer must stay alive while set.
+		/// </summary>
+		/// <param name="id">Uniform block ID (see MakeParamID, from the block name)</param>
+		/// <param name="uniformBuffer">Uniform buffer (null to go back to the params)</param>
+		/// <param name="offset">Offset in bytes of the range, a multiple of 256</param>
+		virtual void SetUniformBuffer(ParamID id, UniformBuffer *uniformBuffer, long long offset = 0) = 0;
+
+		/// <summary>
+		///		Sources a uniform block of the pipeline from a range of a uniform buffer, by block name
+		/// </summary>
+		/// <param name="name">Uniform block name</param>
+		/// <param name="uniformBuffer">Uniform buffer (null to go back to the params)</param>
+		/// <param name="offset">Offset in bytes of the range, a multiple of 256</param>
+		inline void SetUniformBuffer(const char *name, UniformBuffer *uniformBuffer, long long offset = 0) { this->SetUniformBuffer(MakeParamID(name), uniformBuffer, offset); }
 	protected:
 		// Ensure these are never created directly
 		Pipeline() = default;
 	};
 
+	/// <summary>
+	///		How often the contents of a buffer are expected to change
+	/// </summary>
+	enum class BufferUsage
+	{
+		/// <summary>
+		///		Set once and drawn many times
+		/// </summary>
+		Static = 0,
+
+		/// <summary>
+		///		Updated every now and then
+		/// </summary>
+		Dynamic,
+
+		/// <summary>
+		///		Rewritten every frame. Stream buffers hold three regions of the requested size,
+		///		so that the CPU writes one while the GPU still reads the others.
+		/// </summary>
+		Stream,
+	};
+
 	/// <summary>
 	///		Encapsulates a vertex buffer
 	/// </summary>
@@ -97,6 +170,15 @@ namespace Magma
 		VertexArray() = default;
 	};
 
+	/// <summary>
+	///		Size of the indices stored in an index buffer
+	/// </summary>
+	enum class IndexFormat
+	{
+		UInt16 = 0,
+		UInt32,
+	};
+
 	/// <summary>
 	///		Encapsulates an index buffer
 	/// </summary>
@@ -110,6 +192,55 @@ namespace Magma
 		IndexBuffer() = default;
 	};
 
+	/// <summary>
+	///		Encapsulates a buffer of uniform block data shared by many draws (e.g. material tables), set on pipelines with Pipeline::SetUniformBuffer
+	/// </summary>
+	class UniformBuffer
+	{
+	public:
+		virtual ~UniformBuffer() = default;
+
+	protected:
+		// Ensure these are never created directly
+		UniformBuffer() = default;
+	};
+
+	/// <summary>
+	///		Encapsulates a buffer of draw arguments, read by the GPU on indirect draws
+	/// </summary>
+	class IndirectBuffer
+	{
+	public:
+		virtual ~IndirectBuffer() = default;
+
+	protected:
+		// Ensure these are never created directly
+		IndirectBuffer() = default;
+	};
+
+	/// <summary>
+	///		Arguments of a non indexed draw, as stored in indirect buffers
+	/// </summary>
+	struct DrawIndirectCommand
+	{
+		unsigned int count;
+		unsigned int instanceCount;
+		unsigned int first;
+		unsigned int baseInstance;
+	};
+
+	/// <summary>
+	///		Arguments of an indexed draw, as stored in indirect buffers
+	/// </summary>
+	struct DrawIndexedIndirectCommand
+	{
+		unsigned int count;
+		unsigned int instanceCount;
+		unsigned int firstIndex;
+		int baseVertex;
+		unsigned int baseInstance;
+	};
+
 	/// <summary>
 	///		Encapsulates a 2D texture
 	/// </summary>
@@ -122,6 +253,117 @@ namespace Magma
 		Texture2D() = default;
 	};
 
+	/// <summary>
+	///		Pixel formats of textures
+	/// </summary>
+	enum class TextureFormat
+	{
+		R8 = 0,
+		RG8,
+		RGBA8,
+		SRGBA8,
+		RGBA16F,
+		RGBA32F,
+
+		/// <summary>
+		///		Depth formats, for render target depth attachments
+		/// </summary>
+		Depth16,
+		Depth24,
+		Depth32F,
+		Depth24Stencil8,
+
+		/// <summary>
+		///		Compressed formats, stored in 4x4 pixel blocks
+		/// </summary>
+		BC1,
+		BC2,
+		BC3,
+		BC4,
+		BC5,
+		BC6H,
+		BC7,
+		ETC2RGB8,
+		ETC2RGBA8,
+
+		Count
+	};
+
+	/// <summary>
+	///		Describes a 2D texture (or 2D texture array)
+	/// </summary>
+	struct Texture2DDesc
+	{
+		int width = 0;
+		int height = 0;
+		TextureFormat format = TextureFormat::RGBA8;
+
+		/// <summary>
+		///		Number of mip levels (zero for a full mip chain)
+		/// </summary>
+		int mipLevels = 1;
+
+		/// <summary>
+		///		Number of array layers (a 2D texture array is created when greater than one)
+		/// </summary>
+		int arrayLayers = 1;
+
+		/// <summary>
+		///		Generate every mip level from level zero after uploading it (uncompressed formats only)
+		/// </summary>
+		bool generateMips = false;
+
+		/// <summary>
+		///		Image data, one pointer per layer and level, at data[layer * mipLevels + level] (leave null for uninitialized textures).
+		///		When generating mips, only level zero of each layer is read. Individual pointers may be null.
+		/// </summary>
+		const void* const* data = nullptr;
+	};
+
+	/// <summary>
+	///		Encapsulates the sampling state of textures
+	/// </summary>
+	class Sampler
+	{
+	public:
+		virtual ~Sampler() = default;
+	protected:
+		// Ensure these are never created directly
+		Sampler() = default;
+	};
+
+	enum class TextureFilter
+	{
+		Nearest = 0,
+		Linear,
+		Count
+	};
+
+	enum class TextureWrap
+	{
+		Repeat = 0,
+		MirroredRepeat,
+		ClampToEdge,
+		Count
+	};
+
+	/// <summary>
+	///		Describes a sampler
+	/// </summary>
+	struct SamplerDesc
+	{
+		TextureFilter minFilter = TextureFilter::Linear;
+		TextureFilter magFilter = TextureFilter::Linear;
+		TextureFilter mipFilter = TextureFilter::Linear;
+		TextureWrap wrapU = TextureWrap::ClampToEdge;
+		TextureWrap wrapV = TextureWrap::ClampToEdge;
+
+		/// <summary>
+		///		Maximum anisotropy (one disables anisotropic filtering)
+		/// </summary>
+		float maxAnisotropy = 1.0f;
+	};
+
 	enum class VertexElementType
 	{
 		Bytee = 0,
@@ -142,7 +384,10 @@ namespace Magma
 
 		HalfFloat,
 		Float,
-		Double
+		Double,
+
+		// Signed normalized x, y and z in 10 bits each and w in 2 bits, packed in 32 bits (x in the lowest bits). The size must be 4
+		Int1010102Normalize
 	};
 
 	/// <summary>
@@ -174,6 +419,61 @@ namespace Magma
 		///		Offset where first occurrence of this vertex element resides in the buffer
 		/// </summary>
 		long long offset;
+
+		/// <summary>
+		///		Number of instances drawn before the element advances (leave zero for per vertex elements)
+		/// </summary>
+		unsigned int divisor;
+	};
+
+	/// <summary>
+	///		Encapsulates a render target (framebuffer), the set of textures draws render into
+	/// </summary>
+	class RenderTarget
+	{
+	public:
+		virtual ~RenderTarget() = default;
+	protected:
+		// Ensure these are never created directly
+		RenderTarget() = default;
+	};
+
+	/// <summary>
+	///		Describes a render target
+	/// </summary>
+	struct RenderTargetDesc
+	{
+		static const unsigned int MaxColorAttachments = 4;
+
+		/// <summary>
+		///		Render target size, every attached texture must be at least this large (their level 0 is attached)
+		/// </summary>
+		int width = 0;
+		int height = 0;
+
+		/// <summary>
+		///		Color textures, rendered into (or resolved into, when multisampled), bound to the pixel shader outputs 0 to colorCount - 1.
+		///		Textures aren't owned by the render target and must outlive it.
+		/// </summary>
+		Texture2D* colorTextures[MaxColorAttachments] = {};
+		unsigned int colorCount = 0;
+
+		/// <summary>
+		///		Optional depth texture (with a depth format), e.g. for shadow maps
+		/// </summary>
+		Texture2D* depthTexture = nullptr;
+
+		/// <summary>
+		///		Depth format of the depth buffer created for the render target when no depth texture is given
+		///		(TextureFormat::Count for no depth buffer)
+		/// </summary>
+		TextureFormat depthFormat = TextureFormat::Count;
+
+		/// <summary>
+		///		Samples per pixel. Multisampled render targets render into internal buffers,
+		///		which are resolved into the textures by RenderDevice::ResolveRenderTarget.
+		/// </summary>
+		int samples = 1;
 	};
 
 	/// <summary>
@@ -281,7 +581,105 @@ namespace Magma
 		Count
 	};
 
-	
+	/// <summary>
+	///		Encapsulates the blend state
+	/// </summary>
+	class BlendState
+	{
+	public:
+		virtual ~BlendState() = default;
+	protected:
+		// Ensure these are never created directly
+		BlendState() = default;
+	};
+
+	enum class BlendFactor
+	{
+		Zero = 0,
+		One,
+		SrcColor,
+		InvSrcColor,
+		SrcAlpha,
+		InvSrcAlpha,
+		DstColor,
+		InvDstColor,
+		DstAlpha,
+		InvDstAlpha,
+		Count
+	};
+
+	enum class BlendOp
+	{
+		// Source + destination
+		Add = 0,
+
+		// Source - destination
+		Subtract,
+
+		// Destination - source
+		RevSubtract,
+
+		// Minimum of source and destination (factors are ignored)
+		Min,
+
+		// Maximum of source and destination (factors are ignored)
+		Max,
+
+		Count
+	};
+
+	/// <summary>
+	///		Bits of the color write mask of a blend state
+	/// </summary>
+	enum ColorWrite : unsigned int
+	{
+		ColorWriteRed = 1,
+		ColorWriteGreen = 2,
+		ColorWriteBlue = 4,
+		ColorWriteAlpha = 8,
+		ColorWriteAll = 15,
+	};
+
+	/// <summary>
+	///		Encapsulates an immutable pipeline state: a shader pipeline and the raster, depth/stencil and blend states it is drawn with.
+	///		Switching between pipeline states only issues the API calls whose values differ between them.
+	/// </summary>
+	class PipelineState
+	{
+	public:
+		virtual ~PipelineState() = default;
+	protected:
+		// Ensure these are never created directly
+		PipelineState() = default;
+	};
+
+	/// <summary>
+	///		Describes a pipeline state. The states are copied when the pipeline state is created and may be destroyed right after,
+	///		the shader pipeline must outlive it. Vertex layouts are bound with vertex arrays.
+	/// </summary>
+	struct PipelineStateDesc
+	{
+		/// <summary>
+		///		Shader pipeline
+		/// </summary>
+		Pipeline* pipeline = nullptr;
+
+		/// <summary>
+		///		Raster state (null for the default one)
+		/// </summary>
+		RasterState* rasterState = nullptr;
+
+		/// <summary>
+		///		Depth/stencil state (null for the default one)
+		/// </summary>
+		DepthStencilState* depthStencilState = nullptr;
+
+		/// <summary>
+		///		Blend state (null for the default one, blending disabled)
+		/// </summary>
+		BlendState* blendState = nullptr;
+	};
+
 	/// <summary>
 	///		Encapsulates the render device API.
 	/// </summary>
@@ -317,19 +715,36 @@ namespace Magma
 		virtual void DestroyPixelShader(PixelShader *pixelShader) = 0;
 
 		/// <summary>
-		///		Create a linked shader pipeline given a vertex and pixel shader
+		///		Create a linked shader pipeline given a vertex and pixel shader.
+		///		The pipeline is returned right away and may be compiled and linked in the background:
+		///		draws using it are skipped until it is ready. The shaders may be destroyed right after.
+		///		Getting a param from a pipeline that isn't ready waits for it.
 		/// </summary>
 		/// <param name="vertexShader">Vertex shader</param>
 		/// <param name="pixelShader">Pixel shader</param>
 		/// <returns>Shader pipeline</returns>
 		virtual Pipeline *CreatePipeline(VertexShader *vertexShader, PixelShader *pixelShader) = 0;
 
+		/// <summary>
+		///		Checks if a shader pipeline is done compiling and linking, and can be drawn with
+		/// </summary>
+		/// <param name="pipeline">Shader pipeline</param>
+		/// <returns>True if ready, false if still building or if it failed to build</returns>
+		virtual bool IsPipelineReady(Pipeline *pipeline) = 0;
+
 		/// <summary>
 		///		Destroys a shader pipeline
 		/// </summary>
 		/// <param name="pipeline">Shader pipeline</param>
 		virtual void DestroyPipeline(Pipeline *pipeline) = 0;
 
+		/// <summary>
+		///		Sets the cache used to load the pipelines created from now on, and to store the ones it doesn't have yet.
+		///		Shaders are only compiled when a pipeline using them misses the cache.
+		/// </summary>
+		/// <param name="pipelineCache">Pipeline cache (not owned, null to disable caching)</param>
+		virtual void SetPipelineCache(PipelineCache *pipelineCache) = 0;
+
 		/// <summary>
 		///		Sets a shader pipeline as active for subsequent draw commands
 		/// </summary>
@@ -341,8 +756,27 @@ namespace Magma
 		/// </summary>
 		/// <param name="size">Buffer size</param>
 		/// <param name="data">Buffer data</param>
+		/// <param name="usage">Buffer usage</param>
+		/// <returns>Vertex buffer</returns>
+		virtual VertexBuffer *CreateVertexBuffer(long long size, const void *data = nullptr, BufferUsage usage = BufferUsage::Static) = 0;
+
+		/// <summary>
+		///		Creates a vertex buffer whose data is uploaded in the background.
+		///		The data isn't copied and must stay alive until the buffer is ready (or destroyed).
+		///		Uploads progress on EndFrame.
+		/// </summary>
+		/// <param name="size">Buffer size</param>
+		/// <param name="data">Buffer data</param>
+		/// <param name="usage">Buffer usage</param>
 		/// <returns>Vertex buffer</returns>
-		virtual VertexBuffer *CreateVertexBuffer(long long size, const void *data = nullptr) = 0;
+		virtual VertexBuffer *CreateVertexBufferAsync(long long size, const void *data, BufferUsage usage = BufferUsage::Static) = 0;
+
+		/// <summary>
+		///		Checks if the data of a vertex buffer was uploaded
+		/// </summary>
+		/// <param name="vertexBuffer">Vertex buffer</param>
+		/// <returns>True if ready, otherwise false</returns>
+		virtual bool IsVertexBufferReady(VertexBuffer *vertexBuffer) = 0;
 
 		/// <summary>
 		///		Destroys a vertex buffer
@@ -350,6 +784,39 @@ namespace Magma
 		/// <param name="vertexBuffer">Vertex buffer</param>
 		virtual void DestroyVertexBuffer(VertexBuffer *vertexBuffer) = 0;
 
+		/// <summary>
+		///		Updates a range of a vertex buffer (of the current region, for stream buffers)
+		/// </summary>
+		/// <param name="vertexBuffer">Vertex buffer</param>
+		/// <param name="offset">Offset in bytes of the range</param>
+		/// <param name="size">Size in bytes of the range</param>
+		/// <param name="data">New data</param>
+		virtual void UpdateVertexBuffer(VertexBuffer *vertexBuffer, long long offset, long long size, const void *data) = 0;
+
+		/// <summary>
+		///		Maps a range of a vertex buffer for writing (of the current region, for stream buffers).
+		///		Stream buffers never wait for the GPU, as their current region is never being read.
+		/// </summary>
+		/// <param name="vertexBuffer">Vertex buffer</param>
+		/// <param name="offset">Offset in bytes of the range</param>
+		/// <param name="size">Size in bytes of the range</param>
+		/// <returns>Pointer to the range, valid until the buffer is unmapped</returns>
+		virtual void *MapVertexBuffer(VertexBuffer *vertexBuffer, long long offset, long long size) = 0;
+
+		/// <summary>
+		///		Unmaps a vertex buffer, it must be unmapped before being drawn with
+		/// </summary>
+		/// <param name="vertexBuffer">Vertex buffer</param>
+		virtual void UnmapVertexBuffer(VertexBuffer *vertexBuffer) = 0;
+
+		/// <summary>
+		///		Moves a stream vertex buffer to its next region, waiting for the GPU to finish the draws that read it three advances ago.
+		///		Call once per frame, before writing the buffer. Does nothing on static and dynamic buffers.
+		/// </summary>
+		/// <param name="vertexBuffer">Vertex buffer</param>
+		/// <returns>Offset in bytes of the new region within the buffer, to be added to draw offsets</returns>
+		virtual long long AdvanceVertexBuffer(VertexBuffer *vertexBuffer) = 0;
+
 		/// <summary>
 		///		Creates a vertex description given an array of VertexElement structures
 		/// </summary>
@@ -390,8 +857,10 @@ namespace Magma
 		/// </summary>
 		/// <param name="size">Index buffer size</param>
 		/// <param name="data">Index buffer data</param>
+		/// <param name="usage">Index buffer usage</param>
+		/// <param name="format">Index format</param>
 		/// <returns></returns>
-		virtual IndexBuffer *CreateIndexBuffer(long long size, const void *data = nullptr) = 0;
+		virtual IndexBuffer *CreateIndexBuffer(long long size, const void *data = nullptr, BufferUsage usage = BufferUsage::Static, IndexFormat format = IndexFormat::UInt32) = 0;
 
 		/// <summary>
 		///		Destroy an index buffer
@@ -399,25 +868,130 @@ namespace Magma
 		/// <param name="indexBuffer">Index buffer</param>
 		virtual void DestroyIndexBuffer(IndexBuffer *indexBuffer) = 0;
 
+		/// <summary>
+		///		Updates a range of an index buffer (of the current region, for stream buffers)
+		/// </summary>
+		/// <param name="indexBuffer">Index buffer</param>
+		/// <param name="offset">Offset in bytes of the range</param>
+		/// <param name="size">Size in bytes of the range</param>
+		/// <param name="data">New data</param>
+		virtual void UpdateIndexBuffer(IndexBuffer *indexBuffer, long long offset, long long size, const void *data) = 0;
+
+		/// <summary>
+		///		Maps a range of an index buffer for writing (of the current region, for stream buffers).
+		///		Stream buffers never wait for the GPU, as their current region is never being read.
+		/// </summary>
+		/// <param name="indexBuffer">Index buffer</param>
+		/// <param name="offset">Offset in bytes of the range</param>
+		/// <param name="size">Size in bytes of the range</param>
+		/// <returns>Pointer to the range, valid until the buffer is unmapped</returns>
+		virtual void *MapIndexBuffer(IndexBuffer *indexBuffer, long long offset, long long size) = 0;
+
+		/// <summary>
+		///		Unmaps an index buffer, it must be unmapped before being drawn with
+		/// </summary>
+		/// <param name="indexBuffer">Index buffer</param>
+		virtual void UnmapIndexBuffer(IndexBuffer *indexBuffer) = 0;
+
+		/// <summary>
+		///		Moves a stream index buffer to its next region, waiting for the GPU to finish the draws that read it three advances ago.
+		///		Call once per frame, before writing the buffer. Does nothing on static and dynamic buffers.
+		/// </summary>
+		/// <param name="indexBuffer">Index buffer</param>
+		/// <returns>Offset in bytes of the new region within the buffer, to be added to draw offsets</returns>
+		virtual long long AdvanceIndexBuffer(IndexBuffer *indexBuffer) = 0;
+
 		/// <summary>
 		///		Set an index buffer as active for subsequent draw commands
 		/// </summary>
 		/// <param name="indexBuffer">Index buffer</param>
 		virtual void SetIndexBuffer(IndexBuffer *indexBuffer) = 0;
 
+		/// <summary>
+		///		Create an indirect buffer, holding DrawIndirectCommand or DrawIndexedIndirectCommand structures
+		/// </summary>
+		/// <param name="size">Indirect buffer size</param>
+		/// <param name="data">Indirect buffer data</param>
+		/// <returns>Indirect buffer</returns>
+		virtual IndirectBuffer *CreateIndirectBuffer(long long size, const void *data = nullptr) = 0;
+
+		/// <summary>
+		///		Destroy an indirect buffer
+		/// </summary>
+		/// <param name="indirectBuffer">Indirect buffer</param>
+		virtual void DestroyIndirectBuffer(IndirectBuffer *indirectBuffer) = 0;
+
+		/// <summary>
+		///		Map an indirect buffer for writing. The previous contents are discarded.
+		/// </summary>
+		/// <param name="indirectBuffer">Indirect buffer</param>
+		/// <returns>Pointer to the buffer memory, valid until the buffer is unmapped</returns>
+		virtual void *MapIndirectBuffer(IndirectBuffer *indirectBuffer) = 0;
+
+		/// <summary>
+		///		Unmap an indirect buffer, it must be unmapped before being drawn with
+		/// </summary>
+		/// <param name="indirectBuffer">Indirect buffer</param>
+		virtual void UnmapIndirectBuffer(IndirectBuffer *indirectBuffer) = 0;
+
+		/// <summary>
+		///		Create a uniform buffer
+		/// </summary>
+		/// <param name="size">Uniform buffer size</param>
+		/// <param name="data">Uniform buffer data</param>
+		/// <returns>Uniform buffer</returns>
+		virtual UniformBuffer *CreateUniformBuffer(long long size, const void *data = nullptr) = 0;
+
+		/// <summary>
+		///		Destroy a uniform buffer
+		/// </summary>
+		/// <param name="uniformBuffer">Uniform buffer</param>
+		virtual void DestroyUniformBuffer(UniformBuffer *uniformBuffer) = 0;
+
+		/// <summary>
+		///		Updates a range of a uniform buffer
+		/// </summary>
+		/// <param name="uniformBuffer">Uniform buffer</param>
+		/// <param name="offset">Offset in bytes of the range</param>
+		/// <param name="size">Size in bytes of the range</param>
+		/// <param name="data">New data</param>
+		virtual void UpdateUniformBuffer(UniformBuffer *uniformBuffer, long long offset, long long size, const void *data) = 0;
+
 		/// <summary>
 		///		Create a 2D texture.
 		/// 
 		///		Data is assumed to consist of 32-bit pixel values where
-		///		1 byte is used for each of the red, green and blue components,
-		///		from lowest to highest byte order. The most significant byte
-		///		is ignored.
+		///		1 byte is used for each of the red, green, blue and alpha components,
+		///		from lowest to highest byte order. A full mip chain is generated.
 		/// </summary>
 		/// <param name="width">Texture width</param>
 		/// <param name="height">Texture height</param>
 		/// <param name="data">Texture data</param>
 		/// <returns>Texture</returns>
-		virtual Texture2D *CreateTexture2D(int width, int height, const void *data = nullptr) = 0;
+		Texture2D *CreateTexture2D(int width, int height, const void *data = nullptr);
+
+		/// <summary>
+		///		Create a 2D texture (or 2D texture array) from a description
+		/// </summary>
+		/// <param name="desc">Texture description</param>
+		/// <returns>Texture</returns>
+		virtual Texture2D *CreateTexture2D(const Texture2DDesc &desc) = 0;
+
+		/// <summary>
+		///		Create a 2D texture whose data is uploaded in the background.
+		///		The image data isn't copied and must stay alive until the texture is ready (or destroyed).
+		///		Until then, setting the texture on a slot leaves the slot empty. Uploads progress on EndFrame.
+		/// </summary>
+		/// <param name="desc">Texture description</param>
+		/// <returns>Texture</returns>
+		virtual Texture2D *CreateTexture2DAsync(const Texture2DDesc &desc) = 0;
+
+		/// <summary>
+		///		Checks if the data of a 2D texture was uploaded
+		/// </summary>
+		/// <param name="texture2D">Texture</param>
+		/// <returns>True if ready, otherwise false</returns>
+		virtual bool IsTexture2DReady(Texture2D *texture2D) = 0;
 
 		/// <summary>
 		///		Destroy a 2D texture.
@@ -432,6 +1006,78 @@ namespace Magma
 		/// <param name="texture2D">Texture</param>
 		virtual void SetTexture2D(unsigned int slot, Texture2D *texture2D) = 0;
 
+		/// <summary>
+		///		Replaces an image of a 2D texture (e.g. a layer of a texture array).
+		///		May be called in the middle of a frame, the textures set on the slots are kept for the following draws.
+		/// </summary>
+		/// <param name="texture2D">Texture</param>
+		/// <param name="layer">Array layer</param>
+		/// <param name="level">Mip level</param>
+		/// <param name="data">Image data, with the size of the level</param>
+		/// <param name="generateMips">Generate the levels below this one from it (uncompressed formats only, regenerates every layer)</param>
+		virtual void UpdateTexture2D(Texture2D *texture2D, int layer, int level, const void *data, bool generateMips = false) = 0;
+
+		/// <summary>
+		///		Gets a bindless handle of a 2D texture sampled with a sampler, which shaders can sample without the texture being set on a slot
+		///		(passed as an uvec2, GL_ARB_bindless_texture). The texture and sampler must not be destroyed while their handles are in use.
+		/// </summary>
+		/// <param name="texture2D">Texture</param>
+		/// <param name="sampler">Sampler (null for the default sampler)</param>
+		/// <returns>Handle, or zero if bindless textures aren't supported</returns>
+		virtual unsigned long long GetTexture2DHandle(Texture2D *texture2D, Sampler *sampler = nullptr) = 0;
+
+		/// <summary>
+		///		Creates a sampler
+		/// </summary>
+		/// <param name="desc">Sampler description</param>
+		/// <returns>Sampler</returns>
+		virtual Sampler *CreateSampler(const SamplerDesc &desc) = 0;
+
+		/// <summary>
+		///		Destroys a sampler
+		/// </summary>
+		/// <param name="sampler">Sampler</param>
+		virtual void DestroySampler(Sampler *sampler) = 0;
+
+		/// <summary>
+		///		Set a sampler as active on a texture slot for subsequent draw commands
+		/// </summary>
+		/// <param name="slot">Texture slot</param>
+		/// <param name="sampler">Sampler (null for the default sampler: trilinear, clamped to edge)</param>
+		virtual void SetSampler(unsigned int slot, Sampler *sampler) = 0;
+
+		/// <summary>
+		///		Gets the size of one image of a certain format
+		/// </summary>
+		/// <param name="format">Texture format</param>
+		/// <param name="width">Image width</param>
+		/// <param name="height">Image height</param>
+		/// <returns>Size in bytes</returns>
+		static long long GetImageSize(TextureFormat format, int width, int height);
+
+		/// <summary>
+		///		Gets the number of mip levels in a full mip chain
+		/// </summary>
+		/// <param name="width">Texture width</param>
+		/// <param name="height">Texture height</param>
+		/// <returns>Number of mip levels</returns>
+		static int GetFullMipLevels(int width, int height);
+
+		/// <summary>
+		///		Gets the size of a vertex element
+		/// </summary>
+		/// <param name="type">Element type</param>
+		/// <param name="size">Number of components</param>
+		/// <returns>Size in bytes</returns>
+		static int GetVertexElementSize(VertexElementType type, int size);
+
+		/// <summary>
+		///		Checks if a texture format is a depth format
+		/// </summary>
+		/// <param name="format">Texture format</param>
+		/// <returns>True if depth, otherwise false</returns>
+		static inline bool IsDepthFormat(TextureFormat format) { return format >= TextureFormat::Depth16 && format <= TextureFormat::Depth24Stencil8; }
+
 		/// <summary>
 		///		Creates a raster state
 		/// </summary>
@@ -491,7 +1137,106 @@ namespace Magma
 		virtual void SetDepthStencilState(DepthStencilState *depthStencilState) = 0;
 
 		/// <summary>
-		///		Clear the default render target's color buffer, depth buffer, and stencil buffer to the specified values
+		///		Create a blend state. The blend factors and operations are set separately for color and alpha.
+		/// </summary>
+		/// <param name="blendEnabled">Blending enabled?</param>
+		/// <param name="srcColor">Source color factor</param>
+		/// <param name="dstColor">Destination color factor</param>
+		/// <param name="colorOp">Color blend operation</param>
+		/// <param name="srcAlpha">Source alpha factor</param>
+		/// <param name="dstAlpha">Destination alpha factor</param>
+		/// <param name="alphaOp">Alpha blend operation</param>
+		/// <param name="colorWriteMask">Channels written (ColorWrite bits)</param>
+		/// <returns>Blend state</returns>
+		virtual BlendState *CreateBlendState(bool blendEnabled = false,
+											 BlendFactor srcColor = BlendFactor::One,
+											 BlendFactor dstColor = BlendFactor::Zero,
+											 BlendOp colorOp = BlendOp::Add,
+											 BlendFactor srcAlpha = BlendFactor::One,
+											 BlendFactor dstAlpha = BlendFactor::Zero,
+											 BlendOp alphaOp = BlendOp::Add,
+											 unsigned int colorWriteMask = ColorWriteAll) = 0;
+
+		/// <summary>
+		///		Destroy a blend state
+		/// </summary>
+		/// <param name="blendState">Blend state</param>
+		virtual void DestroyBlendState(BlendState *blendState) = 0;
+
+		/// <summary>
+		///		Set a blend state for subsequent draw commands
+		/// </summary>
+		/// <param name="blendState">Blend state (null for the default one, blending disabled)</param>
+		virtual void SetBlendState(BlendState *blendState) = 0;
+
+		/// <summary>
+		///		Creates an immutable pipeline state
+		/// </summary>
+		/// <param name="desc">Pipeline state description</param>
+		/// <returns>Pipeline state, or nullptr if the description has no shader pipeline</returns>
+		virtual PipelineState *CreatePipelineState(const PipelineStateDesc &desc) = 0;
+
+		/// <summary>
+		///		Destroys a pipeline state (its shader pipeline is kept)
+		/// </summary>
+		/// <param name="pipelineState">Pipeline state</param>
+		virtual void DestroyPipelineState(PipelineState *pipelineState) = 0;
+
+		/// <summary>
+		///		Sets the shader pipeline and the raster, depth/stencil and blend states of a pipeline state for subsequent draw commands,
+		///		as if set one by one, but only issuing the calls that change the current state.
+		/// </summary>
+		/// <param name="pipelineState">Pipeline state (null to unset the pipeline and set the default states)</param>
+		virtual void SetPipelineState(PipelineState *pipelineState) = 0;
+
+		/// <summary>
+		///		Creates a render target
+		/// </summary>
+		/// <param name="desc">Render target description</param>
+		/// <returns>Render target, or nullptr if the description is invalid or unsupported</returns>
+		virtual RenderTarget *CreateRenderTarget(const RenderTargetDesc &desc) = 0;
+
+		/// <summary>
+		///		Destroys a render target (the attached textures are kept)
+		/// </summary>
+		/// <param name="renderTarget">Render target</param>
+		virtual void DestroyRenderTarget(RenderTarget *renderTarget) = 0;
+
+		/// <summary>
+		///		Sets the render target subsequent clears and draws render into, and sets the viewport to cover it.
+		///		Setting null renders into the default framebuffer (the window), leaving the viewport to be set with SetViewport.
+		/// </summary>
+		/// <param name="renderTarget">Render target</param>
+		virtual void SetRenderTarget(RenderTarget *renderTarget) = 0;
+
+		/// <summary>
+		///		Resolves a multisampled render target into its textures, does nothing for single sampled render targets
+		/// </summary>
+		/// <param name="renderTarget">Render target</param>
+		virtual void ResolveRenderTarget(RenderTarget *renderTarget) = 0;
+
+		/// <summary>
+		///		Sets the rectangle of the current render target draws are mapped to
+		/// </summary>
+		/// <param name="x">Left edge, in pixels</param>
+		/// <param name="y">Bottom edge, in pixels</param>
+		/// <param name="width">Width, in pixels</param>
+		/// <param name="height">Height, in pixels</param>
+		virtual void SetViewport(int x, int y, int width, int height) = 0;
+
+		/// <summary>
+		///		Reads pixels of the first color attachment of the current render target (resolved, when multisampled),
+		///		or of the default framebuffer, as RGBA8 rows from bottom to top. Waits for the GPU to finish rendering.
+		/// </summary>
+		/// <param name="x">Left edge, in pixels</param>
+		/// <param name="y">Bottom edge, in pixels</param>
+		/// <param name="width">Width, in pixels</param>
+		/// <param name="height">Height, in pixels</param>
+		/// <param name="data">Out pixels, width * height * 4 bytes</param>
+		virtual void ReadPixels(int x, int y, int width, int height, void *data) = 0;
+
+		/// <summary>
+		///		Clear the current render target's color buffers, depth buffer, and stencil buffer to the specified values
 		/// </summary>
 		/// <param name="red">Red channel</param>
 		/// <param name="green">Green channel</param>
@@ -510,10 +1255,88 @@ namespace Magma
 
 		/// <summary>
 		///		Draw a collection of triangles using the currently active shader pipeline, vertex array data,
-		///		and index buffer
+		///		and index buffer, always reading 32 bit indices
+		/// </summary>
+		/// <param name="offset">Starting offset in bytes in index buffer</param>
+		/// <param name="count">Index count</param>
+		virtual void DrawTrianglesIndexed32(long long offset, int count) = 0;
+
+		/// <summary>
+		///		Draw a collection of triangles using the currently active shader pipeline, vertex array data,
+		///		and index buffer, reading indices with the format of the index buffer
+		/// </summary>
+		/// <param name="offset">Starting offset in bytes in index buffer</param>
+		/// <param name="count">Index count</param>
+		virtual void DrawTrianglesIndexed(long long offset, int count) = 0;
+
+		/// <summary>
+		///		Draw several instances of a collection of triangles using the currently active shader pipeline and vertex array data
 		/// </summary>
 		/// <param name="offset">Starting offset in vertex array</param>
 		/// <param name="count">Triangle count</param>
-		virtual void DrawTrianglesIndexed32(long long offset, int count) = 0;
+		/// <param name="instanceCount">Number of instances</param>
+		virtual void DrawTrianglesInstanced(int offset, int count, int instanceCount) = 0;
+
+		/// <summary>
+		///		Draw several instances of a collection of triangles using the currently active shader pipeline, vertex array data,
+		///		and index buffer (with the format of the index buffer)
+		/// </summary>
+		/// <param name="offset">Starting offset in bytes in index buffer</param>
+		/// <param name="count">Index count</param>
+		/// <param name="instanceCount">Number of instances</param>
+		virtual void DrawTrianglesIndexedInstanced(long long offset, int count, int instanceCount) = 0;
+
+		/// <summary>
+		///		Draw collections of triangles described by DrawIndirectCommand structures in an indirect buffer,
+		///		using the currently active shader pipeline and vertex array data
+		/// </summary>
+		/// <param name="indirectBuffer">Indirect buffer</param>
+		/// <param name="offset">Offset in bytes of the first command in the indirect buffer</param>
+		/// <param name="drawCount">Number of commands</param>
+		virtual void DrawTrianglesIndirect(IndirectBuffer *indirectBuffer, long long offset, int drawCount) = 0;
+
+		/// <summary>
+		///		Draw collections of triangles described by DrawIndexedIndirectCommand structures in an indirect buffer,
+		///		using the currently active shader pipeline, vertex array data and index buffer (with the format of the index buffer)
+		/// </summary>
+		/// <param name="indirectBuffer">Indirect buffer</param>
+		/// <param name="offset">Offset in bytes of the first command in the indirect buffer</param>
+		/// <param name="drawCount">Number of commands</param>
+		virtual void DrawTrianglesIndexedIndirect(IndirectBuffer *indirectBuffer, long long offset, int drawCount) = 0;
+
+		/// <summary>
+		///		Begins a timing scope (e.g. "shadows"), measuring the CPU time until EndScope and the GPU time taken by the commands submitted
+		///		in between. Scopes may be nested. The timings are available from the frame profiler (GPU timings a few frames later).
+		/// </summary>
+		/// <param name="name">Scope name</param>
+		virtual void BeginScope(const char *name) = 0;
+
+		/// <summary>
+		///		Ends the timing scope most recently begun
+		/// </summary>
+		virtual void EndScope() = 0;
+
+		/// <summary>
+		///		Gets the profiler holding the timings and counters of the last frames
+		/// </summary>
+		/// <returns>Frame profiler</returns>
+		inline const FrameProfiler& GetProfiler() const { return m_profiler; }
+
+		/// <summary>
+		///		Ends the current frame, progressing the asynchronous uploads and pipeline builds and finishing the frame's stats.
+		///		Must be called once per frame, before the window is displayed.
+		/// </summary>
+		virtual void EndFrame() = 0;
+
+		/// <summary>
+		///		Replays the commands recorded in a command buffer.
+		///		Command buffers may be recorded on any thread, but must be submitted from the device thread.
+		/// </summary>
+		/// <param name="commandBuffer">Command buffer</param>
+		virtual void Submit(CommandBuffer *commandBuffer);
+
+	protected:
+		// Filled by the implementations with the work they are submitted
+		FrameProfiler m_profiler;
 	};
 }
\ No newline at end of file
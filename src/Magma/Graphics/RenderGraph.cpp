@@ -0,0 +1,344 @@
+#include "RenderGraph.hpp"
+#include "..\Utils\Utils.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	bool IsCompatible(const Magma::Texture2DDesc& a, const Magma::Texture2DDesc& b)
+	{
+		return a.width == b.width && a.height == b.height && a.format == b.format &&
+			   a.mipLevels == b.mipLevels && a.arrayLayers == b.arrayLayers;
+	}
+
+	void AddUnique(std::vector<Magma::RenderGraphResource>& list, Magma::RenderGraphResource resource)
+	{
+		if (std::find(list.begin(), list.end(), resource) == list.end())
+			list.push_back(resource);
+	}
+}
+
+Magma::RenderGraphResource Magma::RenderGraphBuilder::Create(const char * name, const Texture2DDesc & desc)
+{
+	return this->Write(m_graph->Create(name, desc));
+}
+
+Magma::RenderGraphResource Magma::RenderGraphBuilder::Read(RenderGraphResource resource)
+{
+	if (resource >= m_graph->m_resources.size())
+	{
+		MAGMA_WARNING("Failed to declare render graph pass read, invalid resource");
+		return RenderGraph::InvalidResource;
+	}
+	AddUnique(m_graph->m_passes[m_pass].reads, resource);
+	return resource;
+}
+
+Magma::RenderGraphResource Magma::RenderGraphBuilder::Write(RenderGraphResource resource)
+{
+	if (resource >= m_graph->m_resources.size())
+	{
+		MAGMA_WARNING("Failed to declare render graph pass write, invalid resource");
+		return RenderGraph::InvalidResource;
+	}
+	AddUnique(m_graph->m_passes[m_pass].writes, resource);
+	return resource;
+}
+
+void Magma::RenderGraphBuilder::SetSideEffects()
+{
+	m_graph->m_passes[m_pass].sideEffects = true;
+}
+
+Magma::Texture2D * Magma::RenderGraphResources::GetTexture(RenderGraphResource resource) const
+{
+	if (!m_graph->Uses(m_pass, resource))
+	{
+		MAGMA_WARNING("Failed to get render graph texture, the pass didn't declare the resource");
+		return nullptr;
+	}
+	return m_graph->m_resources[resource].texture;
+}
+
+Magma::RenderGraph::RenderGraph(RenderDevice * device)
+	: m_device(device)
+{
+
+}
+
+Magma::RenderGraph::~RenderGraph()
+{
+	for (auto& pooled : m_pool)
+		m_device->DestroyTexture2D(pooled.texture);
+}
+
+void Magma::RenderGraph::AddPass(const char * name, const SetupFunction & setup, const ExecuteFunction & execute)
+{
+	m_passes.emplace_back();
+	m_passes.back().name = name;
+	m_passes.back().execute = execute;
+	m_compiled = false;
+
+	RenderGraphBuilder builder(this, m_passes.size() - 1);
+	if (setup)
+		setup(builder);
+}
+
+Magma::RenderGraphResource Magma::RenderGraph::Create(const char * name, const Texture2DDesc & desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	resource.desc.data = nullptr;
+	resource.desc.generateMips = false;
+	m_resources.push_back(resource);
+	return static_cast<RenderGraphResource>(m_resources.size() - 1);
+}
+
+Magma::RenderGraphResource Magma::RenderGraph::Import(const char * name, Texture2D * texture)
+{
+	Resource resource;
+	resource.name = name;
+	resource.imported = true;
+	resource.texture = texture;
+	m_resources.push_back(resource);
+	return static_cast<RenderGraphResource>(m_resources.size() - 1);
+}
+
+bool Magma::RenderGraph::Compile()
+{
+	m_stats = Stats();
+	m_order.clear();
+	m_compiled = false;
+
+	this->Cull();
+	if (!this->Sort())
+		return false;
+	this->Allocate();
+
+	m_stats.passes = static_cast<unsigned int>(m_order.size());
+	m_stats.culledPasses = static_cast<unsigned int>(m_passes.size() - m_order.size());
+	m_compiled = true;
+	return true;
+}
+
+void Magma::RenderGraph::Execute()
+{
+	if (!m_compiled)
+	{
+		MAGMA_WARNING("Failed to execute render graph, it isn't compiled");
+		return;
+	}
+
+	for (size_t pass : m_order)
+		if (m_passes[pass].execute)
+			m_passes[pass].execute(m_device, RenderGraphResources(this, pass));
+}
+
+void Magma::RenderGraph::Clear()
+{
+	m_resources.clear();
+	m_passes.clear();
+	m_order.clear();
+	m_compiled = false;
+}
+
+void Magma::RenderGraph::Trim()
+{
+	for (auto it = m_pool.begin(); it != m_pool.end();)
+		if (it->busyUntil < 0)
+		{
+			m_device->DestroyTexture2D(it->texture);
+			it = m_pool.erase(it);
+		}
+		else
+			++it;
+}
+
+std::vector<std::string> Magma::RenderGraph::GetExecutionOrder() const
+{
+	std::vector<std::string> names;
+	for (size_t pass : m_order)
+		names.push_back(m_passes[pass].name);
+	return names;
+}
+
+bool Magma::RenderGraph::Uses(size_t pass, RenderGraphResource resource) const
+{
+	const Pass& p = m_passes[pass];
+	return std::find(p.reads.begin(), p.reads.end(), resource) != p.reads.end() ||
+		   std::find(p.writes.begin(), p.writes.end(), resource) != p.writes.end();
+}
+
+void Magma::RenderGraph::Cull()
+{
+	// Passes with side effects or writing imported resources are kept, along with every pass they depend on
+	std::vector<size_t> stack;
+	for (size_t i = 0; i < m_passes.size(); ++i)
+	{
+		Pass& pass = m_passes[i];
+		pass.culled = !pass.sideEffects;
+		for (auto resource : pass.writes)
+			if (m_resources[resource].imported)
+				pass.culled = false;
+		if (!pass.culled)
+			stack.push_back(i);
+	}
+
+	while (!stack.empty())
+	{
+		const size_t reader = stack.back();
+		stack.pop_back();
+		for (auto resource : m_passes[reader].reads)
+			for (size_t i = 0; i < m_passes.size(); ++i)
+				if (m_passes[i].culled && std::find(m_passes[i].writes.begin(), m_passes[i].writes.end(), resource) != m_passes[i].writes.end())
+				{
+					m_passes[i].culled = false;
+					stack.push_back(i);
+				}
+	}
+}
+
+bool Magma::RenderGraph::Sort()
+{
+	// Dependencies between the kept passes: readers run after the writers declared before them (or after every writer,
+	// if the resource is only written by passes declared later), later writers run after earlier writers and readers
+	const size_t count = m_passes.size();
+	std::vector<std::vector<size_t>> dependents(count);
+	std::vector<size_t> dependencies(count, 0);
+	auto addEdge = [&](size_t before, size_t after)
+	{
+		if (before == after || m_passes[before].culled || m_passes[after].culled)
+			return;
+		if (std::find(dependents[before].begin(), dependents[before].end(), after) != dependents[before].end())
+			return;
+		dependents[before].push_back(after);
+		++dependencies[after];
+	};
+	auto writes = [&](size_t pass, RenderGraphResource resource)
+	{
+		return std::find(m_passes[pass].writes.begin(), m_passes[pass].writes.end(), resource) != m_passes[pass].writes.end();
+	};
+
+	for (size_t p = 0; p < count; ++p)
+	{
+		if (m_passes[p].culled)
+			continue;
+
+		for (auto resource : m_passes[p].reads)
+		{
+			bool writtenBefore = false;
+			for (size_t w = 0; w < p; ++w)
+				if (!m_passes[w].culled && writes(w, resource))
+				{
+					addEdge(w, p);
+					writtenBefore = true;
+				}
+
+			for (size_t w = p + 1; w < count; ++w)
+				if (!m_passes[w].culled && writes(w, resource))
+				{
+					if (writtenBefore)
+						addEdge(p, w);
+					else
+						addEdge(w, p);
+				}
+		}
+
+		for (auto resource : m_passes[p].writes)
+			for (size_t w = p + 1; w < count; ++w)
+				if (writes(w, resource))
+					addEdge(p, w);
+	}
+
+	// Topological sort, picking the earliest declared pass whenever there's a choice
+	std::vector<bool> scheduled(count, false);
+	size_t kept = 0;
+	for (auto& pass : m_passes)
+		if (!pass.culled)
+			++kept;
+
+	while (m_order.size() < kept)
+	{
+		size_t next = count;
+		for (size_t p = 0; p < count && next == count; ++p)
+			if (!m_passes[p].culled && !scheduled[p] && dependencies[p] == 0)
+				next = p;
+
+		if (next == count)
+		{
+			MAGMA_WARNING("Failed to compile render graph, its passes depend on each other in a cycle");
+			m_order.clear();
+			return false;
+		}
+
+		scheduled[next] = true;
+		m_order.push_back(next);
+		for (size_t dependent : dependents[next])
+			--dependencies[dependent];
+	}
+
+	return true;
+}
+
+void Magma::RenderGraph::Allocate()
+{
+	// Find the lifetime of every resource, in execution order
+	std::vector<bool> used(m_resources.size(), false);
+	for (auto& resource : m_resources)
+		resource.firstUse = resource.lastUse = 0;
+	for (size_t i = 0; i < m_order.size(); ++i)
+	{
+		const Pass& pass = m_passes[m_order[i]];
+		for (const auto* list : { &pass.reads, &pass.writes })
+			for (auto r : *list)
+			{
+				Resource& resource = m_resources[r];
+				if (!used[r])
+					resource.firstUse = i;
+				resource.lastUse = std::max(resource.lastUse, i);
+				used[r] = true;
+			}
+	}
+
+	std::vector<RenderGraphResource> transients;
+	for (RenderGraphResource r = 0; r < m_resources.size(); ++r)
+		if (!m_resources[r].imported)
+		{
+			m_resources[r].texture = nullptr;
+			if (used[r])
+				transients.push_back(r);
+		}
+	std::sort(transients.begin(), transients.end(), [this](RenderGraphResource a, RenderGraphResource b)
+	{
+		return m_resources[a].firstUse < m_resources[b].firstUse;
+	});
+
+	// Assign each transient resource a compatible pooled texture that is free by its first use
+	for (auto& pooled : m_pool)
+		pooled.busyUntil = -1;
+	for (auto r : transients)
+	{
+		Resource& resource = m_resources[r];
+		PooledTexture* match = nullptr;
+		for (auto& pooled : m_pool)
+			if (pooled.busyUntil < static_cast<long long>(resource.firstUse) && IsCompatible(pooled.desc, resource.desc))
+			{
+				match = &pooled;
+				break;
+			}
+
+		if (match == nullptr)
+		{
+			m_pool.push_back({ resource.desc, m_device->CreateTexture2D(resource.desc), -1 });
+			match = &m_pool.back();
+		}
+
+		if (match->busyUntil < 0)
+			++m_stats.textures;
+		match->busyUntil = static_cast<long long>(resource.lastUse);
+		resource.texture = match->texture;
+	}
+
+	m_stats.transientResources = static_cast<unsigned int>(transients.size());
+}
@@ -0,0 +1,221 @@
+#pragma once
+
+#include "RenderDevice.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Magma
+{
+	class RenderGraph;
+
+	/// <summary>
+	///		Handle of a texture resource in a render graph
+	/// </summary>
+	typedef unsigned int RenderGraphResource;
+
+	/// <summary>
+	///		Declares the resources a render graph pass reads and writes, during its setup
+	/// </summary>
+	class RenderGraphBuilder final
+	{
+	public:
+		/// <summary>
+		///		Creates a transient texture, only alive while the frame's passes use it.
+		///		Transient textures whose lifetimes don't overlap share the same memory. The creating pass writes it.
+		/// </summary>
+		/// <param name="name">Resource name (for debugging)</param>
+		/// <param name="desc">Texture description (the data and generateMips fields are ignored)</param>
+		/// <returns>Resource handle</returns>
+		RenderGraphResource Create(const char* name, const Texture2DDesc& desc);
+
+		/// <summary>
+		///		Declares that the pass reads a resource
+		/// </summary>
+		/// <param name="resource">Resource handle</param>
+		/// <returns>Resource handle</returns>
+		RenderGraphResource Read(RenderGraphResource resource);
+
+		/// <summary>
+		///		Declares that the pass writes a resource
+		/// </summary>
+		/// <param name="resource">Resource handle</param>
+		/// <returns>Resource handle</returns>
+		RenderGraphResource Write(RenderGraphResource resource);
+
+		/// <summary>
+		///		Prevents the pass from being culled even if nothing reads what it writes
+		/// </summary>
+		void SetSideEffects();
+
+	private:
+		friend class RenderGraph;
+
+		RenderGraphBuilder(RenderGraph* graph, size_t pass) : m_graph(graph), m_pass(pass) {}
+
+		RenderGraph* m_graph;
+		size_t m_pass;
+	};
+
+	/// <summary>
+	///		Gives a pass access to the textures backing the resources it declared, during its execution
+	/// </summary>
+	class RenderGraphResources final
+	{
+	public:
+		/// <summary>
+		///		Gets the texture backing a resource declared by the pass
+		/// </summary>
+		/// <param name="resource">Resource handle</param>
+		/// <returns>Texture, or nullptr if the pass didn't declare the resource</returns>
+		Texture2D* GetTexture(RenderGraphResource resource) const;
+
+	private:
+		friend class RenderGraph;
+
+		RenderGraphResources(const RenderGraph* graph, size_t pass) : m_graph(graph), m_pass(pass) {}
+
+		const RenderGraph* m_graph;
+		size_t m_pass;
+	};
+
+	/// <summary>
+	///		Schedules the render passes of a frame from the resources they read and write.
+	///		Every frame: add the passes and import the external textures, Compile, Execute, then Clear.
+	///		Compiling culls the passes whose results aren't used, orders the rest so that every pass runs after the passes
+	///		writing what it reads (keeping the declaration order otherwise), and assigns textures to the transient resources,
+	///		aliasing the ones whose lifetimes don't overlap. Textures are pooled between frames.
+	/// </summary>
+	class RenderGraph final
+	{
+	public:
+		typedef std::function<void(RenderGraphBuilder&)> SetupFunction;
+		typedef std::function<void(RenderDevice*, const RenderGraphResources&)> ExecuteFunction;
+
+		static const RenderGraphResource InvalidResource = 0xFFFFFFFF;
+
+		/// <summary>
+		///		Counters of the last compiled frame
+		/// </summary>
+		struct Stats
+		{
+			unsigned int passes = 0;
+			unsigned int culledPasses = 0;
+			unsigned int transientResources = 0;
+			unsigned int textures = 0;
+		};
+
+		/// <summary>
+		///		Creates a render graph
+		/// </summary>
+		/// <param name="device">Render device passes are executed on, and transient textures created with</param>
+		RenderGraph(RenderDevice* device);
+		~RenderGraph();
+
+		RenderGraph(const RenderGraph&) = delete;
+		RenderGraph& operator=(const RenderGraph&) = delete;
+
+		/// <summary>
+		///		Adds a pass, its setup function is called right away to declare its resources
+		/// </summary>
+		/// <param name="name">Pass name (for debugging)</param>
+		/// <param name="setup">Setup function</param>
+		/// <param name="execute">Execute function, called on Execute if the pass isn't culled</param>
+		void AddPass(const char* name, const SetupFunction& setup, const ExecuteFunction& execute);
+
+		/// <summary>
+		///		Declares a transient texture ahead of the passes using it, so that passes may be added in any order
+		/// </summary>
+		/// <param name="name">Resource name (for debugging)</param>
+		/// <param name="desc">Texture description (the data and generateMips fields are ignored)</param>
+		/// <returns>Resource handle</returns>
+		RenderGraphResource Create(const char* name, const Texture2DDesc& desc);
+
+		/// <summary>
+		///		Imports an external texture (e.g. the frame's output). Imported textures are never aliased,
+		///		and the passes writing them are never culled.
+		/// </summary>
+		/// <param name="name">Resource name (for debugging)</param>
+		/// <param name="texture">Texture (may be null for the default framebuffer)</param>
+		/// <returns>Resource handle</returns>
+		RenderGraphResource Import(const char* name, Texture2D* texture);
+
+		/// <summary>
+		///		Culls, orders the passes and assigns textures to the transient resources
+		/// </summary>
+		/// <returns>True on success, false if the passes depend on each other in a cycle</returns>
+		bool Compile();
+
+		/// <summary>
+		///		Executes the passes kept by Compile, in order
+		/// </summary>
+		void Execute();
+
+		/// <summary>
+		///		Removes every pass and resource, keeping the pooled textures for the next frame
+		/// </summary>
+		void Clear();
+
+		/// <summary>
+		///		Destroys the pooled textures not used by the last compiled frame
+		/// </summary>
+		void Trim();
+
+		inline const Stats& GetStats() const { return m_stats; }
+
+		/// <summary>
+		///		Gets the passes kept by the last compile, in execution order
+		/// </summary>
+		/// <returns>Pass names</returns>
+		std::vector<std::string> GetExecutionOrder() const;
+
+	private:
+		friend class RenderGraphBuilder;
+		friend class RenderGraphResources;
+
+		struct Resource
+		{
+			std::string name;
+			Texture2DDesc desc;
+			bool imported = false;
+			Texture2D* texture = nullptr;
+			// Execution order indices of the first and last passes using the resource
+			size_t firstUse = 0;
+			size_t lastUse = 0;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			ExecuteFunction execute;
+			std::vector<RenderGraphResource> reads;
+			std::vector<RenderGraphResource> writes;
+			bool sideEffects = false;
+			bool culled = false;
+		};
+
+		// Texture owned by the graph, shared by the transient resources it is assigned to
+		struct PooledTexture
+		{
+			Texture2DDesc desc;
+			Texture2D* texture;
+			// Execution order index of the last pass using it this frame, or -1 if unused
+			long long busyUntil;
+		};
+
+		bool Uses(size_t pass, RenderGraphResource resource) const;
+		void Cull();
+		bool Sort();
+		void Allocate();
+
+		RenderDevice* m_device;
+		std::vector<Resource> m_resources;
+		std::vector<Pass> m_passes;
+		// Indices of the passes to execute, in order
+		std::vector<size_t> m_order;
+		std::vector<PooledTexture> m_pool;
+		bool m_compiled = false;
+		Stats m_stats;
+	};
+}
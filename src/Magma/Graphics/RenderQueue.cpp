@@ -0,0 +1,292 @@
+#include "RenderQueue.hpp"
+#include "CommandBuffer.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	const unsigned long long LayerBits = 8;
+	const unsigned long long IDBits = 12;
+	const unsigned long long DepthBits = 20;
+	const unsigned long long TranslucentDepthBits = 32;
+
+	unsigned long long QuantizeDepth(float depth, unsigned long long bits)
+	{
+		const unsigned long long max = (1ull << bits) - 1;
+		if (!(depth > 0.0f))
+			return 0;
+		if (depth >= 1.0f)
+			return max;
+		return static_cast<unsigned long long>(static_cast<double>(depth) * max);
+	}
+
+	unsigned long long Field(unsigned int value, unsigned long long bits)
+	{
+		return value & ((1ull << bits) - 1);
+	}
+
+	// Parameter sets differ between the device and command buffers
+	void SetTransform(Magma::RenderDevice* device, Magma::PipelineParam* param, const float* transform)
+	{
+		param->SetAsMat4(transform);
+	}
+
+	void SetTransform(Magma::CommandBuffer* commandBuffer, Magma::PipelineParam* param, const float* transform)
+	{
+		commandBuffer->SetParamMat4(param, transform);
+	}
+
+	void SetInt(Magma::RenderDevice* device, Magma::PipelineParam* param, int value)
+	{
+		param->SetAsInt(value);
+	}
+
+	void SetInt(Magma::CommandBuffer* commandBuffer, Magma::PipelineParam* param, int value)
+	{
+		commandBuffer->SetParamInt(param, value);
+	}
+
+	void SetTransforms(Magma::RenderDevice* device, Magma::PipelineParam* param, int count, const float* transforms)
+	{
+		param->SetAsMat4Array(count, transforms);
+	}
+
+	void SetTransforms(Magma::CommandBuffer* commandBuffer, Magma::PipelineParam* param, int count, const float* transforms)
+	{
+		commandBuffer->SetParamMat4Array(param, count, transforms);
+	}
+
+	// Only devices know when pipelines are ready, command buffers record every draw
+	bool IsPipelineReady(Magma::RenderDevice* device, Magma::Pipeline* pipeline)
+	{
+		return pipeline == nullptr || device->IsPipelineReady(pipeline);
+	}
+
+	bool IsPipelineReady(Magma::CommandBuffer* commandBuffer, Magma::Pipeline* pipeline)
+	{
+		return true;
+	}
+
+	const float Identity[16] =
+	{
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f,
+	};
+}
+
+unsigned long long Magma::RenderQueue::MakeSortKey(unsigned int layer, unsigned int pipeline, unsigned int textureSet, unsigned int vertexArray, float depth)
+{
+	unsigned long long key = Field(layer, LayerBits);
+	key = (key << IDBits) | Field(pipeline, IDBits);
+	key = (key << IDBits) | Field(textureSet, IDBits);
+	key = (key << IDBits) | Field(vertexArray, IDBits);
+	key = (key << DepthBits) | QuantizeDepth(depth, DepthBits);
+	return key;
+}
+
+unsigned long long Magma::RenderQueue::MakeTranslucentSortKey(unsigned int layer, float depth, unsigned int pipeline, unsigned int textureSet)
+{
+	// Invert the depth so that far draws come first
+	unsigned long long key = Field(layer, LayerBits);
+	key = (key << TranslucentDepthBits) | (((1ull << TranslucentDepthBits) - 1) - QuantizeDepth(depth, TranslucentDepthBits));
+	key = (key << IDBits) | Field(pipeline, IDBits);
+	key = (key << IDBits) | Field(textureSet, IDBits);
+	return key;
+}
+
+void Magma::RenderQueue::Reserve(size_t count)
+{
+	m_items.reserve(count);
+	m_entries.reserve(count);
+	m_sortBuffer.reserve(count);
+}
+
+void Magma::RenderQueue::SetMaxInstances(unsigned int maxInstances)
+{
+	m_maxInstances = maxInstances > 0 ? maxInstances : 1;
+}
+
+void Magma::RenderQueue::SetFallbackPipeline(Pipeline * pipeline, PipelineParam * transformParam)
+{
+	m_fallbackPipeline = pipeline;
+	m_fallbackTransformParam = transformParam;
+}
+
+void Magma::RenderQueue::Submit(unsigned long long key, const DrawItem & item)
+{
+	m_entries.push_back({ key, m_items.size() });
+	m_items.push_back(item);
+}
+
+void Magma::RenderQueue::Sort()
+{
+	const size_t count = m_entries.size();
+	if (count < 2)
+		return;
+
+	// Build the histograms of every byte in a single pass
+	size_t histograms[8][256] = {};
+	for (const Entry& e : m_entries)
+		for (size_t b = 0; b < 8; ++b)
+			++histograms[b][(e.key >> (b * 8)) & 0xFF];
+
+	m_sortBuffer.resize(count);
+	Entry* src = m_entries.data();
+	Entry* dst = m_sortBuffer.data();
+
+	// Least significant byte first, skipping bytes that are equal in every key
+	for (size_t b = 0; b < 8; ++b)
+	{
+		size_t* histogram = histograms[b];
+		if (histogram[(src[0].key >> (b * 8)) & 0xFF] == count)
+			continue;
+
+		size_t offset = 0;
+		for (size_t i = 0; i < 256; ++i)
+		{
+			size_t c = histogram[i];
+			histogram[i] = offset;
+			offset += c;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+			dst[histogram[(src[i].key >> (b * 8)) & 0xFF]++] = src[i];
+
+		std::swap(src, dst);
+	}
+
+	if (src != m_entries.data())
+		m_entries.swap(m_sortBuffer);
+}
+
+void Magma::RenderQueue::Execute(RenderDevice * device) const
+{
+	this->Issue(device);
+}
+
+void Magma::RenderQueue::Record(CommandBuffer * commandBuffer) const
+{
+	this->Issue(commandBuffer);
+}
+
+void Magma::RenderQueue::Clear()
+{
+	m_items.clear();
+	m_entries.clear();
+}
+
+bool Magma::RenderQueue::CanInstance(const DrawItem & first, const DrawItem & other)
+{
+	if (other.instanceTransformsParam != first.instanceTransformsParam ||
+		other.pipeline != first.pipeline ||
+		other.vertexArray != first.vertexArray ||
+		other.indexBuffer != first.indexBuffer ||
+		other.offset != first.offset ||
+		other.count != first.count ||
+		other.textureCount != first.textureCount ||
+		other.materialParam != first.materialParam ||
+		(first.materialParam != nullptr && other.material != first.material))
+		return false;
+	for (unsigned int t = 0; t < first.textureCount && t < DrawItem::MaxTextures; ++t)
+		if (other.textures[t] != first.textures[t])
+			return false;
+	return true;
+}
+
+template <typename T>
+void Magma::RenderQueue::Issue(T * target) const
+{
+	Pipeline* pipeline = nullptr;
+	// Pipeline of the previous draw, and whether it is substituted by the fallback or skipped
+	Pipeline* source = nullptr;
+	bool substitute = false;
+	bool skip = false;
+	VertexArray* vertexArray = nullptr;
+	IndexBuffer* indexBuffer = nullptr;
+	Texture2D* textures[DrawItem::MaxTextures] = {};
+	// Material param last set and its value
+	PipelineParam* materialParam = nullptr;
+	int material = 0;
+	bool first = true;
+
+	for (size_t i = 0; i < m_entries.size(); ++i)
+	{
+		const DrawItem& item = m_items[m_entries[i].item];
+
+		if (first || item.pipeline != source)
+		{
+			source = item.pipeline;
+			substitute = skip = false;
+			if (!IsPipelineReady(target, source))
+			{
+				if (m_fallbackPipeline != nullptr && IsPipelineReady(target, m_fallbackPipeline))
+					substitute = true;
+				else
+					skip = true;
+			}
+		}
+		if (skip)
+			continue;
+
+		Pipeline* itemPipeline = substitute ? m_fallbackPipeline : item.pipeline;
+		if (first || itemPipeline != pipeline)
+			target->SetPipeline(pipeline = itemPipeline);
+		if (first || item.vertexArray != vertexArray)
+		{
+			target->SetVertexArray(vertexArray = item.vertexArray);
+			// Index buffer bindings belong to the vertex array
+			indexBuffer = nullptr;
+		}
+		if (item.indexBuffer != nullptr && item.indexBuffer != indexBuffer)
+			target->SetIndexBuffer(indexBuffer = item.indexBuffer);
+		for (unsigned int t = 0; t < item.textureCount && t < DrawItem::MaxTextures; ++t)
+			if (first || item.textures[t] != textures[t])
+				target->SetTexture2D(t, textures[t] = item.textures[t]);
+		if (!substitute && item.materialParam != nullptr && (item.materialParam != materialParam || item.material != material))
+			SetInt(target, materialParam = item.materialParam, material = item.material);
+		first = false;
+
+		if (substitute)
+		{
+			// Instance transforms belong to the original pipeline, substituted draws are issued one by one
+			if (m_fallbackTransformParam != nullptr)
+				SetTransform(target, m_fallbackTransformParam, item.transform != nullptr ? item.transform : Identity);
+		}
+		else if (item.instanceTransformsParam != nullptr)
+		{
+			// Merge the following draws which only differ in their transforms
+			size_t last = i + 1;
+			while (last < m_entries.size() && last - i < m_maxInstances && CanInstance(item, m_items[m_entries[last].item]))
+				++last;
+
+			m_instanceTransforms.clear();
+			for (size_t j = i; j < last; ++j)
+			{
+				const float* transform = m_items[m_entries[j].item].transform;
+				if (transform == nullptr)
+					transform = Identity;
+				m_instanceTransforms.insert(m_instanceTransforms.end(), transform, transform + 16);
+			}
+
+			const int instanceCount = static_cast<int>(last - i);
+			SetTransforms(target, item.instanceTransformsParam, instanceCount, m_instanceTransforms.data());
+			if (item.indexBuffer != nullptr)
+				target->DrawTrianglesIndexedInstanced(item.offset, item.count, instanceCount);
+			else
+				target->DrawTrianglesInstanced(static_cast<int>(item.offset), item.count, instanceCount);
+
+			i = last - 1;
+			continue;
+		}
+
+		else if (item.transformParam != nullptr)
+			SetTransform(target, item.transformParam, item.transform);
+
+		if (item.indexBuffer != nullptr)
+			target->DrawTrianglesIndexed(item.offset, item.count);
+		else
+			target->DrawTriangles(static_cast<int>(item.offset), item.count);
+	}
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "RenderDevice.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace Magma
+{
+	/// <summary>
+	///		Describes a draw submitted to a render queue
+	/// </summary>
+	struct DrawItem
+	{
+		static const unsigned int MaxTextures = 4;
+
+		/// <summary>
+		///		Shader pipeline
+		/// </summary>
+		Pipeline* pipeline = nullptr;
+
+		/// <summary>
+		///		Vertex array
+		/// </summary>
+		VertexArray* vertexArray = nullptr;
+
+		/// <summary>
+		///		Index buffer (leave null for non indexed draws)
+		/// </summary>
+		IndexBuffer* indexBuffer = nullptr;
+
+		/// <summary>
+		///		Textures, set on slots 0 to textureCount - 1
+		/// </summary>
+		Texture2D* textures[MaxTextures] = {};
+		unsigned int textureCount = 0;
+
+		/// <summary>
+		///		Optional per draw transform, set with PipelineParam::SetAsMat4 before drawing.
+		///		The matrix isn't copied and must stay alive until the queue is executed.
+		/// </summary>
+		PipelineParam* transformParam = nullptr;
+		const float* transform = nullptr;
+
+		/// <summary>
+		///		Optional mat4 array param, indexed by the pipeline with the instance ID. When set, the draw is issued instanced
+		///		(transformParam is ignored) and merged with the following draws that share its state, range and instance param,
+		///		their transforms being uploaded to this param.
+		/// </summary>
+		PipelineParam* instanceTransformsParam = nullptr;
+
+		/// <summary>
+		///		Optional int param the material index is set to before drawing (see MaterialSystem::Bind), skipped when it already holds it.
+		///		Draws using different materials with the same textures then only differ in this param.
+		/// </summary>
+		PipelineParam* materialParam = nullptr;
+		int material = 0;
+
+		/// <summary>
+		///		Starting offset (bytes into the index buffer for indexed draws, vertices otherwise)
+		/// </summary>
+		long long offset = 0;
+
+		/// <summary>
+		///		Vertex or index count
+		/// </summary>
+		int count = 0;
+	};
+
+	/// <summary>
+	///		Collects draws tagged with 64 bit sort keys, sorts them and issues them with as few state changes as possible.
+	///		Opaque keys (MakeSortKey) are laid out as [layer:8][pipeline:12][texture set:12][vertex array:12][depth:20], so that
+	///		draws are grouped by state and ordered front to back inside each group.
+	///		Translucent keys (MakeTranslucentSortKey) put the depth right after the layer, ordering draws back to front.
+	/// </summary>
+	class RenderQueue final
+	{
+	public:
+		/// <summary>
+		///		Builds an opaque sort key. Identifiers are truncated to their field sizes.
+		/// </summary>
+		/// <param name="layer">Layer, sorted first (8 bits)</param>
+		/// <param name="pipeline">Pipeline identifier (12 bits)</param>
+		/// <param name="textureSet">Texture set identifier (12 bits)</param>
+		/// <param name="vertexArray">Vertex array identifier (12 bits)</param>
+		/// <param name="depth">Normalized view depth, from 0 (near) to 1 (far)</param>
+		/// <returns>Sort key</returns>
+		static unsigned long long MakeSortKey(unsigned int layer, unsigned int pipeline, unsigned int textureSet, unsigned int vertexArray, float depth);
+
+		/// <summary>
+		///		Builds a translucent sort key, ordering draws in the same layer from back to front
+		/// </summary>
+		/// <param name="layer">Layer, sorted first (8 bits)</param>
+		/// <param name="depth">Normalized view depth, from 0 (near) to 1 (far)</param>
+		/// <param name="pipeline">Pipeline identifier (12 bits)</param>
+		/// <param name="textureSet">Texture set identifier (12 bits)</param>
+		/// <returns>Sort key</returns>
+		static unsigned long long MakeTranslucentSortKey(unsigned int layer, float depth, unsigned int pipeline, unsigned int textureSet);
+
+		/// <summary>
+		///		Reserves memory for a number of draws
+		/// </summary>
+		/// <param name="count">Number of draws</param>
+		void Reserve(size_t count);
+
+		/// <summary>
+		///		Sets the maximum number of draws merged into a single instanced draw.
+		///		Must not exceed the size of the instance transform arrays in the pipelines.
+		/// </summary>
+		/// <param name="maxInstances">Maximum number of instances (64 by default)</param>
+		void SetMaxInstances(unsigned int maxInstances);
+
+		/// <summary>
+		///		Gets the maximum number of draws merged into a single instanced draw
+		/// </summary>
+		/// <returns>Maximum number of instances</returns>
+		inline unsigned int GetMaxInstances() const { return m_maxInstances; }
+
+		/// <summary>
+		///		Sets the pipeline draws are issued with while their own pipeline isn't ready (see RenderDevice::IsPipelineReady).
+		///		Without a ready fallback those draws are skipped. Only Execute checks readiness, recorded draws are skipped by the device.
+		/// </summary>
+		/// <param name="pipeline">Fallback pipeline (null to skip the draws)</param>
+		/// <param name="transformParam">Fallback pipeline mat4 param the draw transforms are set to (may be null)</param>
+		void SetFallbackPipeline(Pipeline* pipeline, PipelineParam* transformParam);
+
+		/// <summary>
+		///		Submits a draw to the queue
+		/// </summary>
+		/// <param name="key">Sort key</param>
+		/// <param name="item">Draw description</param>
+		void Submit(unsigned long long key, const DrawItem& item);
+
+		/// <summary>
+		///		Sorts the submitted draws by their keys (radix sort, stable)
+		/// </summary>
+		void Sort();
+
+		/// <summary>
+		///		Issues the draws in their current order on a render device, skipping redundant state changes
+		/// </summary>
+		/// <param name="device">Render device</param>
+		void Execute(RenderDevice* device) const;
+
+		/// <summary>
+		///		Records the draws in their current order into a command buffer, skipping redundant state changes
+		/// </summary>
+		/// <param name="commandBuffer">Command buffer</param>
+		void Record(CommandBuffer* commandBuffer) const;
+
+		/// <summary>
+		///		Removes every draw from the queue, keeping the allocated memory
+		/// </summary>
+		void Clear();
+
+		/// <summary>
+		///		Gets the number of draws in the queue
+		/// </summary>
+		/// <returns>Number of draws</returns>
+		inline size_t GetSize() const { return m_entries.size(); }
+
+	private:
+		struct Entry
+		{
+			unsigned long long key;
+			size_t item;
+		};
+
+		template <typename T>
+		void Issue(T* target) const;
+
+		// Checks if two draws can be merged into an instanced draw
+		static bool CanInstance(const DrawItem& first, const DrawItem& other);
+
+		std::vector<DrawItem> m_items;
+		std::vector<Entry> m_entries;
+		std::vector<Entry> m_sortBuffer;
+
+		unsigned int m_maxInstances = 64;
+		Pipeline* m_fallbackPipeline = nullptr;
+		PipelineParam* m_fallbackTransformParam = nullptr;
+		// Transforms gathered for the instanced draw being issued
+		mutable std::vector<float> m_instanceTransforms;
+	};
+}
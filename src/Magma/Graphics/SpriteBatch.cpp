@@ -0,0 +1,221 @@
+#include "SpriteBatch.hpp"
+#include "..\Utils\Utils.hpp"
+
+#include <cstddef>
+
+namespace
+{
+	// Number of regions of stream buffers (see RenderDevice::AdvanceVertexBuffer)
+	const unsigned int StreamRegions = 3;
+
+	const long long QuadSize = 4 * sizeof(Magma::SpriteVertex);
+
+	// Builds the indices of two triangles per quad
+	template <typename T>
+	std::vector<T> MakeQuadIndices(unsigned int quadCount)
+	{
+		static const unsigned int pattern[6] = { 0, 1, 2, 2, 1, 3 };
+		std::vector<T> indices(quadCount * 6);
+		for (unsigned int q = 0; q < quadCount; ++q)
+			for (unsigned int i = 0; i < 6; ++i)
+				indices[q * 6 + i] = static_cast<T>(q * 4 + pattern[i]);
+		return indices;
+	}
+
+	unsigned int ToByte(float value)
+	{
+		return static_cast<unsigned int>((value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value)) * 255.0f + 0.5f);
+	}
+}
+
+Magma::SpriteBatch::SpriteBatch(RenderDevice * device, Pipeline * pipeline, unsigned int maxQuads)
+	: m_device(device), m_pipeline(pipeline), m_maxQuads(maxQuads > 0 ? maxQuads : 1)
+{
+	m_vertexBuffer = m_device->CreateVertexBuffer(m_maxQuads * QuadSize, nullptr, BufferUsage::Stream);
+
+	const VertexElement elements[] =
+	{
+		{ 0, VertexElementType::Float, 2, sizeof(SpriteVertex), offsetof(SpriteVertex, x), 0 },
+		{ 1, VertexElementType::Float, 2, sizeof(SpriteVertex), offsetof(SpriteVertex, u), 0 },
+		{ 2, VertexElementType::UByteNormalize, 4, sizeof(SpriteVertex), offsetof(SpriteVertex, color), 0 },
+	};
+	m_vertexDescription = m_device->CreateVertexDescription(3, elements);
+	m_vertexArray = m_device->CreateVertexArray(1, &m_vertexBuffer, &m_vertexDescription);
+
+	// The indices cover every region of the vertex buffer, so that draws only need an index offset. Use 16 bit indices when they fit
+	const unsigned int quadCount = m_maxQuads * StreamRegions;
+	if (quadCount * 4 <= 0x10000)
+	{
+		const std::vector<unsigned short> indices = MakeQuadIndices<unsigned short>(quadCount);
+		m_indexSize = sizeof(unsigned short);
+		m_indexBuffer = m_device->CreateIndexBuffer(indices.size() * m_indexSize, indices.data(), BufferUsage::Static, IndexFormat::UInt16);
+	}
+	else
+	{
+		const std::vector<unsigned int> indices = MakeQuadIndices<unsigned int>(quadCount);
+		m_indexSize = sizeof(unsigned int);
+		m_indexBuffer = m_device->CreateIndexBuffer(indices.size() * m_indexSize, indices.data(), BufferUsage::Static, IndexFormat::UInt32);
+	}
+
+	m_quads.reserve(m_maxQuads);
+	m_quadTextures.reserve(m_maxQuads);
+	m_order.reserve(m_maxQuads);
+}
+
+Magma::SpriteBatch::~SpriteBatch()
+{
+	m_device->DestroyVertexArray(m_vertexArray);
+	m_device->DestroyVertexDescription(m_vertexDescription);
+	m_device->DestroyVertexBuffer(m_vertexBuffer);
+	m_device->DestroyIndexBuffer(m_indexBuffer);
+}
+
+unsigned int Magma::SpriteBatch::MakeColor(float red, float green, float blue, float alpha)
+{
+	return ToByte(red) | (ToByte(green) << 8) | (ToByte(blue) << 16) | (ToByte(alpha) << 24);
+}
+
+void Magma::SpriteBatch::Begin(bool sortByTexture)
+{
+	if (m_inBatch)
+		MAGMA_WARNING("Sprite batch begun twice, discarding the quads of the previous one");
+
+	m_quads.clear();
+	m_quadTextures.clear();
+	m_textures.clear();
+	m_textureIndices.clear();
+	m_sortByTexture = sortByTexture;
+	m_inBatch = true;
+}
+
+void Magma::SpriteBatch::Draw(Texture2D * texture, const float transform[6], const float uv[4], unsigned int color)
+{
+	if (!m_inBatch)
+	{
+		MAGMA_WARNING("Failed to draw sprite, the sprite batch wasn't begun");
+		return;
+	}
+
+	// Successive quads usually share their texture, skip the lookup then
+	unsigned int textureIndex;
+	if (!m_quadTextures.empty() && m_textures[m_quadTextures.back()] == texture)
+		textureIndex = m_quadTextures.back();
+	else
+	{
+		auto it = m_textureIndices.find(texture);
+		if (it == m_textureIndices.end())
+		{
+			it = m_textureIndices.insert(std::make_pair(texture, static_cast<unsigned int>(m_textures.size()))).first;
+			m_textures.push_back(texture);
+		}
+		textureIndex = it->second;
+	}
+
+	// Corners in the order of the quad index pattern
+	Quad quad;
+	const float corners[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+	for (int i = 0; i < 4; ++i)
+	{
+		const float cx = corners[i][0], cy = corners[i][1];
+		SpriteVertex& vertex = quad.vertices[i];
+		vertex.x = transform[0] * cx + transform[2] * cy + transform[4];
+		vertex.y = transform[1] * cx + transform[3] * cy + transform[5];
+		vertex.u = cx == 0.0f ? uv[0] : uv[2];
+		vertex.v = cy == 0.0f ? uv[1] : uv[3];
+		vertex.color = color;
+	}
+
+	m_quads.push_back(quad);
+	m_quadTextures.push_back(textureIndex);
+}
+
+void Magma::SpriteBatch::Draw(Texture2D * texture, float x, float y, float width, float height, unsigned int color)
+{
+	const float transform[6] = { width, 0.0f, 0.0f, height, x, y };
+	const float uv[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+	this->Draw(texture, transform, uv, color);
+}
+
+void Magma::SpriteBatch::End()
+{
+	if (!m_inBatch)
+	{
+		MAGMA_WARNING("Sprite batch ended without being begun");
+		return;
+	}
+	m_inBatch = false;
+	m_drawCount = 0;
+	m_lastQuadCount = m_quads.size();
+	if (m_quads.empty())
+		return;
+
+	const unsigned int quadCount = static_cast<unsigned int>(m_quads.size());
+	m_order.resize(quadCount);
+	if (m_sortByTexture && m_textures.size() > 1)
+	{
+		// Counting sort by texture index, stable so that quads sharing a texture keep their order
+		m_offsets.assign(m_textures.size(), 0);
+		for (auto t : m_quadTextures)
+			++m_offsets[t];
+		unsigned int offset = 0;
+		for (auto& o : m_offsets)
+		{
+			const unsigned int count = o;
+			o = offset;
+			offset += count;
+		}
+		for (unsigned int q = 0; q < quadCount; ++q)
+			m_order[m_offsets[m_quadTextures[q]]++] = q;
+	}
+	else
+		for (unsigned int q = 0; q < quadCount; ++q)
+			m_order[q] = q;
+
+	m_device->SetPipeline(m_pipeline);
+	m_device->SetVertexArray(m_vertexArray);
+	m_device->SetIndexBuffer(m_indexBuffer);
+
+	// Fill the current region, moving to the next one when it is full
+	for (unsigned int first = 0; first < quadCount;)
+	{
+		if (m_regionOffset < 0 || m_regionQuads == m_maxQuads)
+		{
+			m_regionOffset = m_device->AdvanceVertexBuffer(m_vertexBuffer);
+			m_regionQuads = 0;
+		}
+
+		const unsigned int count = quadCount - first < m_maxQuads - m_regionQuads ? quadCount - first : m_maxQuads - m_regionQuads;
+		this->DrawQuads(first, count);
+		first += count;
+	}
+
+	m_quads.clear();
+	m_quadTextures.clear();
+}
+
+void Magma::SpriteBatch::DrawQuads(size_t first, unsigned int count)
+{
+	Quad* data = static_cast<Quad*>(m_device->MapVertexBuffer(m_vertexBuffer, m_regionQuads * QuadSize, count * QuadSize));
+	if (data == nullptr)
+		return;
+	for (unsigned int i = 0; i < count; ++i)
+		data[i] = m_quads[m_order[first + i]];
+	m_device->UnmapVertexBuffer(m_vertexBuffer);
+
+	// One draw per run of quads sharing a texture
+	const long long baseQuad = m_regionOffset / QuadSize + m_regionQuads;
+	for (unsigned int i = 0; i < count;)
+	{
+		const unsigned int texture = m_quadTextures[m_order[first + i]];
+		unsigned int end = i + 1;
+		while (end < count && m_quadTextures[m_order[first + end]] == texture)
+			++end;
+
+		m_device->SetTexture2D(0, m_textures[texture]);
+		m_device->DrawTrianglesIndexed((baseQuad + i) * 6 * m_indexSize, static_cast<int>((end - i) * 6));
+		++m_drawCount;
+		i = end;
+	}
+
+	m_regionQuads += count;
+}
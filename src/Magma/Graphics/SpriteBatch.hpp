@@ -0,0 +1,130 @@
+#pragma once
+
+#include "RenderDevice.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace Magma
+{
+	/// <summary>
+	///		Vertex written by SpriteBatch. The pipeline reads it as:
+	///		location 0: vec2 position, location 1: vec2 texture coordinates, location 2: vec4 color (normalized RGBA8).
+	/// </summary>
+	struct SpriteVertex
+	{
+		float x;
+		float y;
+		float u;
+		float v;
+		unsigned int color;
+	};
+
+	/// <summary>
+	///		Batches textured and colored quads (sprites, UI) into a stream vertex buffer and draws them sorted by texture, with one
+	///		indexed draw per texture run. The index buffer is static and holds the quad pattern once for every quad of the vertex buffer.
+	///		Usage: Begin, Draw the quads, End. The pipeline params (projection...) and the sampler on slot 0 are set by the caller.
+	/// </summary>
+	class SpriteBatch final
+	{
+	public:
+		/// <summary>
+		///		Creates the vertex and index buffers and the vertex array
+		/// </summary>
+		/// <param name="device">Render device</param>
+		/// <param name="pipeline">Pipeline the quads are drawn with, reading SpriteVertex and the texture on slot 0</param>
+		/// <param name="maxQuads">Number of quads written before the stream vertex buffer moves to its next region</param>
+		SpriteBatch(RenderDevice* device, Pipeline* pipeline, unsigned int maxQuads = 4096);
+		~SpriteBatch();
+
+		/// <summary>
+		///		Packs a color in the vertex color format
+		/// </summary>
+		/// <param name="red">Red channel, from 0 to 1</param>
+		/// <param name="green">Green channel, from 0 to 1</param>
+		/// <param name="blue">Blue channel, from 0 to 1</param>
+		/// <param name="alpha">Alpha channel, from 0 to 1</param>
+		/// <returns>Packed RGBA8 color</returns>
+		static unsigned int MakeColor(float red, float green, float blue, float alpha = 1.0f);
+
+		/// <summary>
+		///		Starts a batch, discarding the quads of the previous one if it wasn't ended
+		/// </summary>
+		/// <param name="sortByTexture">Sort the quads by texture, otherwise they are drawn in submission order (needed when translucent quads overlap)</param>
+		void Begin(bool sortByTexture = true);
+
+		/// <summary>
+		///		Adds a quad, transformed by a 2D affine transform
+		/// </summary>
+		/// <param name="texture">Texture (null to draw untextured)</param>
+		/// <param name="transform">Column major 2x3 transform of the unit quad: (x, y) -> (t[0] x + t[2] y + t[4], t[1] x + t[3] y + t[5])</param>
+		/// <param name="uv">Texture coordinates rectangle (left, top, right, bottom)</param>
+		/// <param name="color">Packed color (see MakeColor)</param>
+		void Draw(Texture2D* texture, const float transform[6], const float uv[4], unsigned int color = 0xFFFFFFFF);
+
+		/// <summary>
+		///		Adds an axis aligned quad covering the whole texture
+		/// </summary>
+		/// <param name="texture">Texture (null to draw untextured)</param>
+		/// <param name="x">Left</param>
+		/// <param name="y">Top</param>
+		/// <param name="width">Width</param>
+		/// <param name="height">Height</param>
+		/// <param name="color">Packed color (see MakeColor)</param>
+		void Draw(Texture2D* texture, float x, float y, float width, float height, unsigned int color = 0xFFFFFFFF);
+
+		/// <summary>
+		///		Sorts the quads, writes them to the vertex buffer and draws them. Binds the pipeline, vertex array and texture slot 0.
+		///		Batches of more than maxQuads quads are drawn in several parts, each moving the vertex buffer to its next region.
+		/// </summary>
+		void End();
+
+		/// <summary>
+		///		Gets the number of draws issued by the last End
+		/// </summary>
+		/// <returns>Number of draws</returns>
+		inline unsigned int GetDrawCount() const { return m_drawCount; }
+
+		/// <summary>
+		///		Gets the number of quads drawn by the last End
+		/// </summary>
+		/// <returns>Number of quads</returns>
+		inline size_t GetQuadCount() const { return m_lastQuadCount; }
+
+	private:
+		struct Quad
+		{
+			SpriteVertex vertices[4];
+		};
+
+		// Writes and draws sorted quads [first, first + count), which fit in the current region
+		void DrawQuads(size_t first, unsigned int count);
+
+		RenderDevice* m_device;
+		Pipeline* m_pipeline;
+		VertexBuffer* m_vertexBuffer = nullptr;
+		VertexDescription* m_vertexDescription = nullptr;
+		VertexArray* m_vertexArray = nullptr;
+		IndexBuffer* m_indexBuffer = nullptr;
+		unsigned int m_maxQuads;
+		long long m_indexSize;
+
+		// Offset of the current vertex buffer region and the number of quads already written to it
+		long long m_regionOffset = -1;
+		unsigned int m_regionQuads = 0;
+
+		bool m_inBatch = false;
+		bool m_sortByTexture = true;
+		std::vector<Quad> m_quads;
+		// Texture of each quad, as an index into m_textures
+		std::vector<unsigned int> m_quadTextures;
+		std::vector<Texture2D*> m_textures;
+		std::unordered_map<Texture2D*, unsigned int> m_textureIndices;
+		// Quads in drawing order, and the counting sort histogram
+		std::vector<unsigned int> m_order;
+		std::vector<unsigned int> m_offsets;
+
+		unsigned int m_drawCount = 0;
+		size_t m_lastQuadCount = 0;
+	};
+}
@@ -0,0 +1,98 @@
+#include "TransientAllocator.hpp"
+#include "..\Utils\Utils.hpp"
+
+Magma::TransientAllocator::TransientAllocator(RenderDevice * device, long long vertexCapacity, long long indexCapacity)
+	: m_device(device)
+{
+	m_vertices.capacity = vertexCapacity;
+	m_vertices.vertexBuffer = m_device->CreateVertexBuffer(vertexCapacity, nullptr, BufferUsage::Stream);
+	m_indices.capacity = indexCapacity;
+	m_indices.indexBuffer = m_device->CreateIndexBuffer(indexCapacity, nullptr, BufferUsage::Stream);
+}
+
+Magma::TransientAllocator::~TransientAllocator()
+{
+	if (m_inFrame)
+		this->EndFrame();
+	m_device->DestroyVertexBuffer(m_vertices.vertexBuffer);
+	m_device->DestroyIndexBuffer(m_indices.indexBuffer);
+}
+
+void Magma::TransientAllocator::BeginFrame()
+{
+	if (m_inFrame)
+	{
+		MAGMA_WARNING("Transient allocator frame begun twice, ending the previous one");
+		this->EndFrame();
+	}
+
+	m_vertices.regionOffset = m_device->AdvanceVertexBuffer(m_vertices.vertexBuffer);
+	m_vertices.data = static_cast<unsigned char*>(m_device->MapVertexBuffer(m_vertices.vertexBuffer, 0, m_vertices.capacity));
+	m_vertices.head = 0;
+
+	m_indices.regionOffset = m_device->AdvanceIndexBuffer(m_indices.indexBuffer);
+	m_indices.data = static_cast<unsigned char*>(m_device->MapIndexBuffer(m_indices.indexBuffer, 0, m_indices.capacity));
+	m_indices.head = 0;
+
+	m_inFrame = true;
+}
+
+void Magma::TransientAllocator::EndFrame()
+{
+	if (!m_inFrame)
+	{
+		MAGMA_WARNING("Transient allocator frame ended without being begun");
+		return;
+	}
+
+	if (m_vertices.data != nullptr)
+		m_device->UnmapVertexBuffer(m_vertices.vertexBuffer);
+	if (m_indices.data != nullptr)
+		m_device->UnmapIndexBuffer(m_indices.indexBuffer);
+	m_vertices.data = nullptr;
+	m_indices.data = nullptr;
+	m_inFrame = false;
+}
+
+void * Magma::TransientAllocator::AllocateVertices(long long size, long long stride, int & baseVertex)
+{
+	if (stride <= 0)
+	{
+		MAGMA_WARNING("Failed to allocate transient vertices, the stride must be positive");
+		return nullptr;
+	}
+
+	long long offset;
+	void* data = Allocate(m_vertices, size, stride, offset);
+	if (data != nullptr)
+		baseVertex = static_cast<int>(offset / stride);
+	return data;
+}
+
+void * Magma::TransientAllocator::AllocateIndices(long long size, long long & offset)
+{
+	// Aligned to 4 bytes so that both 16 and 32 bit indices can be used
+	return Allocate(m_indices, size, 4, offset);
+}
+
+void * Magma::TransientAllocator::Allocate(Arena & arena, long long size, long long alignment, long long & offset)
+{
+	if (arena.data == nullptr)
+	{
+		MAGMA_WARNING("Failed to allocate transient memory, no frame was begun");
+		return nullptr;
+	}
+
+	// Strides aren't always powers of two, align on the absolute buffer offset
+	long long start = arena.regionOffset + arena.head;
+	start = (start + alignment - 1) / alignment * alignment;
+	if (start + size > arena.regionOffset + arena.capacity)
+	{
+		MAGMA_WARNING("Failed to allocate transient memory, out of memory for this frame");
+		return nullptr;
+	}
+
+	arena.head = start + size - arena.regionOffset;
+	offset = start;
+	return arena.data + (start - arena.regionOffset);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "RenderDevice.hpp"
+
+namespace Magma
+{
+	/// <summary>
+	///		Linear allocator of per frame vertex and index memory (UI, debug lines, particles...).
+	///		Allocations are sub ranges of one stream vertex buffer and one stream index buffer, created once,
+	///		whose regions are recycled every frame once the GPU is done with them.
+	///		Usage: BeginFrame, write the allocations, EndFrame, then issue the draws using them.
+	/// </summary>
+	class TransientAllocator final
+	{
+	public:
+		/// <summary>
+		///		Creates the transient buffers
+		/// </summary>
+		/// <param name="device">Render device</param>
+		/// <param name="vertexCapacity">Vertex bytes available per frame (should be a multiple of the vertex strides used)</param>
+		/// <param name="indexCapacity">Index bytes available per frame</param>
+		TransientAllocator(RenderDevice* device, long long vertexCapacity, long long indexCapacity);
+		~TransientAllocator();
+
+		/// <summary>
+		///		Starts a new frame, discarding every allocation of the previous one.
+		///		May wait for the GPU if it is still reading the memory of three frames ago.
+		/// </summary>
+		void BeginFrame();
+
+		/// <summary>
+		///		Ends the frame, the allocations can be drawn with after this call
+		/// </summary>
+		void EndFrame();
+
+		/// <summary>
+		///		Allocates vertex memory for this frame
+		/// </summary>
+		/// <param name="size">Size in bytes</param>
+		/// <param name="stride">Vertex stride, the allocation is aligned to it</param>
+		/// <param name="baseVertex">Out index of the first allocated vertex in the vertex buffer, to be added to draw offsets and indices</param>
+		/// <returns>Pointer to the allocated memory, or nullptr if the frame ran out of vertex memory</returns>
+		void* AllocateVertices(long long size, long long stride, int& baseVertex);
+
+		/// <summary>
+		///		Allocates index memory for this frame
+		/// </summary>
+		/// <param name="size">Size in bytes</param>
+		/// <param name="offset">Out offset in bytes of the allocation in the index buffer, to be used as the draw offset</param>
+		/// <returns>Pointer to the allocated memory, or nullptr if the frame ran out of index memory</returns>
+		void* AllocateIndices(long long size, long long& offset);
+
+		inline VertexBuffer* GetVertexBuffer() const { return m_vertices.vertexBuffer; }
+		inline IndexBuffer* GetIndexBuffer() const { return m_indices.indexBuffer; }
+
+		/// <summary>
+		///		Gets the vertex bytes allocated this frame
+		/// </summary>
+		/// <returns>Size in bytes</returns>
+		inline long long GetVertexBytesUsed() const { return m_vertices.head; }
+
+		/// <summary>
+		///		Gets the index bytes allocated this frame
+		/// </summary>
+		/// <returns>Size in bytes</returns>
+		inline long long GetIndexBytesUsed() const { return m_indices.head; }
+
+	private:
+		struct Arena
+		{
+			VertexBuffer* vertexBuffer = nullptr;
+			IndexBuffer* indexBuffer = nullptr;
+			long long capacity = 0;
+			long long head = 0;
+			// Offset of the current region in the buffer
+			long long regionOffset = 0;
+			unsigned char* data = nullptr;
+		};
+
+		// Allocates from an arena, returns nullptr if it is full
+		static void* Allocate(Arena& arena, long long size, long long alignment, long long& offset);
+
+		RenderDevice* m_device;
+		Arena m_vertices;
+		Arena m_indices;
+		bool m_inFrame = false;
+	};
+}
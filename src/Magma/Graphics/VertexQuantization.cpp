@@ -0,0 +1,273 @@
+#include "VertexQuantization.hpp"
+#include "..\Utils\Utils.hpp"
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	float Clamp(float value, float min, float max)
+	{
+		return value < min ? min : (value > max ? max : value);
+	}
+
+	float Sign(float value)
+	{
+		return value < 0.0f ? -1.0f : 1.0f;
+	}
+
+	int AlignTo4(int size)
+	{
+		return (size + 3) & ~3;
+	}
+
+	const Magma::VertexElement* FindFloatElement(const Magma::MeshData& mesh, unsigned int index, int minSize)
+	{
+		if (index == Magma::QuantizationDesc::NoElement)
+			return nullptr;
+		for (auto& element : mesh.elements)
+			if (element.index == index)
+				return element.type == Magma::VertexElementType::Float && element.size >= minSize ? &element : nullptr;
+		return nullptr;
+	}
+
+	const float* ReadFloats(const Magma::MeshData& mesh, size_t vertex, const Magma::VertexElement& element)
+	{
+		return reinterpret_cast<const float*>(&mesh.vertices[vertex * mesh.vertexStride + static_cast<size_t>(element.offset)]);
+	}
+}
+
+bool Magma::QuantizeMesh(MeshData & mesh, const QuantizationDesc & desc, PositionDequantization * dequantization)
+{
+	const size_t vertexCount = mesh.GetVertexCount();
+	if (mesh.vertexStride == 0 || mesh.vertices.size() % mesh.vertexStride != 0)
+	{
+		MAGMA_WARNING("Failed to quantize mesh, the vertex data size isn't a multiple of the vertex stride");
+		return false;
+	}
+	for (auto& element : mesh.elements)
+		if (element.divisor != 0 || element.offset < 0 || element.offset + RenderDevice::GetVertexElementSize(element.type, element.size) > mesh.vertexStride)
+		{
+			MAGMA_WARNING("Failed to quantize mesh, vertex element " + std::to_string(element.index) + " is per instance or outside the vertex");
+			return false;
+		}
+
+	const VertexElement* position = FindFloatElement(mesh, desc.positionIndex, 3);
+	const VertexElement* normal = FindFloatElement(mesh, desc.normalIndex, 3);
+	const VertexElement* uv = FindFloatElement(mesh, desc.uvIndex, 2);
+
+	// Position bounds
+	PositionDequantization transform;
+	if (position != nullptr && vertexCount > 0)
+	{
+		float min[3], max[3];
+		for (int i = 0; i < 3; ++i)
+			min[i] = max[i] = ReadFloats(mesh, 0, *position)[i];
+		for (size_t v = 1; v < vertexCount; ++v)
+			for (int i = 0; i < 3; ++i)
+			{
+				const float p = ReadFloats(mesh, v, *position)[i];
+				min[i] = p < min[i] ? p : min[i];
+				max[i] = p > max[i] ? p : max[i];
+			}
+		for (int i = 0; i < 3; ++i)
+		{
+			transform.offset[i] = min[i];
+			transform.scale[i] = max[i] - min[i];
+		}
+	}
+
+	// New layout, keeping the order of the elements
+	std::vector<VertexElement> elements;
+	std::vector<const VertexElement*> sources;
+	int stride = 0;
+	for (auto& element : mesh.elements)
+	{
+		VertexElement quantized = element;
+		if (&element == position)
+		{
+			quantized.type = VertexElementType::UShortNormalize;
+			quantized.size = 3;
+		}
+		else if (&element == normal && desc.normalEncoding == NormalEncoding::Octahedral16)
+		{
+			quantized.type = VertexElementType::ShortNormalize;
+			quantized.size = 2;
+		}
+		else if (&element == normal)
+		{
+			quantized.type = VertexElementType::Int1010102Normalize;
+			quantized.size = 4;
+		}
+		else if (&element == uv)
+		{
+			quantized.type = VertexElementType::HalfFloat;
+			quantized.size = 2;
+		}
+
+		quantized.offset = stride;
+		stride += AlignTo4(RenderDevice::GetVertexElementSize(quantized.type, quantized.size));
+		elements.push_back(quantized);
+		sources.push_back(&element);
+	}
+	for (auto& element : elements)
+		element.stride = stride;
+
+	std::vector<unsigned char> vertices(vertexCount * stride, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+		for (size_t e = 0; e < elements.size(); ++e)
+		{
+			unsigned char* out = &vertices[v * stride + static_cast<size_t>(elements[e].offset)];
+			const VertexElement* source = sources[e];
+
+			if (source == position)
+			{
+				const float* p = ReadFloats(mesh, v, *source);
+				unsigned short q[3];
+				for (int i = 0; i < 3; ++i)
+				{
+					const float t = transform.scale[i] > 0.0f ? (p[i] - transform.offset[i]) / transform.scale[i] : 0.0f;
+					q[i] = static_cast<unsigned short>(Clamp(t, 0.0f, 1.0f) * 65535.0f + 0.5f);
+				}
+				memcpy(out, q, sizeof(q));
+			}
+			else if (source == normal)
+			{
+				const float* n = ReadFloats(mesh, v, *source);
+				if (desc.normalEncoding == NormalEncoding::Octahedral16)
+				{
+					short q[2];
+					EncodeOctahedral(n, q);
+					memcpy(out, q, sizeof(q));
+				}
+				else
+				{
+					const unsigned int q = PackSnorm1010102(n);
+					memcpy(out, &q, sizeof(q));
+				}
+			}
+			else if (source == uv)
+			{
+				const float* t = ReadFloats(mesh, v, *source);
+				const unsigned short q[2] = { FloatToHalf(t[0]), FloatToHalf(t[1]) };
+				memcpy(out, q, sizeof(q));
+			}
+			else
+				memcpy(out, &mesh.vertices[v * mesh.vertexStride + static_cast<size_t>(source->offset)], RenderDevice::GetVertexElementSize(source->type, source->size));
+		}
+
+	mesh.vertices = std::move(vertices);
+	mesh.vertexStride = static_cast<unsigned int>(stride);
+	mesh.elements = std::move(elements);
+	if (dequantization != nullptr)
+		*dequantization = transform;
+	return true;
+}
+
+unsigned short Magma::FloatToHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	const unsigned int sign = (bits >> 16) & 0x8000;
+	const int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15;
+	unsigned int mantissa = bits & 0x7FFFFF;
+
+	// Infinity and NaN
+	if (((bits >> 23) & 0xFF) == 0xFF)
+		return static_cast<unsigned short>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+	// Too large, becomes infinity
+	if (exponent >= 31)
+		return static_cast<unsigned short>(sign | 0x7C00);
+	// Denormal or zero
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return static_cast<unsigned short>(sign);
+		mantissa |= 0x800000;
+		const int shift = 14 - exponent;
+		unsigned int half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1)
+			++half;
+		return static_cast<unsigned short>(sign | half);
+	}
+
+	// Rounding may carry into the exponent, which still gives the right result
+	unsigned int half = sign | (static_cast<unsigned int>(exponent) << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000)
+		++half;
+	return static_cast<unsigned short>(half);
+}
+
+float Magma::HalfToFloat(unsigned short value)
+{
+	const unsigned int sign = static_cast<unsigned int>(value & 0x8000) << 16;
+	const unsigned int exponent = (value >> 10) & 0x1F;
+	const unsigned int mantissa = value & 0x3FF;
+
+	unsigned int bits;
+	if (exponent == 0)
+	{
+		// Denormals are exact in single precision
+		const float magnitude = static_cast<float>(mantissa) / 16777216.0f;
+		return sign != 0 ? -magnitude : magnitude;
+	}
+	else if (exponent == 31)
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	else
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+void Magma::EncodeOctahedral(const float normal[3], short encoded[2])
+{
+	const float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+	float x = length > 0.0f ? normal[0] / length : 0.0f;
+	float y = length > 0.0f ? normal[1] / length : 0.0f;
+	const float z = length > 0.0f ? normal[2] / length : 1.0f;
+
+	// Fold the lower hemisphere over the diagonals
+	if (z < 0.0f)
+	{
+		const float foldedX = (1.0f - std::fabs(y)) * Sign(x);
+		const float foldedY = (1.0f - std::fabs(x)) * Sign(y);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	encoded[0] = static_cast<short>(std::round(Clamp(x, -1.0f, 1.0f) * 32767.0f));
+	encoded[1] = static_cast<short>(std::round(Clamp(y, -1.0f, 1.0f) * 32767.0f));
+}
+
+void Magma::DecodeOctahedral(const short encoded[2], float normal[3])
+{
+	float x = Clamp(encoded[0] / 32767.0f, -1.0f, 1.0f);
+	float y = Clamp(encoded[1] / 32767.0f, -1.0f, 1.0f);
+	const float z = 1.0f - std::fabs(x) - std::fabs(y);
+	if (z < 0.0f)
+	{
+		const float unfoldedX = (1.0f - std::fabs(y)) * Sign(x);
+		const float unfoldedY = (1.0f - std::fabs(x)) * Sign(y);
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+
+	const float length = std::sqrt(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
+
+unsigned int Magma::PackSnorm1010102(const float vector[3])
+{
+	unsigned int packed = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		const int q = static_cast<int>(std::round(Clamp(vector[i], -1.0f, 1.0f) * 511.0f));
+		packed |= (static_cast<unsigned int>(q) & 0x3FF) << (10 * i);
+	}
+	return packed;
+}
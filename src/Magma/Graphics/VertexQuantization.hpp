@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Mesh.hpp"
+
+namespace Magma
+{
+	/// <summary>
+	///		How normals are stored by QuantizeMesh
+	/// </summary>
+	enum class NormalEncoding
+	{
+		/// <summary>
+		///		Octahedral mapping in two 16 bit signed normalized components, decoded in the vertex shader (DecodeOctahedral)
+		/// </summary>
+		Octahedral16,
+
+		/// <summary>
+		///		Signed normalized 10-10-10-2, usable directly as a vec3
+		/// </summary>
+		Packed1010102,
+	};
+
+	/// <summary>
+	///		Describes which vertex elements QuantizeMesh compresses and how.
+	///		Elements are identified by their location binding; elements not mentioned, not found or not stored as floats are kept as they are.
+	/// </summary>
+	struct QuantizationDesc
+	{
+		static const unsigned int NoElement = 0xFFFFFFFF;
+
+		/// <summary>
+		///		Position element (three floats), stored as three 16 bit unsigned normalized values within the mesh bounds
+		/// </summary>
+		unsigned int positionIndex = 0;
+
+		/// <summary>
+		///		Normal element (three floats), stored as set by normalEncoding
+		/// </summary>
+		unsigned int normalIndex = 1;
+
+		/// <summary>
+		///		Texture coordinates element (two floats), stored as half floats
+		/// </summary>
+		unsigned int uvIndex = 2;
+
+		NormalEncoding normalEncoding = NormalEncoding::Octahedral16;
+	};
+
+	/// <summary>
+	///		Transform undoing position quantization: position = offset + quantized * scale, with quantized in [0, 1]
+	/// </summary>
+	struct PositionDequantization
+	{
+		float offset[3] = { 0.0f, 0.0f, 0.0f };
+		float scale[3] = { 1.0f, 1.0f, 1.0f };
+	};
+
+	/// <summary>
+	///		Quantizes the vertices of a mesh at import time, rewriting its vertex data, stride and vertex elements
+	///		(so that the vertex description created from them matches). Elements are kept 4 byte aligned.
+	///		A mesh with float positions, normals and texture coordinates goes from 32 to 16 bytes per vertex.
+	/// </summary>
+	/// <param name="mesh">Mesh, modified in place</param>
+	/// <param name="desc">Elements to quantize</param>
+	/// <param name="dequantization">Out transform the vertex shader must apply to the positions (may be null)</param>
+	/// <returns>True on success, false if the mesh vertex data is invalid</returns>
+	bool QuantizeMesh(MeshData& mesh, const QuantizationDesc& desc = QuantizationDesc(), PositionDequantization* dequantization = nullptr);
+
+	/// <summary>
+	///		Converts a float to a half float, rounding to the nearest value
+	/// </summary>
+	/// <param name="value">Float value</param>
+	/// <returns>Half float bits</returns>
+	unsigned short FloatToHalf(float value);
+
+	/// <summary>
+	///		Converts a half float to a float
+	/// </summary>
+	/// <param name="value">Half float bits</param>
+	/// <returns>Float value</returns>
+	float HalfToFloat(unsigned short value);
+
+	/// <summary>
+	///		Encodes a unit vector with the octahedral mapping, in two 16 bit signed normalized values
+	/// </summary>
+	/// <param name="normal">Unit vector</param>
+	/// <param name="encoded">Out encoded vector</param>
+	void EncodeOctahedral(const float normal[3], short encoded[2]);
+
+	/// <summary>
+	///		Decodes a unit vector encoded with EncodeOctahedral. Vertex shaders decode it the same way:
+	///		n = vec3(e.xy, 1 - abs(e.x) - abs(e.y)); if (n.z &lt; 0) n.xy = (1 - abs(n.yx)) * sign(n.xy); n = normalize(n);
+	/// </summary>
+	/// <param name="encoded">Encoded vector</param>
+	/// <param name="normal">Out unit vector</param>
+	void DecodeOctahedral(const short encoded[2], float normal[3]);
+
+	/// <summary>
+	///		Packs a vector with components in [-1, 1] into signed normalized 10-10-10-2 (w is zero)
+	/// </summary>
+	/// <param name="vector">Vector</param>
+	/// <returns>Packed vector</returns>
+	unsigned int PackSnorm1010102(const float vector[3]);
+}
@@ -29,6 +29,8 @@ using namespace Magma;
 #include "..\Input\Input.hpp"
 #include "..\Resources\ResourcesManager.hpp"
 #include "..\Scene\Scene.hpp"
+#include "..\..\Graphics\RenderDevice.hpp"
+#include "..\..\Graphics\PipelineCache.hpp"
 
 #ifdef MAGMA_IS_WINDOWS
 #include "..\..\Debug\WindowsConsole.hpp"
@@ -50,6 +52,10 @@ int main()
 	Console::Init<WindowsConsole>();
 #endif
 
+	// Linked pipelines are kept between runs, the cache must outlive the render device
+	FilePipelineCacheStorage pipelineCacheStorage("pipelines.cache");
+	PipelineCache pipelineCache(&pipelineCacheStorage);
+
 	Locator locator;
 
 	locator.msgBus = std::make_shared<MessageBus>(128, 512);
@@ -72,6 +78,7 @@ int main()
 	locator.window = std::make_shared<GLFWWindow>();
 	locator.window->Open();
 	locator.renderDevice = std::make_shared<OpenGLRenderDevice>();
+	locator.renderDevice->SetPipelineCache(&pipelineCache);
 #endif
 	locator.input->SetWindow(locator.window);
 	locator.input->Init(locator.msgBus);
@@ -97,9 +104,12 @@ int main()
 		locator.terminal->Update();
 		locator.core->Update();
 		locator.input->Update(1.0f / 60.0f);
+		locator.scene->Update(1.0f / 60.0f);
 
 		MagmaUpdate(locator, 1.0f / 60.0f);
 
+		if (locator.renderDevice != nullptr)
+			locator.renderDevice->EndFrame();
 		locator.window->Display();
 	}
 
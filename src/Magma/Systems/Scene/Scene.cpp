@@ -10,6 +10,11 @@ Magma::Scene::~Scene()
 	m_root = nullptr;
 }
 
+void Magma::Scene::Update(float deltaTime)
+{
+	m_scheduler.Update(deltaTime);
+}
+
 void Magma::Scene::Serialize(std::ostream & stream) const
 {
 	stream << *m_root;
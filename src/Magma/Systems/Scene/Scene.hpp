@@ -3,6 +3,7 @@
 #include "..\..\Utils\Serializable.hpp"
 #include "..\MessageBus.hpp"
 #include "SceneNode.hpp"
+#include "SystemScheduler.hpp"
 
 namespace Magma
 {
@@ -21,8 +22,27 @@ namespace Magma
 		/// <returns>Scene root node</returns>
 		inline std::shared_ptr<SceneNode> GetRoot() { m_root; }
 
+		/// <summary>
+		///		Adds a component system to be updated every frame
+		/// </summary>
+		/// <param name="system">Component system</param>
+		inline void AddSystem(std::shared_ptr<ComponentSystem> system) { m_scheduler.AddSystem(system); }
+
+		/// <summary>
+		///		Removes a component system from this scene
+		/// </summary>
+		/// <param name="system">Component system</param>
+		inline void RemoveSystem(std::shared_ptr<ComponentSystem> system) { m_scheduler.RemoveSystem(system); }
+
+		/// <summary>
+		///		Updates every component system, running the ones that don't conflict in parallel
+		/// </summary>
+		/// <param name="deltaTime">Time elapsed since the last frame</param>
+		void Update(float deltaTime);
+
 	private:
 		std::shared_ptr<SceneNode> m_root;
+		SystemScheduler m_scheduler;
 
 		// Inherited via Serializable
 		virtual void Serialize(std::ostream & stream) const override;
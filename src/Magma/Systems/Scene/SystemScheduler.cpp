@@ -0,0 +1,112 @@
+#include "SystemScheduler.hpp"
+#include "..\..\Utils\Utils.hpp"
+
+#include <algorithm>
+
+bool Magma::ComponentSystem::ConflictsWith(const ComponentSystem & other) const
+{
+	for (auto& t : m_writes)
+		if (other.m_writes.find(t) != other.m_writes.end() || other.m_reads.find(t) != other.m_reads.end())
+			return true;
+	for (auto& t : m_reads)
+		if (other.m_writes.find(t) != other.m_writes.end())
+			return true;
+	return false;
+}
+
+void Magma::ComponentSystem::Reads(const std::string & componentType)
+{
+	m_reads.insert(componentType);
+}
+
+void Magma::ComponentSystem::Writes(const std::string & componentType)
+{
+	m_writes.insert(componentType);
+}
+
+Magma::SystemScheduler::SystemScheduler(size_t workerCount)
+	: m_pool(workerCount)
+{
+	m_unfinished = 0;
+}
+
+void Magma::SystemScheduler::AddSystem(std::shared_ptr<ComponentSystem> system)
+{
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	if (std::find(m_systems.begin(), m_systems.end(), system) != m_systems.end())
+	{
+		MAGMA_WARNING("Failed to add system to scheduler, system was already added");
+		return;
+	}
+	m_systems.push_back(system);
+	m_graphDirty = true;
+}
+
+void Magma::SystemScheduler::RemoveSystem(std::shared_ptr<ComponentSystem> system)
+{
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	auto it = std::find(m_systems.begin(), m_systems.end(), system);
+	if (it == m_systems.end())
+		return;
+	m_systems.erase(it);
+	m_graphDirty = true;
+}
+
+void Magma::SystemScheduler::Update(float deltaTime)
+{
+	// Only the graph rebuild is locked, so that systems can add and remove systems from their Update.
+	// The nodes hold their systems, changes made during the frame are applied on the next one
+	{
+		std::lock_guard<std::mutex> lockGuard(m_mutex);
+		if (m_graphDirty)
+			this->BuildGraph();
+	}
+	if (m_nodes.empty())
+		return;
+
+	for (size_t i = 0; i < m_nodes.size(); ++i)
+		m_remaining[i] = m_nodes[i].dependencyCount;
+	m_unfinished = m_nodes.size();
+
+	for (size_t i = 0; i < m_nodes.size(); ++i)
+		if (m_nodes[i].dependencyCount == 0)
+			m_pool.Submit([this, i, deltaTime]() { this->RunNode(i, deltaTime); });
+
+	// The calling thread helps running the systems until every one of them is done
+	m_pool.Wait(m_unfinished);
+}
+
+void Magma::SystemScheduler::BuildGraph()
+{
+	m_nodes.clear();
+	m_nodes.resize(m_systems.size());
+	m_remaining.reset(new std::atomic<size_t>[m_systems.size()]);
+
+	for (size_t i = 0; i < m_systems.size(); ++i)
+	{
+		m_nodes[i].system = m_systems[i];
+
+		// A system depends on every earlier system it conflicts with
+		for (size_t j = 0; j < i; ++j)
+		{
+			if (m_systems[j]->ConflictsWith(*m_systems[i]))
+			{
+				m_nodes[j].successors.push_back(i);
+				++m_nodes[i].dependencyCount;
+			}
+		}
+	}
+
+	m_graphDirty = false;
+}
+
+void Magma::SystemScheduler::RunNode(size_t index, float deltaTime)
+{
+	m_nodes[index].system->Update(deltaTime);
+
+	for (size_t s : m_nodes[index].successors)
+		if (--m_remaining[s] == 0)
+			m_pool.Submit([this, s, deltaTime]() { this->RunNode(s, deltaTime); });
+
+	--m_unfinished;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "..\..\Utils\JobPool.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Magma
+{
+	/// <summary>
+	///		Updates every component of one or more types once per frame.
+	///		Systems declare which component types they read and write so that the scheduler can run
+	///		systems that don't conflict in parallel, without any locking inside Update.
+	/// </summary>
+	class ComponentSystem
+	{
+	public:
+		virtual ~ComponentSystem() = default;
+
+		/// <summary>
+		///		Called once per frame by the system scheduler
+		/// </summary>
+		/// <param name="deltaTime">Time elapsed since the last frame</param>
+		virtual void Update(float deltaTime) = 0;
+
+		/// <summary>
+		///		Gets the component types this system reads
+		/// </summary>
+		/// <returns>Component type names</returns>
+		inline const std::set<std::string>& GetReadTypes() const { return m_reads; }
+
+		/// <summary>
+		///		Gets the component types this system writes
+		/// </summary>
+		/// <returns>Component type names</returns>
+		inline const std::set<std::string>& GetWriteTypes() const { return m_writes; }
+
+		/// <summary>
+		///		Checks if this system can't run at the same time as another system
+		///		(one of them writes a component type the other reads or writes)
+		/// </summary>
+		/// <param name="other">Other system</param>
+		/// <returns>True if the systems conflict, otherwise false</returns>
+		bool ConflictsWith(const ComponentSystem& other) const;
+
+	protected:
+		/// <summary>
+		///		Declares that this system reads a component type
+		/// </summary>
+		/// <param name="componentType">Component type name (as registered with MAGMA_REGISTER)</param>
+		void Reads(const std::string& componentType);
+
+		/// <summary>
+		///		Declares that this system writes a component type
+		/// </summary>
+		/// <param name="componentType">Component type name (as registered with MAGMA_REGISTER)</param>
+		void Writes(const std::string& componentType);
+
+	private:
+		std::set<std::string> m_reads;
+		std::set<std::string> m_writes;
+	};
+
+	/// <summary>
+	///		Runs component systems every frame as a dependency graph.
+	///		Systems are ordered by the order they were added in, but only when they conflict;
+	///		systems that don't conflict run in parallel on a work stealing job pool.
+	/// </summary>
+	class SystemScheduler final
+	{
+	public:
+		/// <summary>
+		///		Creates a system scheduler
+		/// </summary>
+		/// <param name="workerCount">Number of worker threads (zero to use the hardware concurrency minus one)</param>
+		SystemScheduler(size_t workerCount = 0);
+
+		/// <summary>
+		///		Adds a system to this scheduler. Its declared component types must not change after this.
+		///		May be called from a system Update, the system then runs from the next frame on.
+		/// </summary>
+		/// <param name="system">System to add</param>
+		void AddSystem(std::shared_ptr<ComponentSystem> system);
+
+		/// <summary>
+		///		Removes a system from this scheduler.
+		///		May be called from a system Update, the system then still runs until the end of the frame.
+		/// </summary>
+		/// <param name="system">System to remove</param>
+		void RemoveSystem(std::shared_ptr<ComponentSystem> system);
+
+		/// <summary>
+		///		Updates every system, returns when all of them are done. Must not be called from several threads at once.
+		/// </summary>
+		/// <param name="deltaTime">Time elapsed since the last frame</param>
+		void Update(float deltaTime);
+
+	private:
+		struct Node
+		{
+			std::shared_ptr<ComponentSystem> system;
+			std::vector<size_t> successors;
+			size_t dependencyCount = 0;
+		};
+
+		void BuildGraph();
+		void RunNode(size_t index, float deltaTime);
+
+		// Guards the systems and the dirty flag, which systems may change while the graph runs
+		std::mutex m_mutex;
+		std::vector<std::shared_ptr<ComponentSystem>> m_systems;
+		bool m_graphDirty = true;
+
+		// Graph of the current frame, only rebuilt between frames
+		std::vector<Node> m_nodes;
+		std::unique_ptr<std::atomic<size_t>[]> m_remaining;
+		std::atomic<size_t> m_unfinished;
+
+		JobPool m_pool;
+	};
+}
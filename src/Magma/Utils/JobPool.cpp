@@ -0,0 +1,131 @@
+#include "JobPool.hpp"
+
+namespace
+{
+	// Pool and queue owned by the current thread, if it is a worker
+	thread_local Magma::JobPool* t_pool = nullptr;
+	thread_local size_t t_queue = 0;
+}
+
+Magma::JobPool::JobPool(size_t workerCount)
+{
+	if (workerCount == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	m_running = true;
+	m_pending = 0;
+
+	for (size_t i = 0; i < workerCount + 1; ++i)
+		m_queues.push_back(std::make_unique<Queue>());
+	m_externalQueue = workerCount;
+
+	for (size_t i = 0; i < workerCount; ++i)
+		m_workers.emplace_back(&JobPool::WorkerMain, this, i);
+}
+
+Magma::JobPool::~JobPool()
+{
+	{
+		std::lock_guard<std::mutex> lockGuard(m_sleepMutex);
+		m_running = false;
+	}
+	m_sleepCondition.notify_all();
+
+	for (auto& w : m_workers)
+		w.join();
+}
+
+void Magma::JobPool::Submit(Job job)
+{
+	size_t queue = (t_pool == this) ? t_queue : m_externalQueue;
+
+	// Count the job before pushing it, a thief may take it right away
+	++m_pending;
+	{
+		std::lock_guard<std::mutex> lockGuard(m_queues[queue]->mutex);
+		m_queues[queue]->jobs.push_back(std::move(job));
+	}
+
+	// Lock before notifying so a worker can't miss the wake up between checking m_pending and sleeping
+	{
+		std::lock_guard<std::mutex> lockGuard(m_sleepMutex);
+	}
+	m_sleepCondition.notify_one();
+}
+
+void Magma::JobPool::Wait(const std::atomic<size_t>& counter)
+{
+	size_t queue = (t_pool == this) ? t_queue : m_externalQueue;
+
+	while (counter > 0)
+	{
+		Job job;
+		if (this->Pop(queue, job) || this->Steal(queue, job))
+		{
+			job();
+			continue;
+		}
+
+		// Sleep until a worker finishes a job (which may have reached the counter) or more jobs are submitted
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_doneCondition.wait(lock, [this, &counter]() { return counter == 0 || m_pending > 0; });
+	}
+}
+
+void Magma::JobPool::WorkerMain(size_t index)
+{
+	t_pool = this;
+	t_queue = index;
+
+	while (m_running)
+	{
+		Job job;
+		if (this->Pop(index, job) || this->Steal(index, job))
+		{
+			job();
+
+			// Wake the threads waiting for jobs to finish
+			{
+				std::lock_guard<std::mutex> lockGuard(m_sleepMutex);
+			}
+			m_doneCondition.notify_all();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_sleepCondition.wait(lock, [this]() { return !m_running || m_pending > 0; });
+	}
+
+	t_pool = nullptr;
+}
+
+bool Magma::JobPool::Pop(size_t queue, Job & job)
+{
+	std::lock_guard<std::mutex> lockGuard(m_queues[queue]->mutex);
+	if (m_queues[queue]->jobs.empty())
+		return false;
+	job = std::move(m_queues[queue]->jobs.back());
+	m_queues[queue]->jobs.pop_back();
+	--m_pending;
+	return true;
+}
+
+bool Magma::JobPool::Steal(size_t thief, Job & job)
+{
+	// Start on the queue after the thief's so that thieves spread out over the victims
+	for (size_t i = 1; i < m_queues.size(); ++i)
+	{
+		Queue& victim = *m_queues[(thief + i) % m_queues.size()];
+		std::lock_guard<std::mutex> lockGuard(victim.mutex);
+		if (victim.jobs.empty())
+			continue;
+		job = std::move(victim.jobs.front());
+		victim.jobs.pop_front();
+		--m_pending;
+		return true;
+	}
+	return false;
+}
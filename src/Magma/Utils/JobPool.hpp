@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Magma
+{
+	/// <summary>
+	///		Pool of worker threads that run jobs.
+	///		Every worker owns a job queue; when it runs out of jobs it steals from the other queues.
+	/// </summary>
+	class JobPool final
+	{
+	public:
+		using Job = std::function<void()>;
+
+		/// <summary>
+		///		Creates a job pool and starts its worker threads
+		/// </summary>
+		/// <param name="workerCount">Number of worker threads (zero to use the hardware concurrency minus one)</param>
+		JobPool(size_t workerCount = 0);
+		~JobPool();
+
+		// Delete copy constructor
+		JobPool(const JobPool&) = delete;
+		JobPool& operator=(const JobPool&) = delete;
+
+		/// <summary>
+		///		Submits a job to the pool.
+		///		Jobs submitted from a worker thread are pushed into that worker's own queue.
+		/// </summary>
+		/// <param name="job">Job to run</param>
+		void Submit(Job job);
+
+		/// <summary>
+		///		Runs jobs on the calling thread until a counter reaches zero, sleeping while there are none left to run.
+		///		The counter must be decremented by jobs run on the pool.
+		/// </summary>
+		/// <param name="counter">Counter decremented by the jobs being waited for</param>
+		void Wait(const std::atomic<size_t>& counter);
+
+		/// <summary>
+		///		Gets the number of worker threads in this pool
+		/// </summary>
+		/// <returns>Number of worker threads</returns>
+		inline size_t GetWorkerCount() const { return m_workers.size(); }
+
+	private:
+		struct Queue
+		{
+			std::deque<Job> jobs;
+			std::mutex mutex;
+		};
+
+		void WorkerMain(size_t index);
+
+		// Pops a job from the back of a queue (owner side)
+		bool Pop(size_t queue, Job& job);
+		// Takes a job from the front of any queue other than the thief's own
+		bool Steal(size_t thief, Job& job);
+
+		std::vector<std::thread> m_workers;
+		// One queue per worker plus one shared by every thread outside the pool
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		size_t m_externalQueue;
+
+		std::atomic<bool> m_running;
+		std::atomic<size_t> m_pending;
+		std::mutex m_sleepMutex;
+		// Workers sleep on this one while there are no jobs
+		std::condition_variable m_sleepCondition;
+		// Threads in Wait sleep on this one until a job finishes
+		std::condition_variable m_doneCondition;
+	};
+}